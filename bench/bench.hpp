@@ -0,0 +1,41 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+namespace ucmdp::bench
+{
+
+
+// runs f `repetitions` times and returns the fastest run in seconds
+template< typename F >
+double best_of(int repetitions, F &&f)
+{
+    double best = 1e300;
+    for (int i = 0; i < repetitions; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best)
+        {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+inline void report(const char *name, double seconds, double items)
+{
+    std::printf("%-40s %10.3f ms %12.1f ns/item\n",
+        name, seconds * 1e3, seconds * 1e9 / items);
+}
+
+
+}
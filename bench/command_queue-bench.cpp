@@ -0,0 +1,121 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/all.hpp>
+#include <ucmd-parser/command_queue.hpp>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+#include "bench.hpp"
+
+namespace
+{
+    // the baseline: one std::string per command behind a mutex
+    class mutex_queue
+    {
+    public:
+        void push(std::string cmd)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQueue.push_back(std::move(cmd));
+        }
+
+        template< typename F >
+        std::size_t consume(F &&f)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mBatch.swap(mQueue);
+            }
+            const auto count = mBatch.size();
+            for (auto &cmd : mBatch)
+            {
+                f(cmd);
+            }
+            mBatch.clear();
+            return count;
+        }
+
+    private:
+        std::mutex mMutex;
+        std::deque<std::string> mQueue;
+        std::deque<std::string> mBatch;
+    };
+
+    template< typename Queue, typename Push >
+    double run(Queue &queue, const ucmdp::command_tree &tree, unsigned producers,
+               std::size_t commands, Push &&push)
+    {
+        return ucmdp::bench::best_of(3, [&]()
+        {
+            std::vector<std::thread> threads;
+            for (unsigned p = 0; p < producers; ++p)
+            {
+                threads.emplace_back([&, p]()
+                {
+                    std::string cmd;
+                    for (std::size_t i = p; i < commands; i += producers)
+                    {
+                        cmd = "cluster node disk smart attrs set ";
+                        cmd += std::to_string(i % 100);
+                        cmd += ' ';
+                        cmd += std::to_string(i);
+                        push(queue, cmd);
+                    }
+                });
+            }
+            for (std::size_t done = 0; done < commands;)
+            {
+                const auto count = queue.consume([&tree](std::string_view cmd) { tree(cmd); });
+                if (count == 0)
+                {
+                    std::this_thread::yield();
+                }
+                done += count;
+            }
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+        });
+    }
+}
+
+// compares the inline byte ring with a mutex protected deque of strings,
+// usage: command_queue-bench [commands] [max producers]
+int main(int argc, char *argv[])
+{
+    using namespace ucmdp;
+
+    const std::size_t commands = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const unsigned maxProducers = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 32;
+
+    long long sum = 0;
+    command_tree tree {
+        { "cluster node disk smart attrs set", make_command([&sum](int id, long long v) { sum += id ^ v; }) }
+    };
+
+    for (unsigned producers = 1; producers <= maxProducers; producers *= 2)
+    {
+        mutex_queue locked;
+        auto lockedTime = run(locked, tree, producers, commands,
+            [](mutex_queue &queue, const std::string &cmd) { queue.push(cmd); });
+        auto name = "mutex deque, " + std::to_string(producers) + " producers";
+        bench::report(name.c_str(), lockedTime, static_cast<double>(commands));
+
+        command_queue ring{ std::size_t{ 1 } << 20 };
+        auto ringTime = run(ring, tree, producers, commands,
+            [](command_queue &queue, const std::string &cmd) { queue.push(cmd); });
+        name = "command_queue, " + std::to_string(producers) + " producers";
+        bench::report(name.c_str(), ringTime, static_cast<double>(commands));
+    }
+    std::printf("checksum %lld\n", sum);
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/all.hpp>
+#include <ucmd-parser/journal.hpp>
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench.hpp"
+
+// measures the dispatch overhead of journaling and the replay throughput,
+// usage: journal-bench [commands] [journal path]
+int main(int argc, char *argv[])
+{
+    using namespace ucmdp;
+
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const std::string path = argc > 2 ? argv[2] : "journal-bench.journal";
+
+    long long sum = 0;
+    command_tree tree {
+        { "cluster node disk smart attrs set", make_command([&sum](int id, long long v) { sum += id ^ v; }) },
+        { "cluster node disk smart attrs get", make_command([&sum](int id) { sum += id; }) },
+        { "cluster node net link down", make_command([&sum]() { ++sum; }) }
+    };
+
+    std::vector<std::string> commands;
+    commands.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        switch (i % 3)
+        {
+        case 0:
+            commands.push_back("cluster node disk smart attrs set " + std::to_string(i % 100) + " " + std::to_string(i));
+            break;
+        case 1:
+            commands.push_back("cluster node disk smart attrs get " + std::to_string(i % 100));
+            break;
+        default:
+            commands.push_back("cluster node net link down");
+        }
+    }
+
+    auto plain = bench::best_of(3, [&]()
+    {
+        for (auto &cmd : commands)
+        {
+            tree(cmd);
+        }
+    });
+    bench::report("dispatch", plain, static_cast<double>(count));
+
+    auto journaled = bench::best_of(3, [&]()
+    {
+        record_journal(tree, std::make_shared<journal_writer>(path));
+        for (auto &cmd : commands)
+        {
+            tree(cmd);
+        }
+        // flushes and closes the journal
+        tree.observe(nullptr);
+    });
+    bench::report("dispatch + journal", journaled, static_cast<double>(count));
+
+    journal_reader reader{ path };
+    replay_statistics stats;
+    auto replay = bench::best_of(3, [&]()
+    {
+        stats = replay_journal(tree, reader);
+    });
+    bench::report("replay", replay, static_cast<double>(stats.commands));
+
+    std::printf("rebound %llu, resolved %llu, failed %llu (checksum %lld)\n",
+        static_cast<unsigned long long>(stats.rebound),
+        static_cast<unsigned long long>(stats.resolved),
+        static_cast<unsigned long long>(stats.failed), sum);
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/all.hpp>
+
+#include <new>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+
+#include <boost/config.hpp>
+
+#include "bench.hpp"
+
+namespace
+{
+    std::size_t allocations = 0;
+
+    // the replacements below only forward to these. Kept out of line, GCC
+    // would otherwise see free() being called on the result of a new
+    // expression and warn about mismatched allocation functions.
+    BOOST_NOINLINE void * counted_alloc(std::size_t size, std::size_t alignment) noexcept
+    {
+        ++allocations;
+        size = size ? size : 1;
+        if (alignment <= alignof(std::max_align_t))
+        {
+            return std::malloc(size);
+        }
+#if defined(_MSC_VER)
+        return _aligned_malloc(size, alignment);
+#else
+        return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+    }
+    BOOST_NOINLINE void counted_free(void *p, std::size_t alignment) noexcept
+    {
+#if defined(_MSC_VER)
+        if (alignment > alignof(std::max_align_t))
+        {
+            _aligned_free(p);
+            return;
+        }
+#endif
+        static_cast<void>(alignment);
+        std::free(p);
+    }
+
+    void * checked_alloc(std::size_t size, std::size_t alignment)
+    {
+        if (auto p = counted_alloc(size, alignment))
+        {
+            return p;
+        }
+        throw std::bad_alloc{};
+    }
+}
+
+void * operator new(std::size_t size)
+{
+    return checked_alloc(size, alignof(std::max_align_t));
+}
+void * operator new[](std::size_t size)
+{
+    return checked_alloc(size, alignof(std::max_align_t));
+}
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+    return checked_alloc(size, static_cast<std::size_t>(alignment));
+}
+void * operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return checked_alloc(size, static_cast<std::size_t>(alignment));
+}
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size, alignof(std::max_align_t));
+}
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size, alignof(std::max_align_t));
+}
+void * operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+void * operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept
+{
+    counted_free(p, alignof(std::max_align_t));
+}
+void operator delete[](void *p) noexcept
+{
+    counted_free(p, alignof(std::max_align_t));
+}
+void operator delete(void *p, std::size_t) noexcept
+{
+    counted_free(p, alignof(std::max_align_t));
+}
+void operator delete[](void *p, std::size_t) noexcept
+{
+    counted_free(p, alignof(std::max_align_t));
+}
+void operator delete(void *p, std::align_val_t alignment) noexcept
+{
+    counted_free(p, static_cast<std::size_t>(alignment));
+}
+void operator delete[](void *p, std::align_val_t alignment) noexcept
+{
+    counted_free(p, static_cast<std::size_t>(alignment));
+}
+void operator delete(void *p, std::size_t, std::align_val_t alignment) noexcept
+{
+    counted_free(p, static_cast<std::size_t>(alignment));
+}
+void operator delete[](void *p, std::size_t, std::align_val_t alignment) noexcept
+{
+    counted_free(p, static_cast<std::size_t>(alignment));
+}
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    counted_free(p, alignof(std::max_align_t));
+}
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    counted_free(p, alignof(std::max_align_t));
+}
+void operator delete(void *p, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    counted_free(p, static_cast<std::size_t>(alignment));
+}
+void operator delete[](void *p, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    counted_free(p, static_cast<std::size_t>(alignment));
+}
+
+// compares full dispatch with resolving the command target and a routing
+// key and rejecting unknown commands, usage: resolve-bench [commands]
+int main(int argc, char *argv[])
+{
+    using namespace ucmdp;
+
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    unsigned long long sum = 0;
+    command_tree tree;
+    for (int i = 0; i < 50; ++i)
+    {
+        tree.insert("service" + std::to_string(i) + " entity update",
+                    make_command([&sum](unsigned id, std::string name, int value)
+                    {
+                        sum += id + name.size() + static_cast<unsigned>(value);
+                    }));
+    }
+    std::vector<std::string> cmds;
+    for (int i = 0; i < 64; ++i)
+    {
+        cmds.push_back("service" + std::to_string(i % 50) + " entity update "
+            + std::to_string(i * 7919) + " \"display name\" 42");
+    }
+
+    const auto measure = [&](const char *name, auto &&f)
+    {
+        const auto before = allocations;
+        auto elapsed = bench::best_of(3, [&]()
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                f(cmds[i % cmds.size()]);
+            }
+        });
+        bench::report(name, elapsed, static_cast<double>(count));
+        std::printf("%-40s %10.3f allocations/item\n", "",
+            static_cast<double>(allocations - before) / (3.0 * count));
+    };
+
+    measure("dispatch", [&](const std::string &cmd) { tree(cmd); });
+    dispatch_context context;
+    measure("dispatch with context", [&](const std::string &cmd) { tree(cmd, context); });
+    measure("resolve", [&](const std::string &cmd) { sum += tree.resolve(cmd).id; });
+    measure("resolve + routing key", [&](const std::string &cmd)
+    {
+        std::optional<unsigned> key;
+        tree.resolve(cmd, 0, key);
+        sum += *key;
+    });
+
+    // long escaped string arguments
+    std::vector<std::string> logs;
+    tree.insert("log write", make_command([&sum](const std::string &message, std::string_view tag)
+    {
+        sum += message.size() + tag.size();
+    }));
+    for (int i = 0; i < 64; ++i)
+    {
+        logs.push_back("log write \"" + std::string(64 + i, 'm') + "\" info");
+    }
+    std::swap(cmds, logs);
+    measure("dispatch, string arguments", [&](const std::string &cmd) { tree(cmd); });
+    measure("dispatch with context, string arguments", [&](const std::string &cmd) { tree(cmd, context); });
+    std::printf("%-40s %10.3f reuse ratio %8zu bytes retained\n", "",
+        context.stats().reuse_ratio(), context.stats().bytes_retained);
+    std::swap(cmds, logs);
+
+    // scanners sending garbage command names
+    for (auto &cmd : cmds)
+    {
+        cmd.replace(0, 7, "garbage");
+    }
+    measure("dispatch, unknown command", [&](const std::string &cmd)
+    {
+        try
+        {
+            tree(cmd);
+        }
+        catch (const command_not_found_error &)
+        {
+            ++sum;
+        }
+    });
+    measure("resolve, unknown command", [&](const std::string &cmd) { sum += tree.resolve(cmd).id; });
+    tree.reject_unknown();
+    measure("try_dispatch, unknown command", [&](const std::string &cmd)
+    {
+        sum += static_cast<unsigned long long>(tree.try_dispatch(cmd));
+    });
+
+    std::printf("checksum %llu\n", sum);
+    return 0;
+}
@@ -0,0 +1,108 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/all.hpp>
+#include <ucmd-parser/script_runner.hpp>
+
+#include <string>
+#include <vector>
+#include <string_view>
+#include <cstdlib>
+
+#include "bench.hpp"
+
+// compares sequential and pipelined script execution,
+// usage: script_runner-bench [lines] [threads]
+int main(int argc, char *argv[])
+{
+    using namespace ucmdp;
+
+    const std::size_t lines = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    const unsigned int threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10)
+                                          : script_runner_options{}.threads;
+
+    long long sum = 0;
+    command_tree tree {
+        { "cluster node disk smart attrs set", make_command([&sum](int id, long long v) { sum += id ^ v; }) },
+        { "cluster node disk smart attrs get", make_command([&sum](int id) { sum += id; }) },
+        { "cluster node net link up", make_command([&sum](std::string_view name) { sum += name.size(); }) },
+        { "cluster node net link down", make_command([&sum]() { ++sum; }) }
+    };
+
+    std::string script;
+    for (std::size_t i = 0; i < lines; ++i)
+    {
+        switch (i % 4)
+        {
+        case 0:
+            script += "cluster node disk smart attrs set " + std::to_string(i % 100) + " " + std::to_string(i) + "\n";
+            break;
+        case 1:
+            script += "cluster node disk smart attrs get " + std::to_string(i % 100) + "\n";
+            break;
+        case 2:
+            script += "cluster node net link up \"eth " + std::to_string(i % 8) + "\"\n";
+            break;
+        default:
+            script += "cluster node net link down\n";
+        }
+    }
+
+    auto sequential = bench::best_of(3, [&]()
+    {
+        script_runner{ tree }.run_sequential(script);
+    });
+    bench::report("sequential", sequential, static_cast<double>(lines));
+
+    script_runner_options options;
+    options.threads = threads;
+    auto parallel = bench::best_of(3, [&]()
+    {
+        script_runner{ tree, options }.run(script);
+    });
+    std::string name = "pipelined (" + std::to_string(threads) + " resolver threads)";
+    bench::report(name.c_str(), parallel, static_cast<double>(lines));
+
+    // the share of the work left to the calling thread once the workers
+    // have parsed the lines, i.e. the bound of the pipelined speedup
+    std::vector<std::string_view> scriptLines;
+    for (std::size_t pos = 0; pos < script.size();)
+    {
+        const auto end = script.find('\n', pos);
+        scriptLines.push_back(std::string_view{ script }.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    auto dispatch = bench::best_of(3, [&]()
+    {
+        for (auto line : scriptLines)
+        {
+            tree(line);
+        }
+    });
+    bench::report("dispatch", dispatch, static_cast<double>(lines));
+    std::vector<command_tree::prepared_command> parsed;
+    parsed.reserve(scriptLines.size());
+    auto parsing = bench::best_of(3, [&]()
+    {
+        parsed.clear();
+        for (auto line : scriptLines)
+        {
+            parsed.push_back(tree.parse(line));
+        }
+    });
+    bench::report("parse (worker side)", parsing, static_cast<double>(lines));
+    auto invoking = bench::best_of(3, [&]()
+    {
+        for (auto &cmd : parsed)
+        {
+            tree.execute(cmd);
+        }
+    });
+    bench::report("execute parsed (calling thread)", invoking, static_cast<double>(lines));
+
+    std::printf("speedup: %.2fx, calling thread bound: %.2fx (checksum %lld)\n",
+        sequential / parallel, dispatch / invoking, sum);
+    return 0;
+}
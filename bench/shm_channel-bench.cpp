@@ -0,0 +1,62 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/all.hpp>
+#include <ucmd-parser/shm_channel.hpp>
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.hpp"
+
+// round trips pipelined commands from a client process through a
+// shm_command_server, usage: shm_channel-bench [commands]
+int main(int argc, char *argv[])
+{
+    using namespace ucmdp;
+    using namespace std::chrono_literals;
+
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const std::string name = "ucmdp-shm_channel-bench-" + std::to_string(::getpid());
+
+    command_tree tree;
+    tree.insert("config set value", make_command([](int v) { return v + 1; }));
+    shm_command_server server{ name, 1 << 16 };
+
+    const auto child = ::fork();
+    if (child == 0)
+    {
+        shm_command_client client{ name };
+        std::size_t sent = 0;
+        std::size_t received = 0;
+        while (received < count)
+        {
+            while (sent < count && client.send("config set value 42", 0ns))
+            {
+                ++sent;
+            }
+            received += client.receive([](shm_response_status, std::string_view) {}, 10ms);
+        }
+        ::_exit(0);
+    }
+
+    std::size_t served = 0;
+    auto elapsed = bench::best_of(1, [&]()
+    {
+        while (served < count)
+        {
+            served += server.serve(tree, 1s);
+        }
+    });
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    bench::report("shm round trip, pipelined", elapsed, static_cast<double>(count));
+    std::printf("served %zu, client exit status %d\n", served, WEXITSTATUS(status));
+    return 0;
+}
@@ -0,0 +1,125 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/all.hpp>
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench.hpp"
+
+namespace
+{
+    // the bytewise bracket matching the structural index replaces
+    const char * scalar_structure_end(const char *first, const char *last)
+    {
+        std::size_t depth = 0;
+        bool inString = false;
+        for (auto it = first; it != last; ++it)
+        {
+            const char c = *it;
+            if (inString)
+            {
+                if (c == '\\')
+                {
+                    ++it;
+                }
+                else if (c == '"')
+                {
+                    inString = false;
+                }
+            }
+            else if (c == '"')
+            {
+                inString = true;
+            }
+            else if (c == '[' || c == '{')
+            {
+                ++depth;
+            }
+            else if ((c == ']' || c == '}') && --depth == 0)
+            {
+                return it + 1;
+            }
+        }
+        return nullptr;
+    }
+}
+
+// measures finding the end of structured literals and dispatching a
+// command which reads a single field of one, usage: structured-bench [commands]
+int main(int argc, char *argv[])
+{
+    using namespace ucmdp;
+
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+    std::string literal = "{\"items\": [";
+    for (int i = 0; i < 64; ++i)
+    {
+        literal += (i ? ", " : "");
+        literal += "{\"id\": " + std::to_string(i) + ", \"label\": \"item number " + std::to_string(i) + "\"}";
+    }
+    literal += "], \"target\": 42}";
+    // keeps the compiler from hoisting the scans out of the loops
+    const char *volatile data = literal.data();
+    const auto size = literal.size();
+
+    std::size_t checksum = 0;
+    const double bytes = static_cast<double>(count) * static_cast<double>(literal.size());
+    auto scalar = bench::best_of(3, [&]()
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto first = data;
+            checksum += static_cast<std::size_t>(scalar_structure_end(first, first + size) - first);
+        }
+    });
+    bench::report("bytewise bracket matching (per byte)", scalar, bytes);
+    auto indexed = bench::best_of(3, [&]()
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto first = data;
+            checksum += static_cast<std::size_t>(detail::find_structure_end(first, first + size) - first);
+        }
+    });
+    bench::report("structural index (per byte)", indexed, bytes);
+
+    tokenizer_options options;
+    options.structured_literals = true;
+    command_tree tree{ options };
+    long long sum = 0;
+    tree.insert("config apply", make_command([&sum](structured_view config)
+    {
+        sum += config["target"].as<int>();
+    }));
+    const std::string cmd = "config apply " + literal;
+    tree.insert("config ignore", make_command([&sum](structured_view config)
+    {
+        sum += static_cast<long long>(config.text().size());
+    }));
+    const std::string ignoreCmd = "config ignore " + literal;
+    auto ignore = bench::best_of(3, [&]()
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            tree(ignoreCmd);
+        }
+    });
+    bench::report("dispatch, read no field", ignore, static_cast<double>(count));
+    auto dispatch = bench::best_of(3, [&]()
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            tree(cmd);
+        }
+    });
+    bench::report("dispatch, read one field", dispatch, static_cast<double>(count));
+
+    std::printf("literal %zu bytes, checksum %zu %lld\n", literal.size(), checksum, sum);
+    return 0;
+}
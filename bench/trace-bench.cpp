@@ -0,0 +1,53 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/all.hpp>
+#include <ucmd-parser/trace.hpp>
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench.hpp"
+
+// measures the dispatch overhead of the compiled in tracing hooks while
+// tracing is stopped and while it records, usage: trace-bench [commands]
+// Build it with and without UCMDP_ENABLE_TRACING to compare the stopped
+// hooks (one load and two branches per scope, four scopes per dispatch)
+// against the compiled out ones.
+int main(int argc, char *argv[])
+{
+    using namespace ucmdp;
+
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    long long sum = 0;
+    command_tree tree;
+    tree.insert("config set value", make_command([&sum](int v) { sum += v; }));
+    const std::string cmd = "config set value 42";
+
+    auto dispatch = [&]()
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            tree(cmd);
+        }
+    };
+
+    bench::report("dispatch, tracing stopped", bench::best_of(3, dispatch), static_cast<double>(count));
+
+    // one dispatch records four events
+    start_tracing(4 * count);
+    auto traced = bench::best_of(1, dispatch);
+    stop_tracing();
+    bench::report("dispatch, tracing", traced, static_cast<double>(count));
+
+    auto json = bench::best_of(1, [&]() { sum += static_cast<long long>(chrome_trace_json().size()); });
+    bench::report("chrome_trace_json", json, 4.0 * count);
+
+    std::printf("checksum %lld, dropped %llu\n", sum,
+        static_cast<unsigned long long>(trace_events_dropped()));
+    return 0;
+}
@@ -0,0 +1,98 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/all.hpp>
+#include <ucmd-parser/tree_image.hpp>
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench.hpp"
+
+// compares building a command_tree from registrations with loading a
+// frozen image of it, usage: tree_image-bench [commands] [image path]
+int main(int argc, char *argv[])
+{
+    using namespace ucmdp;
+
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    const std::string path = argc > 2 ? argv[2] : "tree_image-bench.image";
+
+    long long sum = 0;
+    const auto action = make_command([&sum](int v) { sum += v; });
+    std::vector<std::string> names;
+    frozen_command_tree::registration_table registrations;
+    names.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        names.push_back("service" + std::to_string(i % 97) + " component" + std::to_string(i % 1013)
+            + " setting" + std::to_string(i));
+    }
+    for (auto &name : names)
+    {
+        registrations.emplace_back(name, action);
+    }
+
+    {
+        command_tree tree;
+        for (auto &[name, cmd] : registrations)
+        {
+            tree.insert(name, cmd);
+        }
+        frozen_command_tree::write_image(tree, path);
+    }
+
+    auto build = bench::best_of(3, [&]()
+    {
+        command_tree tree;
+        for (auto &[name, cmd] : registrations)
+        {
+            tree.insert(name, cmd);
+        }
+    });
+    bench::report("build command_tree", build, static_cast<double>(count));
+
+    auto load = bench::best_of(3, [&]()
+    {
+        frozen_command_tree frozen{ path, registrations };
+    });
+    bench::report("load frozen_command_tree", load, static_cast<double>(count));
+
+    command_tree tree;
+    for (auto &[name, cmd] : registrations)
+    {
+        tree.insert(name, cmd);
+    }
+    frozen_command_tree frozen{ path, registrations };
+    std::vector<std::string> commands;
+    commands.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        commands.push_back(names[(i * 7919) % count] + " " + std::to_string(i % 100));
+    }
+
+    auto dispatch = bench::best_of(3, [&]()
+    {
+        for (auto &cmd : commands)
+        {
+            tree(cmd);
+        }
+    });
+    bench::report("dispatch command_tree", dispatch, static_cast<double>(count));
+
+    auto frozenDispatch = bench::best_of(3, [&]()
+    {
+        for (auto &cmd : commands)
+        {
+            frozen(cmd);
+        }
+    });
+    bench::report("dispatch frozen_command_tree", frozenDispatch, static_cast<double>(count));
+
+    std::printf("checksum %lld\n", sum);
+    std::remove(path.c_str());
+    return 0;
+}
@@ -7,5 +7,11 @@
 
 #include "serializer.hpp"
 #include "number_serializer.hpp"
+#include "container_serializer.hpp"
+#include "unit_serializer.hpp"
+#include "enum_serializer.hpp"
+#include "structured_view.hpp"
+#include "options.hpp"
 #include "command.hpp"
 #include "command_tree.hpp"
+#include "dispatch_context.hpp"
@@ -0,0 +1,107 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <functional>
+#include <string_view>
+
+#include "detail/token_stream.hpp"
+
+namespace ucmdp
+{
+
+
+enum class coalesce_policy
+{
+    // runs the last command of a batch with a given key
+    keep_last,
+    // runs the first command of a batch with a given key
+    keep_first,
+};
+
+// extracts the key of a coalescible command from its arguments. Commands of
+// a batch with the same path and key supersede each other, commands without
+// a key (nullopt) always run. The key must be a view into arguments.
+using coalesce_key_extractor = std::function<
+    std::optional<std::string_view>(std::string_view arguments, const tokenizer_options &options)>;
+
+// uses the argument at index as it has been written as key, i.e. commands
+// which spell the same value differently aren't coalesced
+inline coalesce_key_extractor coalesce_by_argument(std::size_t index)
+{
+    return [index](std::string_view arguments, const tokenizer_options &options)
+        -> std::optional<std::string_view>
+    {
+        detail::cmd_token_stream args{ arguments, options };
+        std::string unescapeBuffer;
+        for (auto i = index; i != 0 && args; --i)
+        {
+            args.next(unescapeBuffer);
+        }
+        if (!args)
+        {
+            return std::nullopt;
+        }
+        const auto begin = args.remaining();
+        auto token = args.next(unescapeBuffer);
+        if (token.data() != unescapeBuffer.data())
+        {
+            return token;
+        }
+        // an unescaped token, the key is its escaped form
+        auto key = begin.substr(0, begin.size() - args.remaining().size());
+        while (!key.empty() && key.back() == detail::cmd_token_stream::separator_char)
+        {
+            key.remove_suffix(1);
+        }
+        return key;
+    };
+}
+
+struct coalescing_stats
+{
+    // the coalescible commands which have been run
+    std::uint64_t executed;
+    // the commands which have been skipped in favour of another one
+    std::uint64_t coalesced;
+};
+
+
+}
+
+namespace ucmdp::detail
+{
+
+
+struct coalesce_rule
+{
+    coalesce_rule(coalesce_key_extractor extractor, coalesce_policy policy)
+        : key(std::move(extractor))
+        , policy(policy)
+    {
+    }
+
+    coalescing_stats stats() const
+    {
+        return {
+            executed.load(std::memory_order_relaxed),
+            coalesced.load(std::memory_order_relaxed)
+        };
+    }
+
+    const coalesce_key_extractor key;
+    const coalesce_policy policy;
+    std::atomic<std::uint64_t> executed{ 0 };
+    std::atomic<std::uint64_t> coalesced{ 0 };
+};
+
+
+}
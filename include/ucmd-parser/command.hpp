@@ -5,7 +5,10 @@
 //
 #pragma once
 
+#include <array>
 #include <tuple>
+#include <memory>
+#include <string>
 #include <optional>
 #include <functional>
 #include <type_traits>
@@ -15,6 +18,8 @@
 #include <boost/config.hpp>
 
 #include "detail/token_stream.hpp"
+#include "detail/dispatch_scope.hpp"
+#include "trace.hpp"
 #include "command_delegate.hpp"
 #include "serializer.hpp"
 #include "number_serializer.hpp"
@@ -23,8 +28,11 @@ namespace ucmdp::detail
 {
 
 
+// tokens which don't need to be unescaped are passed to the serializer as
+// views into the command string, all others are unescaped into scratch.
+// Therefore scratch must outlive Arg if Arg is a std::string_view.
 template< typename Arg >
-void parse_arg(cmd_token_stream &cmdTokenStream, Arg &dest)
+void parse_arg(cmd_token_stream &cmdTokenStream, Arg &dest, std::string &scratch)
 {
     if constexpr (is_token_consumer_v<Arg>)
     {
@@ -36,7 +44,7 @@ void parse_arg(cmd_token_stream &cmdTokenStream, Arg &dest)
         {
             dest.emplace();
 
-            auto token = cmdTokenStream.next();
+            auto token = cmdTokenStream.next(scratch);
             serialization_traits<typename Arg::value_type>{}
                 .deserialize(token, *dest);
         }
@@ -45,7 +53,7 @@ void parse_arg(cmd_token_stream &cmdTokenStream, Arg &dest)
     {
         if (cmdTokenStream)
         {
-            auto token = cmdTokenStream.next();
+            auto token = cmdTokenStream.next(scratch);
             serialization_traits<Arg>{}.deserialize(token, dest);
         }
         else
@@ -57,26 +65,41 @@ void parse_arg(cmd_token_stream &cmdTokenStream, Arg &dest)
     }
 }
 
-template< size_t i, typename... Args >
+template< size_t i, typename... Args, size_t N >
 void parse_args([[maybe_unused]] cmd_token_stream &cmdTokenStream,
-                [[maybe_unused]] std::tuple<Args...> &out)
+                [[maybe_unused]] std::tuple<Args...> &out,
+                [[maybe_unused]] std::array<std::string, N> &scratch)
 {
     if constexpr (i < sizeof...(Args))
     {
-        parse_arg(cmdTokenStream, std::get<i>(out));
-        parse_args<i + 1>(cmdTokenStream, out);
+        parse_arg(cmdTokenStream, std::get<i>(out), scratch[i]);
+        parse_args<i + 1>(cmdTokenStream, out, scratch);
     }
 }
 template< typename... Args >
-void parse_args(cmd_token_stream &cmdTokenStream, std::tuple<Args...> &out)
+void parse_args(cmd_token_stream &cmdTokenStream, std::tuple<Args...> &out,
+                std::array<std::string, sizeof...(Args)> &scratch)
 {
-    parse_args<0>(cmdTokenStream, out);
+    parse_args<0>(cmdTokenStream, out, scratch);
 }
 
 
 template< typename T >
 using value_type_of = std::remove_const_t<std::remove_reference_t<T>>;
 
+// serializes the result of an action into the response buffer of the
+// current dispatch if there is one
+template< typename T >
+void write_response(const T &result)
+{
+    auto state = current_dispatch_state();
+    if (state && state->response)
+    {
+        auto &response = *state->response;
+        response.result = serialize_argument(response.first, response.last, result);
+    }
+}
+
 
 template< typename T >
 class command;
@@ -90,8 +113,10 @@ public:
         "Pointer arguments are not allowed for commands!");
     static_assert(std::conjunction_v<std::negation<std::is_array<value_type_of<Args>>>...>,
         "Array arguments are not allowed for commands!");
-    static_assert(std::conjunction_v<std::negation<is_string_view<value_type_of<Args>>>...>,
-        "basic_string_view arguments are not allowed for commands!");
+    static_assert(std::conjunction_v<std::disjunction<
+            std::negation<is_string_view<value_type_of<Args>>>,
+            std::is_same<value_type_of<Args>, std::string_view>>...>,
+        "std::string_view is the only supported basic_string_view argument type!");
 
 
     using argument_tuple_t = std::tuple<value_type_of<Args>...>;
@@ -102,24 +127,85 @@ public:
     {
     }
 
+    // std::string_view arguments refer either to cmd or to an unescape
+    // buffer local to this call, i.e. they are only valid until the
+    // delegate returns. The buffers are borrowed from the dispatch_context
+    // of the dispatch if there is one. cmd is tokenized with the options of the
+    // command_tree dispatching it. A non void result is serialized into
+    // the response buffer of the dispatch.
     void exec(std::string_view cmd) const
     {
         argument_tuple_t parsedArgs;
+        std::array<std::string, sizeof...(Args)> unescapeBuffers;
+        auto state = current_dispatch_state();
+        recycled_buffers<argument_tuple_t> recycled{
+            state ? state->context : nullptr, parsedArgs, unescapeBuffers
+        };
+        parse(cmd, parsedArgs, unescapeBuffers);
+        invoke_and_respond(parsedArgs);
+    }
+
+    // parses cmd like exec(), but returns an action which invokes the
+    // delegate later on. The arguments may refer to cmd, i.e. cmd must
+    // outlive the action.
+    static std::shared_ptr<const parsed_action> parse(std::shared_ptr<const command> self,
+                                                      std::string_view cmd)
+    {
+        class parsed_command final : public parsed_action
         {
-            cmd_token_stream cmdTokenStream{ cmd };
-            parse_args(cmdTokenStream, parsedArgs);
-            if (cmdTokenStream)
+        public:
+            explicit parsed_command(std::shared_ptr<const command> self)
+                : mSelf(std::move(self))
             {
-                BOOST_THROW_EXCEPTION(
-                    too_many_arguments_error{}
-                );
             }
-        }
+            void invoke() const override
+            {
+                mSelf->invoke_and_respond(mArgs);
+            }
 
-        std::apply(mDelegate, parsedArgs);
+            std::shared_ptr<const command> mSelf;
+            mutable argument_tuple_t mArgs;
+            // std::string_view arguments refer to these
+            std::array<std::string, sizeof...(Args)> mUnescapeBuffers;
+        };
+        auto parsed = std::make_shared<parsed_command>(std::move(self));
+        parse(cmd, parsed->mArgs, parsed->mUnescapeBuffers);
+        return parsed;
     }
 
 private:
+    static void parse(std::string_view cmd, argument_tuple_t &parsedArgs,
+                      std::array<std::string, sizeof...(Args)> &unescapeBuffers)
+    {
+        UCMDP_TRACE_SCOPE("parse_args", ~std::uint32_t{});
+        cmd_token_stream cmdTokenStream{ cmd, current_tokenizer_options() };
+        parse_args(cmdTokenStream, parsedArgs, unescapeBuffers);
+        if (cmdTokenStream)
+        {
+            BOOST_THROW_EXCEPTION(
+                too_many_arguments_error{}
+            );
+        }
+    }
+
+    void invoke_and_respond(argument_tuple_t &args) const
+    {
+        if constexpr (std::is_void_v<R>)
+        {
+            invoke(args);
+        }
+        else
+        {
+            write_response<value_type_of<R>>(invoke(args));
+        }
+    }
+
+    decltype(auto) invoke(argument_tuple_t &args) const
+    {
+        UCMDP_TRACE_SCOPE("handler", ~std::uint32_t{});
+        return std::apply(mDelegate, args);
+    }
+
     const delegate_t mDelegate;
 };
 
@@ -133,9 +219,18 @@ namespace ucmdp
 template< typename S >
 command_delegate make_command(std::function<S> action)
 {
-    //static_assert(std::is_same_v<typename std::function<S>::result_type, void>, "commands must not return a value");
-    detail::command<S> cmd{ std::move(action) };
-    return [cmd](std::string_view params) { cmd.exec(params); };
+    using command_t = detail::command<S>;
+    detail::command_thunk thunk;
+    thunk.command = std::make_shared<const command_t>(std::move(action));
+    thunk.exec = [](const void *cmd, std::string_view params)
+    {
+        static_cast<const command_t *>(cmd)->exec(params);
+    };
+    thunk.parse = [](const std::shared_ptr<const void> &cmd, std::string_view params)
+    {
+        return command_t::parse(std::static_pointer_cast<const command_t>(cmd), params);
+    };
+    return thunk;
 }
 
 template< typename C >
@@ -5,6 +5,7 @@
 //
 #pragma once
 
+#include <memory>
 #include <functional>
 #include <string_view>
 
@@ -16,4 +17,38 @@ namespace ucmdp
 using command_delegate = std::function<void(std::string_view)>;
 
 
+}
+
+namespace ucmdp::detail
+{
+
+
+// a command whose arguments have been parsed, invoke() runs the handler
+class parsed_action
+{
+public:
+    virtual ~parsed_action() = default;
+    virtual void invoke() const = 0;
+};
+
+// the delegate created by make_command. Besides running the command with
+// an argument string it can parse the arguments ahead into an action which
+// only invokes the handler, see command_tree::parse().
+struct command_thunk
+{
+    using exec_fn = void (*)(const void *command, std::string_view args);
+    using parse_fn = std::shared_ptr<const parsed_action> (*)(
+        const std::shared_ptr<const void> &command, std::string_view args);
+
+    std::shared_ptr<const void> command;
+    exec_fn exec;
+    parse_fn parse;
+
+    void operator()(std::string_view args) const
+    {
+        exec(command.get(), args);
+    }
+};
+
+
 }
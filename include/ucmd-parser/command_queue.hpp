@@ -0,0 +1,308 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "command_tree.hpp"
+
+namespace ucmdp
+{
+
+
+enum class overflow_policy
+{
+    // push() waits until the consumer has made room for the command
+    block,
+    // push() discards the command and counts it as dropped
+    drop,
+};
+
+// bounded multi producer/single consumer queue which stores the command
+// bytes inline in a ring buffer. Producers claim space with a CAS on the
+// head and publish a record by setting its header after copying the bytes,
+// the consumer processes records in claim order and releases them batchwise.
+class command_queue
+{
+public:
+    // capacity is rounded up to a power of two bytes
+    explicit command_queue(std::size_t capacity,
+                           overflow_policy policy = overflow_policy::block);
+    command_queue(const command_queue &) = delete;
+    command_queue & operator=(const command_queue &) = delete;
+
+    // applies the overflow policy if the queue is full. Commands which take
+    // up more than half of the capacity are always dropped.
+    bool push(std::string_view cmd);
+    // never blocks and doesn't count failures as dropped
+    bool try_push(std::string_view cmd);
+
+    // invokes f(std::string_view) for up to maxBatch queued commands. The
+    // views are valid until consume() returns. Must only be called by one
+    // thread at a time. If f throws, the command it threw for is consumed.
+    template< typename F >
+    std::size_t consume(F &&f, std::size_t maxBatch = std::numeric_limits<std::size_t>::max());
+    // invokes f(const std::string_view *cmds, std::size_t count,
+    // std::size_t &consumed) once for up to maxBatch queued commands,
+    // unless the queue is empty. If f throws, only the first consumed
+    // commands are consumed, otherwise all. The same threading rules as
+    // for consume() apply.
+    template< typename F >
+    std::size_t consume_batch(F &&f, std::size_t maxBatch = std::numeric_limits<std::size_t>::max());
+
+    std::size_t capacity() const
+    {
+        return mMask + 1;
+    }
+    std::uint64_t dropped() const
+    {
+        return mDropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    using state_type = std::uint32_t;
+    static_assert(std::atomic<state_type>::is_always_lock_free
+        && sizeof(std::atomic<state_type>) == sizeof(state_type));
+
+    // record layout: 4 byte state, command bytes, padding to 8 byte alignment
+    static constexpr std::size_t header_size = sizeof(state_type);
+    static constexpr std::size_t record_alignment = 8;
+    static constexpr state_type committed_flag = state_type{ 1 } << 31;
+    static constexpr state_type padding_flag = state_type{ 1 } << 30;
+    static constexpr state_type length_mask = padding_flag - 1;
+
+    static std::size_t round_capacity(std::size_t capacity)
+    {
+        std::size_t size = 64;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        return size;
+    }
+    static std::size_t record_size(std::size_t length)
+    {
+        return (header_size + length + record_alignment - 1) & ~(record_alignment - 1);
+    }
+
+    // records of up to half the capacity always fit into an empty queue
+    // even if they have to skip the end of the ring
+    std::size_t max_record_size() const
+    {
+        return std::min<std::size_t>(capacity() / 2, length_mask);
+    }
+
+    char * data()
+    {
+        return reinterpret_cast<char *>(mStorage.get());
+    }
+    std::atomic<state_type> & state_at(std::size_t pos)
+    {
+        return *reinterpret_cast<std::atomic<state_type> *>(data() + (pos & mMask));
+    }
+    // reads the record at tail, skipping padding, and advances tail past it.
+    // Returns false if no further record has been committed.
+    bool read_record(std::size_t first, std::size_t &tail, std::string_view &cmd);
+    void release(std::size_t first, std::size_t last);
+
+    std::unique_ptr<std::uint64_t[]> mStorage;
+    const std::size_t mMask;
+    const overflow_policy mPolicy;
+    alignas(64) std::atomic<std::size_t> mHead{ 0 };
+    alignas(64) std::atomic<std::size_t> mTail{ 0 };
+    std::atomic<std::uint64_t> mDropped{ 0 };
+    // owned by the consumer, reused by consume_batch()
+    std::vector<std::string_view> mBatch;
+    std::vector<std::size_t> mBatchEnds;
+};
+
+inline command_queue::command_queue(std::size_t capacity, overflow_policy policy)
+    : mStorage(std::make_unique<std::uint64_t[]>(round_capacity(capacity) / sizeof(std::uint64_t)))
+    , mMask(round_capacity(capacity) - 1)
+    , mPolicy(policy)
+{
+}
+
+inline bool command_queue::try_push(std::string_view cmd)
+{
+    const auto size = record_size(cmd.size());
+    if (size > max_record_size())
+    {
+        return false;
+    }
+
+    auto head = mHead.load(std::memory_order_relaxed);
+    std::size_t padding;
+    do
+    {
+        // records don't wrap, the rest of the ring is skipped instead
+        const auto offset = head & mMask;
+        padding = offset + size > capacity() ? capacity() - offset : 0;
+        // the consumer clears released records before it publishes the tail
+        const auto tail = mTail.load(std::memory_order_acquire);
+        if (head + padding + size - tail > capacity())
+        {
+            return false;
+        }
+    }
+    while (!mHead.compare_exchange_weak(head, head + padding + size,
+                                        std::memory_order_relaxed));
+
+    if (padding != 0)
+    {
+        state_at(head).store(committed_flag | padding_flag | static_cast<state_type>(padding),
+                             std::memory_order_release);
+        head += padding;
+    }
+    std::memcpy(data() + (head & mMask) + header_size, cmd.data(), cmd.size());
+    state_at(head).store(committed_flag | static_cast<state_type>(cmd.size()),
+                         std::memory_order_release);
+    return true;
+}
+
+inline bool command_queue::push(std::string_view cmd)
+{
+    if (record_size(cmd.size()) > max_record_size())
+    {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    while (!try_push(cmd))
+    {
+        if (mPolicy == overflow_policy::drop)
+        {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+template< typename F >
+inline std::size_t command_queue::consume(F &&f, std::size_t maxBatch)
+{
+    const auto first = mTail.load(std::memory_order_relaxed);
+    auto tail = first;
+    std::size_t count = 0;
+    try
+    {
+        std::string_view cmd;
+        while (count < maxBatch && read_record(first, tail, cmd))
+        {
+            ++count;
+            f(cmd);
+        }
+    }
+    catch (...)
+    {
+        release(first, tail);
+        throw;
+    }
+    release(first, tail);
+    return count;
+}
+
+template< typename F >
+inline std::size_t command_queue::consume_batch(F &&f, std::size_t maxBatch)
+{
+    const auto first = mTail.load(std::memory_order_relaxed);
+    auto tail = first;
+    mBatch.clear();
+    mBatchEnds.clear();
+    std::string_view cmd;
+    while (mBatch.size() < maxBatch && read_record(first, tail, cmd))
+    {
+        mBatch.push_back(cmd);
+        mBatchEnds.push_back(tail);
+    }
+    if (mBatch.empty())
+    {
+        release(first, tail);
+        return 0;
+    }
+
+    auto consumed = mBatch.size();
+    try
+    {
+        f(static_cast<const std::string_view *>(mBatch.data()), mBatch.size(), consumed);
+    }
+    catch (...)
+    {
+        release(first, consumed != 0 ? mBatchEnds[consumed - 1] : first);
+        throw;
+    }
+    release(first, tail);
+    return mBatch.size();
+}
+
+inline bool command_queue::read_record(std::size_t first, std::size_t &tail, std::string_view &cmd)
+{
+    // producers can't claim more than one lap beyond the released tail,
+    // i.e. anything behind that is a record consumed in this batch
+    while (tail - first < capacity())
+    {
+        const auto state = state_at(tail).load(std::memory_order_acquire);
+        if (!(state & committed_flag))
+        {
+            return false;
+        }
+        const auto length = state & length_mask;
+        if (state & padding_flag)
+        {
+            tail += length;
+            continue;
+        }
+        cmd = std::string_view{ data() + (tail & mMask) + header_size, length };
+        tail += record_size(length);
+        return true;
+    }
+    return false;
+}
+
+inline void command_queue::release(std::size_t first, std::size_t last)
+{
+    if (first == last)
+    {
+        return;
+    }
+    // stale bytes could otherwise be mistaken for the state of a record
+    // which is still being written
+    const auto begin = first & mMask;
+    const auto size = last - first;
+    const auto firstPart = size < capacity() - begin ? size : capacity() - begin;
+    std::memset(data() + begin, 0, firstPart);
+    std::memset(data(), 0, size - firstPart);
+    mTail.store(last, std::memory_order_release);
+}
+
+
+// dispatches up to maxBatch queued commands as batch on the calling thread
+// which must be the only consumer of queue, see command_tree::dispatch_batch.
+// Returns the number of consumed commands, including the coalesced ones. A
+// failing command is consumed and its exception propagates, the commands
+// after it stay queued.
+inline std::size_t dispatch_queued(command_queue &queue, const command_tree &tree,
+                                   std::size_t maxBatch = std::numeric_limits<std::size_t>::max())
+{
+    return queue.consume_batch(
+        [&tree](const std::string_view *cmds, std::size_t count, std::size_t &consumed)
+        {
+            tree.dispatch_batch(cmds, count, &consumed);
+        }, maxBatch);
+}
+
+
+}
@@ -6,192 +6,405 @@
 #pragma once
 
 #include <tuple>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <charconv>
+#include <optional>
+#include <string>
+#include <utility>
+#include <iterator>
+#include <functional>
 #include <string_view>
 #include <initializer_list>
 
-#include <boost/predef.h>
 #include <boost/container/flat_map.hpp>
 
+#include "config.hpp"
 #include "exceptions.hpp"
+#include "rate_limit.hpp"
+#include "coalesce.hpp"
+#include "serializer.hpp"
+#include "trace.hpp"
 #include "detail/token_stream.hpp"
+#include "detail/command_path.hpp"
+#include "detail/dispatch_scope.hpp"
+#include "detail/root_filter.hpp"
 #include "command_delegate.hpp"
+#include "dispatch_context.hpp"
 
 namespace ucmdp
 {
 
 
+class frozen_command_tree;
+
+enum class dispatch_status
+{
+    executed,
+    // shed by a rate limit before the handler has run. The arguments of
+    // commands from command_tree::parse() have already been parsed.
+    rate_limited,
+    // the command path doesn't lead to a command, see reject_unknown()
+    unknown_command,
+};
+
 class command_tree
 {
 public:
+    // identifies a command within its tree. Ids are assigned in insertion
+    // order and stay stable, i.e. inserting further commands or replacing
+    // the action of a command doesn't change them.
+    using command_id = std::uint32_t;
+    static constexpr command_id invalid_command_id = ~command_id{};
+
     class node
     {
     public:
-        using map = boost::container::flat_map<std::string, node>;
+        using map = boost::container::flat_map<std::string, node, std::less<>>;
+        using token_list = std::vector<std::string>;
 
         explicit node() = default;
-        //node(command_delegate action);
-        //node(map childs, command_delegate action = command_delegate{});
 
-        void insert(detail::cmd_token_stream &nameTokenStream, command_delegate action);
-        void operator()(detail::cmd_token_stream &params) const;
+        // creates the nodes for the given path and returns the last one
+        UCMDP_DECL node & insert(detail::cmd_token_stream &nameTokenStream);
+        // returns the node with exactly the given path or nullptr
+        node * find(detail::cmd_token_stream &nameTokenStream)
+        {
+            return const_cast<node *>(std::as_const(*this).find(nameTokenStream));
+        }
+        UCMDP_DECL const node * find(detail::cmd_token_stream &nameTokenStream) const;
+        // walks the command path in params and returns the node whose
+        // command is responsible for the remaining() part of params.
+        // Descends into mounted trees and points owner to the tree the
+        // returned node belongs to.
+        UCMDP_DECL const node & resolve(detail::cmd_token_stream &params,
+                                        const command_tree *&owner) const;
+        // like resolve(), but returns nullptr instead of throwing a
+        // command_not_found_error if params diverges from a compressed edge
+        UCMDP_DECL const node * try_resolve(detail::cmd_token_stream &params,
+                                            const command_tree *&owner) const;
+
+        command_id command() const
+        {
+            return mCommand;
+        }
 
     private:
-        void exec(std::string_view args) const;
+        friend class command_tree;
+        friend class frozen_command_tree;
+
+        UCMDP_DECL node & insert(token_list::iterator first, token_list::iterator last);
+        UCMDP_DECL token_list edge_tokens() const;
+        UCMDP_DECL void assign_edge(token_list::iterator first, token_list::iterator last);
+        UCMDP_DECL void split_edge(token_list &edge, std::size_t at);
+        UCMDP_DECL const node * walk(detail::cmd_token_stream &params,
+                                     const command_tree *&owner, bool raise) const;
 
+        // chains of single child nodes without action are compressed into
+        // the node at the end of the chain. mEdge holds the escaped names of
+        // the nodes between the map key and this node separated by spaces.
+        std::string mEdge;
         map mChilds;
-        command_delegate mAction;
+        command_id mCommand = invalid_command_id;
+        // mount points have neither childs nor a command
+        std::shared_ptr<const command_tree> mMount;
+        // applies to the commands at and below this node
+        std::shared_ptr<detail::rate_limiter> mLimiter;
     };
 
+    // a command whose path has been resolved, but which hasn't been executed
+    // yet. It refers to the command string and the tree it was prepared by.
+    class prepared_command
+    {
+    public:
+        std::string_view command() const
+        {
+            return mParams.sequence();
+        }
+        std::string_view path() const
+        {
+            return mParams.consumed();
+        }
+        std::string_view arguments() const
+        {
+            return mParams.remaining();
+        }
+        // invalid_command_id if the path doesn't lead to a command.
+        // Refers to the command table of owner().
+        command_id id() const
+        {
+            return mId;
+        }
+        // the tree the command has been inserted into, i.e. a mounted tree
+        // for commands below a mount point
+        const command_tree & owner() const
+        {
+            return *mOwner;
+        }
+        // whether the arguments have been parsed by command_tree::parse()
+        bool parsed() const
+        {
+            return static_cast<bool>(mParsed);
+        }
+
+    private:
+        friend class command_tree;
+
+        prepared_command(const command_tree &owner, command_id id,
+                         detail::cmd_token_stream params)
+            : mOwner(&owner)
+            , mId(id)
+            , mParams(params)
+        {
+        }
+
+        const command_tree *mOwner;
+        command_id mId;
+        detail::cmd_token_stream mParams;
+        // invokes the handler with the parsed arguments
+        std::shared_ptr<const detail::parsed_action> mParsed;
+    };
+
+    // the target of a command string as determined by resolve()
+    struct route
+    {
+        // invalid_command_id if the path doesn't lead to a command
+        command_id id;
+        // the tree id refers to, i.e. a mounted tree for commands below a
+        // mount point
+        const command_tree *owner;
+        // the arguments start at this offset of the command string
+        std::size_t args_offset;
+    };
+
+    // invoked by execute() before the command runs, but not for commands
+    // which have been shed by a rate limit
+    using dispatch_observer = std::function<void(const prepared_command &)>;
+
     using name_cmd_tuple = std::tuple<std::string_view, command_delegate>;
     using initializer_list = std::initializer_list<name_cmd_tuple>;
 
     explicit command_tree() = default;
     //explicit command_tree(node rootNode);
-    command_tree(initializer_list commands);
+    // the tokenizer options apply to the command path and to the arguments
+    // of delegates created by make_command
+    UCMDP_DECL explicit command_tree(tokenizer_options options);
+    UCMDP_DECL command_tree(initializer_list commands,
+                            tokenizer_options options = tokenizer_options{});
     command_tree(const command_tree &) = delete;
     command_tree & operator=(const command_tree &) = delete;
 
-    void insert(std::string_view cmd, command_delegate action);
-    void operator()(std::string_view cmd) const;
+    UCMDP_DECL void insert(std::string_view cmd, command_delegate action);
+    UCMDP_DECL void operator()(std::string_view cmd) const;
 
-private:
-    static node swallow(initializer_list commands);
-    static void insert_cmd(node &root, std::string_view fullName, command_delegate action);
+    // splits dispatching into resolving the command path and running the
+    // action. prepare() doesn't touch any mutable state and may be called
+    // concurrently with other prepare() and execute() calls.
+    UCMDP_DECL prepared_command prepare(std::string_view cmd) const;
+    // throws a rate_limited_error if the command is shed by a rate limit.
+    // The limit is checked before the arguments are parsed, unless cmd
+    // comes from parse(), i.e. has already been parsed.
+    UCMDP_DECL void execute(const prepared_command &cmd) const;
+    // like prepare(), but additionally parses the arguments of commands
+    // created by make_command, i.e. executing the result only invokes the
+    // handler. Argument errors are thrown by parse(), the arguments may
+    // refer to cmd. May be called concurrently like prepare().
+    UCMDP_DECL prepared_command parse(std::string_view cmd) const;
 
-    node mCommandTreeRoot;
-};
+    // like operator() and execute(), but shedding a command by a rate
+    // limit is reported without throwing. Other errors are still thrown.
+    // Commands from parse() have been parsed even if they are shed.
+    UCMDP_DECL dispatch_status try_dispatch(std::string_view cmd) const;
+    UCMDP_DECL dispatch_status try_execute(const prepared_command &cmd) const;
 
-/*
-inline command_tree::node::node(command_delegate action)
-    : mChilds()
-    , mAction(std::move(action))
-{
-}
-*/
+    // like operator() and execute(), but the result of the action is
+    // serialized into [first, last) with its serialization_traits. Returns
+    // the end of the result like std::to_chars, i.e. first for actions
+    // returning void and value_too_large if the result didn't fit. The
+    // action has run in either case.
+    UCMDP_DECL std::to_chars_result dispatch(std::string_view cmd, char *first, char *last) const;
+    UCMDP_DECL std::to_chars_result execute(const prepared_command &cmd,
+                                            char *first, char *last) const;
 
-/*
-inline command_tree::node::node(map childs, command_delegate action)
-    : mChilds(std::move(childs))
-    , mAction(std::move(action))
-{
-}
-*/
+    // like operator() and execute(), but the commands parse their arguments
+    // into the buffers retained by context instead of fresh ones
+    UCMDP_DECL void operator()(std::string_view cmd, dispatch_context &context) const;
+    UCMDP_DECL void execute(const prepared_command &cmd, dispatch_context &context) const;
 
-inline void command_tree::node::insert(detail::cmd_token_stream &nameTokenStream, command_delegate action)
-{
-    if (!nameTokenStream)
+    // walks the command path without running anything, e.g. to route cmd
+    // to the shard owning it. Unknown paths yield invalid_command_id instead
+    // of an exception, malformed escape sequences still throw unless the
+    // command has been rejected by its leading bytes. Allocates
+    // nothing unless path tokens need to be unescaped into a buffer larger
+    // than the small string buffer.
+    UCMDP_DECL route resolve(std::string_view cmd) const;
+    // additionally deserializes the argument at keyIndex into key with the
+    // serialization_traits of Key. key is left empty if the command is
+    // unknown or has no such argument, a malformed key throws like it
+    // would during dispatch.
+    template< typename Key >
+    route resolve(std::string_view cmd, std::size_t keyIndex, std::optional<Key> &key) const;
+
+    // recreates a prepared command for a command string whose path has been
+    // resolved to id before, e.g. by another process. Fails if id doesn't
+    // belong to a command with the canonical path path(id) or if path
+    // doesn't match the first argsOffset characters of cmd.
+    UCMDP_DECL std::optional<prepared_command> rebind(command_id id, std::string_view cmd,
+                                                      std::size_t argsOffset) const;
+
+    // the number of command ids handed out so far
+    std::size_t size() const
     {
-        mAction = std::move(action);
+        return mCommands.size();
     }
-    else
+    // the escaped command path a command was inserted with
+    std::string_view path(command_id id) const
     {
-        auto next = nameTokenStream.next();
-        auto &child = mChilds[std::move(next)];
-        child.insert(nameTokenStream, std::move(action));
+        return mCommands.at(id).path;
     }
-}
 
-inline void command_tree::node::exec(std::string_view args) const
-{
-    if (mAction)
+    // links tree as the subtree at prefix without copying it. Commands
+    // below prefix are resolved by tree and run with its tokenizer options,
+    // but are observed by this tree. Throws a mount_error if commands have
+    // been inserted below or at prefix or if tree already mounts this tree.
+    // Mounting and unmounting must not run concurrently with dispatching.
+    UCMDP_DECL void mount(std::string_view prefix, std::shared_ptr<const command_tree> tree);
+    // removes the tree mounted at prefix and returns whether there was one.
+    // Commands prepared with the mounted tree must not be executed anymore.
+    UCMDP_DECL bool unmount(std::string_view prefix);
+
+    // attaches a token bucket to prefix which all commands at and below
+    // prefix share. A command is only subject to the limit of its longest
+    // limited prefix. Commands of mounted trees are limited by the tree they
+    // have been inserted into. Setting and removing limits must not run
+    // concurrently with dispatching.
+    UCMDP_DECL void limit(std::string_view prefix, rate_limit limit);
+    // removes the limit of prefix and returns whether there was one
+    UCMDP_DECL bool unlimit(std::string_view prefix);
+    UCMDP_DECL std::optional<rate_limit_stats> limit_stats(std::string_view prefix) const;
+
+    // marks the command at path as coalescible, see dispatch_batch(). Throws
+    // a command_not_found_error if no command has been inserted at path.
+    // Must not run concurrently with dispatching.
+    UCMDP_DECL void coalesce(std::string_view path, coalesce_key_extractor key,
+                             coalesce_policy policy = coalesce_policy::keep_last);
+    // returns whether the command at path has been coalescible
+    UCMDP_DECL bool uncoalesce(std::string_view path);
+    UCMDP_DECL std::optional<coalescing_stats> coalesce_stats(std::string_view path) const;
+
+    // dispatches count commands in order, except that of the coalescible
+    // commands with the same path and key only the last (or first) one runs
+    // at its position in the batch. Returns the number of commands which
+    // have run. If a command throws, the exception propagates and the
+    // remaining commands don't run; consumed is set to the number of
+    // commands which have either run, been skipped or thrown.
+    UCMDP_DECL std::size_t dispatch_batch(const std::string_view *cmds, std::size_t count,
+                                          std::size_t *consumed = nullptr) const;
+
+    // dispatches the statements of line in order. Statements are separated
+    // by ';' or "&&" outside of quotes, a statement following "&&" only runs
+    // if the previous one has run successfully. Empty statements are
+    // ignored. The statements are dispatched as views into line. Returns
+    // the number of statements which have run successfully; if a statement
+    // has failed, the first exception is rethrown after the remaining
+    // statements have been processed with its statement_info attached.
+    UCMDP_DECL std::size_t dispatch_line(std::string_view line) const;
+
+    // makes try_dispatch() report commands whose path doesn't lead to a
+    // command as dispatch_status::unknown_command instead of throwing a
+    // command_not_found_error. A filter over the first two tokens of the
+    // inserted paths rejects most of them before they are tokenized. Must
+    // not be changed concurrently with dispatching.
+    void reject_unknown(bool enable = true)
     {
-        mAction(args);
+        mRejectUnknown = enable;
     }
-    else
+
+    // the observer must be set before the tree is used concurrently
+    void observe(dispatch_observer observer)
     {
-        BOOST_THROW_EXCEPTION(
-            command_not_found_error{}
-        );
+        mObserver = std::move(observer);
     }
-}
 
-inline void command_tree::node::operator()(detail::cmd_token_stream &params) const
-{
-    std::string_view cmd_part = params.consumed();
-    try
+private:
+    friend class frozen_command_tree;
+    friend class shm_command_server;
+
+    struct command_entry
     {
-        if (params)
-        {
-            auto fullParamStr = params.remaining();
-            auto currentParam = params.next();
-            if (auto childCmdIter = mChilds.find(currentParam);
-                    childCmdIter != mChilds.end())
-            {
-                childCmdIter->second(params);
-            }
-            else
-            {
-                try
-                {
-                    exec(fullParamStr);
-                }
-                catch (boost::exception &exc)
-                {
-                    exc << arg_part_info(std::string{fullParamStr});
-                    exc << last_token_info{ std::move(currentParam) };
-                    throw;
-                }
-            }
-        }
-        else
-        {
-            exec("");
-        }
-    }
-    catch (boost::exception &exc)
+        std::string path;
+        command_delegate action;
+        // the limiter of the longest limited prefix
+        std::shared_ptr<detail::rate_limiter> limiter;
+        std::shared_ptr<detail::coalesce_rule> coalescer;
+    };
+
+    UCMDP_DECL static std::string canonical_path(std::string_view cmd);
+    UCMDP_DECL bool mounts(const command_tree &tree) const;
+    UCMDP_DECL std::shared_ptr<detail::rate_limiter> inherited_limiter(std::string_view path) const;
+    UCMDP_DECL void update_limiters();
+    UCMDP_DECL void filter_path(std::string_view path);
+    command_entry * find_command(std::string_view path)
     {
-        exc << command_part_info(std::string{cmd_part});
-        throw;
+        return const_cast<command_entry *>(std::as_const(*this).find_command(path));
     }
-}
+    UCMDP_DECL const command_entry * find_command(std::string_view path) const;
+    UCMDP_DECL dispatch_status execute_into(const prepared_command &cmd,
+                                            detail::response_buffer *response,
+                                            dispatch_context *context = nullptr) const;
+    UCMDP_DECL void run(const prepared_command &cmd) const;
+    // attaches the command and argument parts of params to exc
+    UCMDP_DECL static void annotate(boost::exception &exc, const detail::cmd_token_stream &params);
+
+    node mCommandTreeRoot;
+    std::vector<command_entry> mCommands;
+    tokenizer_options mTokenizerOptions;
+    dispatch_observer mObserver;
+    detail::root_filter mRootFilter;
+    bool mLimited = false;
+    bool mRejectUnknown = false;
+};
 
-/*
-inline command_tree::command_tree(node rootNode)
-    : mCommandTreeRoot(std::move(rootNode))
-{
-}
-*/
 
-inline command_tree::command_tree(initializer_list cmds)
-    : mCommandTreeRoot(swallow(cmds))
-{
 }
 
-inline void command_tree::insert_cmd(node &root, std::string_view fullName, command_delegate action)
+namespace ucmdp
 {
-    detail::cmd_token_stream nameTokenStream { fullName };
 
-    root.insert(nameTokenStream, action);
-}
 
-inline auto command_tree::swallow(initializer_list cmds)
-    -> node
+template< typename Key >
+inline auto command_tree::resolve(std::string_view cmd, std::size_t keyIndex,
+                                  std::optional<Key> &key) const
+    -> route
 {
-    node root;
-#if BOOST_COMP_MSVC <= BOOST_VERSION_NUMBER(19,11,0)
-    for (auto& t : cmds)
+    static_assert(!is_string_view_v<Key>,
+        "an unescaped key would refer to a buffer local to resolve()");
+
+    key.reset();
+    const auto target = resolve(cmd);
+    if (target.id == invalid_command_id)
     {
-        insert_cmd(root, std::move(std::get<0>(t)), std::move(std::get<1>(t)));
+        return target;
     }
-#else
-    for (auto& [cmdName, cmdDelegate] : cmds)
+    detail::cmd_token_stream args{ cmd, target.owner->mTokenizerOptions };
+    args.skip_to(target.args_offset);
+    std::string unescapeBuffer;
+    for (; keyIndex != 0 && args; --keyIndex)
     {
-        insert_cmd(root, std::move(cmdName), std::move(cmdDelegate));
+        args.next(unescapeBuffer);
     }
-#endif
-    return root;
+    if (args)
+    {
+        auto token = args.next(unescapeBuffer);
+        serialization_traits<Key>{}.deserialize(token, key.emplace());
+    }
+    return target;
 }
 
-inline void command_tree::insert(std::string_view cmd, command_delegate action)
-{
-    insert_cmd(mCommandTreeRoot, cmd, action);
-}
 
-inline void command_tree::operator()(std::string_view cmd) const
-{
-    detail::cmd_token_stream cmdTokenStream { cmd };
-    mCommandTreeRoot(cmdTokenStream);
 }
 
-
-}
+#if defined(UCMDP_HEADER_ONLY)
+#include "impl/command_tree.ipp"
+#endif
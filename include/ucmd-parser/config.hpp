@@ -0,0 +1,17 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+// The library is header-only by default. If UCMDP_SEPARATE_COMPILATION is
+// defined, e.g. by linking the cmd-tree-parser-core target, the headers
+// only declare the non-template functions and the definitions are taken
+// from the compiled core library instead (see src/cmd-tree-parser-core.cpp).
+#if defined(UCMDP_SEPARATE_COMPILATION)
+#   define UCMDP_DECL
+#else
+#   define UCMDP_HEADER_ONLY 1
+#   define UCMDP_DECL inline
+#endif
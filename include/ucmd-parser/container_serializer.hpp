@@ -0,0 +1,198 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <charconv>
+#include <type_traits>
+#include <string_view>
+#include <system_error>
+
+#include "exceptions.hpp"
+#include "serializer.hpp"
+#include "number_serializer.hpp"
+#include "detail/token_stream.hpp"
+
+namespace ucmdp
+{
+
+
+// consumes the unparsed remainder of the command string. Like a
+// std::string_view argument it must not outlive the command call.
+struct rest_of_line
+{
+    std::string_view text;
+};
+
+
+}
+
+namespace ucmdp::detail
+{
+
+
+template< typename T >
+constexpr bool has_fast_number_path_v
+    = (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+    || std::is_same_v<T, float>
+    || std::is_same_v<T, double>;
+
+// parses plain decimal tokens with std::from_chars and returns false if the
+// token uses a notation which only the strto* based serializers understand
+// (sign prefixes, octal/hex literals, out of range values, ...).
+template< typename T >
+inline bool try_parse_number_fast(std::string_view token, T &dest)
+{
+    if (token.empty() || token[0] == '+')
+    {
+        return false;
+    }
+    if constexpr (std::is_integral_v<T>)
+    {
+        // strtol with base 0 interprets leading zeros as octal prefix
+        auto digits = token[0] == '-' ? token.substr(1) : token;
+        if (digits.size() > 1 && digits[0] == '0')
+        {
+            return false;
+        }
+        if constexpr (std::is_unsigned_v<T>)
+        {
+            // strtoul accepts and negates signed input
+            if (token[0] == '-')
+            {
+                return false;
+            }
+        }
+    }
+    else
+    {
+        if (token.find_first_of("xX") != std::string_view::npos)
+        {
+            return false;
+        }
+    }
+
+    const auto end = token.data() + token.size();
+    auto [ptr, ec] = std::from_chars(token.data(), end, dest);
+    return ec == std::errc{} && ptr == end;
+}
+
+template< typename T >
+inline void deserialize_element(std::string_view token, T &dest)
+{
+    if constexpr (has_fast_number_path_v<T>)
+    {
+        if (try_parse_number_fast(token, dest))
+        {
+            return;
+        }
+    }
+    serialization_traits<T>{}.deserialize(token, dest);
+}
+
+// writes the elements of range as separate tokens
+template< typename Range >
+inline std::to_chars_result serialize_elements(char *first, char *last, const Range &range)
+{
+    std::to_chars_result result{ first, std::errc{} };
+    for (auto &elem : range)
+    {
+        result = append_argument(result.ptr, last, result.ptr != first, elem);
+        if (result.ec != std::errc{})
+        {
+            break;
+        }
+    }
+    return result;
+}
+
+template< typename T >
+struct element_constraints
+{
+    static_assert(!is_string_view_v<T>,
+        "string_view elements would dangle, use std::string instead!");
+    static_assert(!is_optional_v<T> && !is_token_consumer_v<T>,
+        "container elements must be deserializable from a single token!");
+};
+
+
+}
+
+namespace ucmdp
+{
+
+
+// consumes all remaining tokens, i.e. it should be the last command argument.
+template< typename T, typename Allocator >
+struct serialization_traits< std::vector<T, Allocator> >
+    : private detail::element_constraints<T>
+{
+    void deserialize(detail::cmd_token_stream &tokens, std::vector<T, Allocator> &out)
+    {
+        const auto offset = out.size();
+        out.resize(offset + tokens.count_remaining());
+
+        std::string scratch;
+        for (auto it = out.begin() + offset, end = out.end(); it != end; ++it)
+        {
+            detail::deserialize_element(tokens.next(scratch), *it);
+        }
+    }
+    std::to_chars_result serialize(char *first, char *last,
+                                   const std::vector<T, Allocator> &in) const
+    {
+        return detail::serialize_elements(first, last, in);
+    }
+};
+
+template< typename T, std::size_t N >
+struct serialization_traits< std::array<T, N> >
+    : private detail::element_constraints<T>
+{
+    void deserialize(detail::cmd_token_stream &tokens, std::array<T, N> &out)
+    {
+        std::string scratch;
+        for (auto &elem : out)
+        {
+            if (!tokens)
+            {
+                BOOST_THROW_EXCEPTION(
+                    not_enough_arguments_error{}
+                );
+            }
+            detail::deserialize_element(tokens.next(scratch), elem);
+        }
+    }
+    std::to_chars_result serialize(char *first, char *last, const std::array<T, N> &in) const
+    {
+        return detail::serialize_elements(first, last, in);
+    }
+};
+
+template< >
+struct serialization_traits< rest_of_line >
+{
+    void deserialize(detail::cmd_token_stream &tokens, rest_of_line &out)
+    {
+        out.text = tokens.skip_remaining();
+    }
+    // the text is written verbatim, i.e. it must already be escaped
+    std::to_chars_result serialize(char *first, char *last, const rest_of_line &in) const
+    {
+        if (static_cast<std::size_t>(last - first) < in.text.size())
+        {
+            return { last, std::errc::value_too_large };
+        }
+        return { std::copy(in.text.begin(), in.text.end(), first), std::errc{} };
+    }
+};
+
+
+}
@@ -0,0 +1,86 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <boost/config.hpp>
+
+#include "../config.hpp"
+#include "../exceptions.hpp"
+#include "../command_delegate.hpp"
+#include "token_stream.hpp"
+
+namespace ucmdp::detail
+{
+
+
+// The command path walk of command_tree and frozen_command_tree, which
+// only differ by their node layout.
+
+// consumes the tokens of the escaped compressed edge from params. Returns
+// false or throws a command_not_found_error depending on raise if params
+// diverges from it.
+UCMDP_DECL bool match_edge(std::string_view edge, cmd_token_stream &params, bool raise);
+
+// walks the command path in params from root and returns the node whose
+// command is responsible for the remaining() part of params or nullptr if
+// params diverges from an edge without raise. Layout provides
+// edge(node), enter(node) which returns the node to continue with, e.g. the
+// root of a mounted tree, has_childs(node) and find_child(node, token).
+template< typename Node, typename Layout >
+inline const Node * walk_path(const Node *root, cmd_token_stream &params,
+                              const Layout &layout, bool raise)
+{
+    const Node *current = root;
+    std::string unescapeBuffer;
+    try
+    {
+        for (;;)
+        {
+            if (!match_edge(layout.edge(*current), params, raise))
+            {
+                return nullptr;
+            }
+            current = layout.enter(current);
+            // the arguments of leaves aren't looked at, e.g. a large
+            // structured literal is only scanned when it is parsed
+            if (!params || !layout.has_childs(*current))
+            {
+                return current;
+            }
+
+            auto lookahead = params;
+            auto currentParam = lookahead.next(unescapeBuffer);
+            const Node *child = layout.find_child(*current, currentParam);
+            if (!child)
+            {
+                return current;
+            }
+            params = lookahead;
+            current = child;
+        }
+    }
+    catch (boost::exception &exc)
+    {
+        exc << command_part_info(std::string{ params.consumed() });
+        throw;
+    }
+}
+
+// runs action with the raw argument string args, action may be nullptr for
+// unknown commands. Delegates not created by make_command get the raw
+// argument string, i.e. it is validated like the tokens it would consist of.
+UCMDP_DECL void run_delegate(const command_delegate *action, std::string_view args,
+                             const tokenizer_options &options);
+
+
+}
+
+#if defined(UCMDP_HEADER_ONLY)
+#include "impl/command_path.ipp"
+#endif
@@ -0,0 +1,71 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <utility>
+#include <charconv>
+#include <system_error>
+
+#include "token_stream.hpp"
+#include "../dispatch_context.hpp"
+
+namespace ucmdp::detail
+{
+
+
+// the caller provided buffer the result of an action is serialized into.
+// result is reported like std::to_chars and initially denotes no output.
+struct response_buffer
+{
+    char *first;
+    char *last;
+    std::to_chars_result result{ first, std::errc{} };
+};
+
+// state of the innermost command_tree dispatch on this thread which can't
+// be passed through the command_delegate signature.
+struct dispatch_state
+{
+    tokenizer_options tokenizer;
+    // nullptr if the caller isn't interested in the result
+    response_buffer *response = nullptr;
+    // lends argument buffers to the command, nullptr if they are allocated
+    // per call
+    dispatch_context *context = nullptr;
+};
+
+inline dispatch_state *& current_dispatch_state() noexcept
+{
+    static thread_local dispatch_state *state = nullptr;
+    return state;
+}
+
+class dispatch_scope
+{
+public:
+    explicit dispatch_scope(dispatch_state &state) noexcept
+        : mPrevious(std::exchange(current_dispatch_state(), &state))
+    {
+    }
+    ~dispatch_scope()
+    {
+        current_dispatch_state() = mPrevious;
+    }
+    dispatch_scope(const dispatch_scope &) = delete;
+    dispatch_scope & operator=(const dispatch_scope &) = delete;
+
+private:
+    dispatch_state *mPrevious;
+};
+
+inline tokenizer_options current_tokenizer_options() noexcept
+{
+    auto state = current_dispatch_state();
+    return state ? state->tokenizer : tokenizer_options{};
+}
+
+
+}
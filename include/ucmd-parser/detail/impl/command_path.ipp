@@ -0,0 +1,87 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "../command_path.hpp"
+#include "../utf8.hpp"
+
+namespace ucmdp::detail
+{
+
+
+UCMDP_DECL bool match_edge(std::string_view edge, cmd_token_stream &params, bool raise)
+{
+    // the escaped edge is canonical, i.e. a bytewise match implies a
+    // tokenwise match and only differently quoted input takes the slow path
+    if (edge.empty() || params.skip_prefix(edge))
+    {
+        return true;
+    }
+
+    cmd_token_stream edgeTokenStream{ edge };
+    std::string edgeBuffer;
+    std::string paramBuffer;
+    while (edgeTokenStream)
+    {
+        auto expected = edgeTokenStream.next(edgeBuffer);
+        if (!params)
+        {
+            if (!raise)
+            {
+                return false;
+            }
+            BOOST_THROW_EXCEPTION(
+                command_not_found_error{}
+            );
+        }
+        auto fullParamStr = params.remaining();
+        auto currentParam = params.next(paramBuffer);
+        if (currentParam != expected)
+        {
+            if (!raise)
+            {
+                return false;
+            }
+            BOOST_THROW_EXCEPTION(
+                command_not_found_error{}
+                    << arg_part_info(std::string{fullParamStr})
+                    << last_token_info{ std::string{currentParam} }
+            );
+        }
+    }
+    return true;
+}
+
+UCMDP_DECL void run_delegate(const command_delegate *action, std::string_view args,
+                             const tokenizer_options &options)
+{
+    if (!action || !*action)
+    {
+        BOOST_THROW_EXCEPTION(
+            command_not_found_error{}
+        );
+    }
+    if ((options.validate_utf8 || options.unicode_whitespace)
+        && !action->target<command_thunk>())
+    {
+        const auto end = args.data() + args.size();
+        if (auto invalid = find_invalid_utf8(args.data(), end); invalid != end)
+        {
+            BOOST_THROW_EXCEPTION(
+                invalid_utf8_error{}
+                    << input_offset_info{ static_cast<std::size_t>(invalid - args.data()) }
+            );
+        }
+    }
+    (*action)(args);
+}
+
+
+}
@@ -0,0 +1,380 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "../token_stream.hpp"
+#include "../utf8.hpp"
+#include "../structural_index.hpp"
+
+namespace ucmdp::detail
+{
+
+
+UCMDP_DECL std::string_view cmd_token_stream::next(std::string &scratch)
+{
+    const auto size = mSequence.size();
+    if (mNextPos == size)
+    {
+        BOOST_THROW_EXCEPTION(
+            end_of_token_stream_error{}
+        );
+    }
+
+    const auto data = mSequence.data();
+    if (mOptions.structured_literals
+        && (data[mNextPos] == '[' || data[mNextPos] == '{'))
+    {
+        return next_structure();
+    }
+    const bool decode = mOptions.validate_utf8 || mOptions.unicode_whitespace;
+    const auto begin = mNextPos;
+    auto pos = begin;
+    bool unescaped = false;
+    bool inQuote = false;
+    while (pos != size)
+    {
+        const auto special = static_cast<std::size_t>(
+            find_token_special(data + pos, data + size,
+                separator_char, escape_char, quote_char,
+                decode, mOptions.unicode_whitespace) - data);
+        if (unescaped)
+        {
+            scratch.append(data + pos, special - pos);
+        }
+        pos = special;
+        if (pos == size)
+        {
+            break;
+        }
+
+        const char c = data[pos];
+        if (c == escape_char || c == quote_char)
+        {
+            if (!unescaped)
+            {
+                scratch.assign(data + begin, pos - begin);
+                unescaped = true;
+            }
+            if (c == quote_char)
+            {
+                inQuote = !inQuote;
+            }
+            else if (++pos == size)
+            {
+                BOOST_THROW_EXCEPTION(
+                    invalid_escape_sequence_error{}
+                );
+            }
+            else
+            {
+                scratch.push_back(unescape(data[pos]));
+            }
+            ++pos;
+            continue;
+        }
+
+        std::size_t width = 1;
+        bool separator = c == separator_char;
+        if (!separator)
+        {
+            char32_t cp = static_cast<unsigned char>(c);
+            if (cp >= 0x80)
+            {
+                width = decode_utf8(data + pos, data + size, cp);
+                if (width == 0)
+                {
+                    BOOST_THROW_EXCEPTION(
+                        invalid_utf8_error{}
+                            << input_offset_info{ pos }
+                    );
+                }
+            }
+            separator = mOptions.unicode_whitespace && is_unicode_space(cp);
+        }
+        if (separator && !inQuote)
+        {
+            mNextPos = pos + width;
+            return unescaped
+                ? std::string_view{ scratch }
+                : mSequence.substr(begin, pos - begin);
+        }
+        if (unescaped)
+        {
+            scratch.append(data + pos, width);
+        }
+        pos += width;
+    }
+    mNextPos = size;
+    return unescaped
+        ? std::string_view{ scratch }
+        : mSequence.substr(begin, size - begin);
+}
+
+UCMDP_DECL std::string_view cmd_token_stream::skip_remaining()
+{
+    const auto data = mSequence.data();
+    const auto begin = mNextPos;
+    const auto end = data + mSequence.size();
+    if (mOptions.validate_utf8 || mOptions.unicode_whitespace)
+    {
+        if (auto invalid = find_invalid_utf8(data + begin, end); invalid != end)
+        {
+            BOOST_THROW_EXCEPTION(
+                invalid_utf8_error{}
+                    << input_offset_info{ static_cast<std::size_t>(invalid - data) }
+            );
+        }
+    }
+    mNextPos = mSequence.size();
+    return mSequence.substr(begin);
+}
+
+UCMDP_DECL std::string_view cmd_token_stream::next_structure()
+{
+    const auto size = mSequence.size();
+    const auto data = mSequence.data();
+    const auto begin = mNextPos;
+    const auto end = find_structure_end(data + begin, data + size);
+    if (end == nullptr)
+    {
+        BOOST_THROW_EXCEPTION(
+            structured_literal_error{}
+                << input_offset_info{ begin }
+        );
+    }
+    auto pos = static_cast<std::size_t>(end - data);
+
+    if (mOptions.validate_utf8 || mOptions.unicode_whitespace)
+    {
+        if (auto invalid = find_invalid_utf8(data + begin, end); invalid != end)
+        {
+            BOOST_THROW_EXCEPTION(
+                invalid_utf8_error{}
+                    << input_offset_info{ static_cast<std::size_t>(invalid - data) }
+            );
+        }
+    }
+
+    // the literal must be a token on its own
+    std::size_t width = 0;
+    if (pos != size)
+    {
+        char32_t cp = static_cast<unsigned char>(data[pos]);
+        if (cp == static_cast<unsigned char>(separator_char))
+        {
+            width = 1;
+        }
+        else if (mOptions.unicode_whitespace)
+        {
+            width = cp < 0x80 ? 1 : decode_utf8(data + pos, data + size, cp);
+            if (width == 0 || !is_unicode_space(cp))
+            {
+                width = 0;
+            }
+        }
+        if (width == 0)
+        {
+            BOOST_THROW_EXCEPTION(
+                structured_literal_error{}
+                    << input_offset_info{ pos }
+            );
+        }
+    }
+    mNextPos = pos + width;
+    return mSequence.substr(begin, pos - begin);
+}
+
+UCMDP_DECL std::size_t cmd_token_stream::count_remaining() const
+{
+    auto tokens = *this;
+    std::string scratch;
+    std::size_t count = 0;
+    for (; tokens; ++count)
+    {
+        tokens.next(scratch);
+    }
+    return count;
+}
+
+UCMDP_DECL bool cmd_token_stream::skip_prefix(std::string_view text)
+{
+    auto rest = remaining();
+    if (text.empty() || rest.size() < text.size()
+        || rest.compare(0, text.size(), text) != 0)
+    {
+        return false;
+    }
+    if (mOptions.unicode_whitespace
+        && find_token_special(text.data(), text.data() + text.size(),
+                              separator_char, separator_char, separator_char,
+                              true, true) != text.data() + text.size())
+    {
+        // text might contain additional separators
+        return false;
+    }
+    if (rest.size() == text.size())
+    {
+        mNextPos = mSequence.size();
+        return true;
+    }
+    if (rest[text.size()] == separator_char)
+    {
+        mNextPos += text.size() + 1;
+        return true;
+    }
+    return false;
+}
+
+UCMDP_DECL char cmd_token_stream::unescape(char c)
+{
+    switch (c)
+    {
+    case 'n':
+        return '\n';
+    case escape_char:
+    case separator_char:
+    case quote_char:
+    case cmd_statement_stream::sequence_char:
+    case cmd_statement_stream::conjunction_char:
+        return c;
+    default:
+        BOOST_THROW_EXCEPTION(
+            invalid_escape_sequence_error{}
+        );
+    }
+}
+
+UCMDP_DECL std::string_view cmd_statement_stream::next(statement_link &link)
+{
+    const auto size = mLine.size();
+    const auto data = mLine.data();
+    const auto begin = mNextPos;
+    auto pos = begin;
+    auto end = size;
+    // the position behind the last escaped character, i.e. an escaped
+    // trailing separator is part of the statement
+    auto escapedEnd = begin;
+    link = statement_link::sequence;
+    mNextPos = size;
+    for (bool inQuote = false; pos != size; ++pos)
+    {
+        pos = static_cast<std::size_t>(
+            find_any_of4(data + pos, data + size, sequence_char, conjunction_char,
+                         cmd_token_stream::escape_char, cmd_token_stream::quote_char) - data);
+        if (pos == size)
+        {
+            break;
+        }
+        const char c = data[pos];
+        if (c == cmd_token_stream::escape_char)
+        {
+            // the escaped character is validated by the tokenizer
+            if (++pos == size)
+            {
+                break;
+            }
+            escapedEnd = pos + 1;
+        }
+        else if (c == cmd_token_stream::quote_char)
+        {
+            inQuote = !inQuote;
+        }
+        else if (inQuote)
+        {
+            continue;
+        }
+        else if (c == sequence_char)
+        {
+            end = pos;
+            mNextPos = pos + 1;
+            break;
+        }
+        else if (pos + 1 != size && data[pos + 1] == conjunction_char)
+        {
+            end = pos;
+            mNextPos = pos + 2;
+            link = statement_link::conjunction;
+            break;
+        }
+    }
+
+    auto statement = mLine.substr(begin, end - begin);
+    const auto first = statement.find_first_not_of(cmd_token_stream::separator_char);
+    if (first == std::string_view::npos)
+    {
+        return statement.substr(statement.size());
+    }
+    const auto last = std::max(statement.find_last_not_of(cmd_token_stream::separator_char) + 1,
+                               escapedEnd - begin);
+    return statement.substr(first, last - first);
+}
+
+UCMDP_DECL std::size_t escaped_token_size(std::string_view token)
+{
+    if (token.empty())
+    {
+        return 2;
+    }
+    auto size = token.size();
+    for (char c : token)
+    {
+        if (c == '\n' || c == cmd_token_stream::escape_char
+            || c == cmd_token_stream::separator_char || c == cmd_token_stream::quote_char)
+        {
+            ++size;
+        }
+    }
+    return size;
+}
+
+UCMDP_DECL std::to_chars_result write_escaped_token(char *first, char *last, std::string_view token)
+{
+    if (static_cast<std::size_t>(last - first) < escaped_token_size(token))
+    {
+        return { last, std::errc::value_too_large };
+    }
+    if (token.empty())
+    {
+        *first++ = cmd_token_stream::quote_char;
+        *first++ = cmd_token_stream::quote_char;
+        return { first, std::errc{} };
+    }
+    for (char c : token)
+    {
+        switch (c)
+        {
+        case '\n':
+            *first++ = cmd_token_stream::escape_char;
+            *first++ = 'n';
+            break;
+        case cmd_token_stream::escape_char:
+        case cmd_token_stream::separator_char:
+        case cmd_token_stream::quote_char:
+            *first++ = cmd_token_stream::escape_char;
+            *first++ = c;
+            break;
+        default:
+            *first++ = c;
+        }
+    }
+    return { first, std::errc{} };
+}
+
+UCMDP_DECL void append_escaped_token(std::string &out, std::string_view token)
+{
+    const auto offset = out.size();
+    out.resize(offset + escaped_token_size(token));
+    write_escaped_token(out.data() + offset, out.data() + out.size(), token);
+}
+
+
+}
@@ -0,0 +1,110 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace ucmdp::detail
+{
+
+
+constexpr std::uint32_t seeded_fnv1a(std::string_view str, std::uint32_t seed)
+{
+    std::uint32_t hash = UINT32_C(2166136261) ^ (seed * UINT32_C(0x9E3779B9));
+    for (char c : str)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= UINT32_C(16777619);
+    }
+    return hash ^ (hash >> 15);
+}
+
+constexpr std::size_t perfect_hash_table_size(std::size_t numKeys)
+{
+    std::size_t size = 1;
+    while (size < 2 * numKeys)
+    {
+        size *= 2;
+    }
+    return size;
+}
+
+// maps each of N keys to its index with a single hash evaluation and string
+// compare. The seed is searched at compile time if the table is constexpr.
+template< std::size_t N >
+class perfect_hash_table
+{
+public:
+    static constexpr std::size_t table_size = perfect_hash_table_size(N);
+    static constexpr std::size_t npos = N;
+    static constexpr std::uint32_t max_seed = 1u << 16;
+
+    constexpr explicit perfect_hash_table(const std::array<std::string_view, N> &keys)
+        : mKeys(keys)
+        , mSlots()
+        , mSeed(0)
+    {
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            for (std::size_t j = i + 1; j < N; ++j)
+            {
+                if (mKeys[i] == mKeys[j])
+                {
+                    throw std::logic_error("perfect_hash_table keys must be unique");
+                }
+            }
+        }
+        for (; mSeed < max_seed; ++mSeed)
+        {
+            if (try_seed())
+            {
+                return;
+            }
+        }
+        throw std::logic_error("failed to find a perfect hash seed");
+    }
+
+    constexpr std::size_t find(std::string_view key) const
+    {
+        auto idx = mSlots[seeded_fnv1a(key, mSeed) & (table_size - 1)];
+        return idx != npos && mKeys[idx] == key ? idx : npos;
+    }
+
+    constexpr const std::array<std::string_view, N> & keys() const
+    {
+        return mKeys;
+    }
+
+private:
+    constexpr bool try_seed()
+    {
+        for (auto &slot : mSlots)
+        {
+            slot = npos;
+        }
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            auto &slot = mSlots[seeded_fnv1a(mKeys[i], mSeed) & (table_size - 1)];
+            if (slot != npos)
+            {
+                return false;
+            }
+            slot = i;
+        }
+        return true;
+    }
+
+    std::array<std::string_view, N> mKeys;
+    std::array<std::size_t, table_size> mSlots;
+    std::uint32_t mSeed;
+};
+
+
+}
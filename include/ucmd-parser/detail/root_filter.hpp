@@ -0,0 +1,176 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "utf8.hpp"
+
+namespace ucmdp::detail
+{
+
+
+// a Bloom filter over the first two tokens of the command and mount paths
+// of a tree. It judges a command by its leading bytes before it is
+// tokenized and never rejects a command which resolves to an action.
+// Tokens containing quotes or escapes can't be judged from their bytes and
+// always pass.
+class root_filter
+{
+public:
+    // the root itself has an action or a mount, i.e. everything may resolve
+    void pass_all()
+    {
+        mPassAll = true;
+    }
+    // open first tokens may be followed by anything, all others only by
+    // the second tokens added with add_pair()
+    void add_first(std::string_view first, bool open)
+    {
+        const auto hash = hash_bytes(hash_seed, first);
+        add(mix(hash));
+        if (open)
+        {
+            add(mix(hash ^ open_tag));
+        }
+    }
+    void add_pair(std::string_view first, std::string_view second)
+    {
+        auto hash = hash_bytes(hash_seed, first);
+        hash = (hash ^ static_cast<unsigned char>(separator_char)) * hash_factor;
+        add(mix(hash_bytes(hash, second)));
+    }
+
+    // returns false if cmd can't lead to an action. With unicodeWhitespace
+    // tokens containing non ASCII bytes or whitespace controls always pass.
+    bool may_resolve(std::string_view cmd, bool unicodeWhitespace) const
+    {
+        if (mPassAll)
+        {
+            return true;
+        }
+        if (mBits.empty())
+        {
+            return false;
+        }
+        std::uint64_t hash = hash_seed;
+        std::size_t pos = 0;
+        if (!scan(cmd, pos, hash, unicodeWhitespace))
+        {
+            return true;
+        }
+        if (!contains(mix(hash)))
+        {
+            return false;
+        }
+        if (contains(mix(hash ^ open_tag)))
+        {
+            return true;
+        }
+        if (pos == cmd.size())
+        {
+            return false;
+        }
+        hash = (hash ^ static_cast<unsigned char>(separator_char)) * hash_factor;
+        return !scan(cmd, pos, hash, unicodeWhitespace) || contains(mix(hash));
+    }
+
+private:
+    static constexpr char separator_char = ' ';
+    // a cheap byte step with a short dependency chain, mix() distributes
+    static constexpr std::uint64_t hash_seed = UINT64_C(5381);
+    static constexpr std::uint64_t hash_factor = 33;
+    static constexpr std::uint64_t open_tag = UINT64_C(0x9E3779B97F4A7C15);
+    // keeps the false positive rate below 0.4% with two probes
+    static constexpr std::size_t bits_per_hash = 32;
+    static constexpr std::size_t min_bits = 512;
+
+    static std::uint64_t hash_bytes(std::uint64_t hash, std::string_view bytes)
+    {
+        for (char c : bytes)
+        {
+            hash = (hash ^ static_cast<unsigned char>(c)) * hash_factor;
+        }
+        return hash;
+    }
+    static std::uint64_t mix(std::uint64_t hash)
+    {
+        hash ^= hash >> 33;
+        hash *= UINT64_C(0xff51afd7ed558ccd);
+        hash ^= hash >> 33;
+        hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+        return hash ^ (hash >> 33);
+    }
+
+    // hashes the token at pos and advances pos behind its separator.
+    // Returns false if the token can't be judged from its bytes.
+    static bool scan(std::string_view cmd, std::size_t &pos, std::uint64_t &hash,
+                     bool unicodeWhitespace)
+    {
+        for (; pos != cmd.size(); ++pos)
+        {
+            const auto c = static_cast<unsigned char>(cmd[pos]);
+            if (c == static_cast<unsigned char>(separator_char))
+            {
+                ++pos;
+                return true;
+            }
+            if (c == '"' || c == '\\'
+                || (unicodeWhitespace && (c >= 0x80 || is_ascii_space_control(c))))
+            {
+                return false;
+            }
+            hash = (hash ^ c) * hash_factor;
+        }
+        return true;
+    }
+
+    bool contains(std::uint64_t hash) const
+    {
+        const auto mask = mBits.size() * 64 - 1;
+        const auto a = hash & mask;
+        const auto b = (hash >> 32) & mask;
+        return (mBits[a / 64] >> (a % 64) & 1) && (mBits[b / 64] >> (b % 64) & 1);
+    }
+    void set(std::uint64_t hash)
+    {
+        const auto mask = mBits.size() * 64 - 1;
+        const auto a = hash & mask;
+        const auto b = (hash >> 32) & mask;
+        mBits[a / 64] |= std::uint64_t{ 1 } << (a % 64);
+        mBits[b / 64] |= std::uint64_t{ 1 } << (b % 64);
+    }
+    void add(std::uint64_t hash)
+    {
+        mHashes.push_back(hash);
+        auto bits = mBits.size() * 64;
+        if (bits >= mHashes.size() * bits_per_hash)
+        {
+            set(hash);
+            return;
+        }
+        for (bits = bits ? bits : min_bits; bits < mHashes.size() * bits_per_hash;)
+        {
+            bits *= 2;
+        }
+        mBits.assign(bits / 64, 0);
+        for (auto h : mHashes)
+        {
+            set(h);
+        }
+    }
+
+    std::vector<std::uint64_t> mBits;
+    // the added hashes for rebuilding the filter once it grows
+    std::vector<std::uint64_t> mHashes;
+    bool mPassAll = false;
+};
+
+
+}
@@ -0,0 +1,134 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "utf8.hpp"
+
+namespace ucmdp::detail
+{
+
+
+// deeper nesting is rejected like unbalanced brackets
+constexpr std::size_t max_structure_depth = 64;
+
+// returns a bitmask of the JSON structural characters {}[]" and the
+// backslash within the n <= 16 bytes at first. Bit i corresponds to first[i].
+inline std::uint32_t structural_mask(const char *first, std::size_t n)
+{
+#if defined(UCMDP_HAS_SSE2)
+    if (n == 16)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+        // '{' and '}' differ from '[' and ']' in bit 0x20 only
+        const __m128i folded = _mm_andnot_si128(_mm_set1_epi8(0x20), block);
+        const __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('[')),
+                         _mm_cmpeq_epi8(folded, _mm_set1_epi8(']'))),
+            _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('"')),
+                         _mm_cmpeq_epi8(block, _mm_set1_epi8('\\'))));
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(hits));
+    }
+#endif
+    std::uint32_t mask = 0;
+    for (std::size_t i = 0; i != n; ++i)
+    {
+        switch (first[i])
+        {
+        case '[': case ']': case '{': case '}': case '"': case '\\':
+            mask |= std::uint32_t{ 1 } << i;
+            break;
+        default:
+            break;
+        }
+    }
+    return mask;
+}
+
+// returns the end of the bracketed or braced JSON like structure starting
+// at first, i.e. the position behind the matching closing bracket, or
+// nullptr if the brackets in [first, last) don't balance. Brackets within
+// strings are ignored. Only the structural characters are inspected; the
+// bytes in between are skipped 16 at a time.
+inline const char * find_structure_end(const char *first, const char *last)
+{
+    // bit i is set if the bracket at depth i is a brace
+    std::uint64_t braces = 0;
+    std::size_t depth = 0;
+    bool inString = false;
+    // the escaped byte of a backslash at the end of the previous block
+    bool skipFirst = false;
+    for (auto block = first; block != last;)
+    {
+        const auto n = static_cast<std::size_t>(last - block) < 16
+            ? static_cast<std::size_t>(last - block)
+            : std::size_t{ 16 };
+        auto mask = structural_mask(block, n);
+        if (skipFirst)
+        {
+            mask &= ~std::uint32_t{ 1 };
+            skipFirst = false;
+        }
+        while (mask != 0)
+        {
+            const auto i = count_trailing_zeros(mask);
+            mask &= mask - 1;
+            const char c = block[i];
+            if (c == '\\')
+            {
+                if (inString)
+                {
+                    // the escaped character is never structural
+                    if (i + 1 == n)
+                    {
+                        skipFirst = true;
+                    }
+                    else
+                    {
+                        mask &= ~(std::uint32_t{ 1 } << (i + 1));
+                    }
+                }
+                continue;
+            }
+            if (c == '"')
+            {
+                inString = !inString;
+                continue;
+            }
+            if (inString)
+            {
+                continue;
+            }
+            const bool brace = c == '{' || c == '}';
+            if (c == '[' || c == '{')
+            {
+                if (depth == max_structure_depth)
+                {
+                    return nullptr;
+                }
+                const auto bit = std::uint64_t{ 1 } << depth;
+                braces = brace ? braces | bit : braces & ~bit;
+                ++depth;
+                continue;
+            }
+            if (depth == 0 || ((braces >> (depth - 1)) & 1) != static_cast<std::uint64_t>(brace))
+            {
+                return nullptr;
+            }
+            if (--depth == 0)
+            {
+                return block + i + 1;
+            }
+        }
+        block += n;
+    }
+    return nullptr;
+}
+
+
+}
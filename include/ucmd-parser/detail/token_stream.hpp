@@ -5,48 +5,103 @@
 //
 #pragma once
 
+#include <cstddef>
+#include <charconv>
+#include <algorithm>
 #include <string>
 #include <string_view>
+#include <system_error>
 
-#include <boost/tokenizer.hpp>
-
+#include "../config.hpp"
 #include "../exceptions.hpp"
 
-namespace ucmdp::detail
+namespace ucmdp
 {
 
 
-using escaped_cmd_seperator = boost::escaped_list_separator<char>;
-inline escaped_cmd_seperator make_escaped_cmd_seperator()
+struct tokenizer_options
 {
-    return escaped_cmd_seperator { '\\', ' ', '"' };
+    // reject malformed UTF-8 with an invalid_utf8_error
+    bool validate_utf8 = false;
+    // treat all code points with the Unicode White_Space property as
+    // separators in addition to ' '. Implies UTF-8 validation of the input.
+    bool unicode_whitespace = false;
+    // tokens starting with '[' or '{' extend to the matching bracket and
+    // are handed out verbatim, i.e. separators, quotes and backslashes
+    // within them are kept. Unbalanced brackets are rejected with a
+    // structured_literal_error.
+    bool structured_literals = false;
+};
+
+
 }
 
+namespace ucmdp::detail
+{
+
+
+// tokenizes a command line with the rules of boost::escaped_list_separator
+// with '\\' as escape, ' ' as separator and '"' as quote character.
+//
+// tokens which contain neither escape nor quote characters are handed out
+// as views into the original sequence, all others are unescaped into a
+// caller provided scratch buffer.
 class cmd_token_stream
 {
 public:
-    explicit cmd_token_stream(std::string_view sequence)
-        : tokenize(make_escaped_cmd_seperator())
-        , mSequence(sequence)
+    static constexpr char escape_char = '\\';
+    static constexpr char separator_char = ' ';
+    static constexpr char quote_char = '"';
+
+    explicit cmd_token_stream(std::string_view sequence,
+                              tokenizer_options options = tokenizer_options{})
+        : mSequence(sequence)
+        , mNextPos(0)
+        , mOptions(options)
     {
-        mNextPos = mSequence.cbegin();
     }
 
     explicit operator bool() const
     {
-        return mNextPos != mSequence.end();
+        return mNextPos != mSequence.size();
     }
 
     std::string next()
     {
-        std::string token;
-        if (!tokenize(mNextPos, mSequence.cend(), token))
+        std::string scratch;
+        auto token = next(scratch);
+        if (token.data() == scratch.data())
         {
-            BOOST_THROW_EXCEPTION(
-                end_of_token_stream_error{}
-            );
+            return scratch;
         }
-        return token;
+        return std::string{ token };
+    }
+
+    // the returned view either points into sequence() or into scratch, i.e.
+    // it is invalidated by the next modification of scratch.
+    UCMDP_DECL std::string_view next(std::string &scratch);
+
+    // counts the tokens next() would still yield
+    UCMDP_DECL std::size_t count_remaining() const;
+
+    // continues tokenizing at pos which must be a token boundary
+    void skip_to(std::size_t pos)
+    {
+        mNextPos = std::min(pos, mSequence.size());
+    }
+
+    // consumes the remaining sequence without tokenizing it. It is
+    // validated like a token if the options ask for UTF-8 validation.
+    UCMDP_DECL std::string_view skip_remaining();
+
+    // consumes the tokens in text if remaining() starts with it and text is
+    // followed by a separator or the end of the sequence. text must end on a
+    // token boundary, e.g. consist of tokens written by append_escaped_token.
+    UCMDP_DECL bool skip_prefix(std::string_view text);
+
+    const tokenizer_options & options() const
+    {
+        return mOptions;
     }
 
     std::string_view sequence() const
@@ -55,18 +110,81 @@ public:
     }
     std::string_view consumed() const
     {
-        return mSequence.substr(0, mNextPos - mSequence.cbegin());
+        return mSequence.substr(0, mNextPos);
     }
     std::string_view remaining() const
     {
-        return mSequence.substr(mNextPos - mSequence.cbegin());
+        return mSequence.substr(mNextPos);
     }
 
 private:
-    escaped_cmd_seperator tokenize;
+    UCMDP_DECL std::string_view next_structure();
+    UCMDP_DECL static char unescape(char c);
+
     std::string_view mSequence;
-    std::string_view::const_iterator mNextPos;
+    std::size_t mNextPos;
+    tokenizer_options mOptions;
+};
+
+enum class statement_link
+{
+    // the next statement runs regardless of the outcome of this one
+    sequence,
+    // the next statement only runs if this one has run successfully
+    conjunction,
 };
 
+// splits a command line into statements separated by ';' or "&&" outside
+// of quotes. The statements are views into the line with leading and
+// trailing separator characters removed; they are tokenized by a
+// cmd_token_stream afterwards, i.e. the splitter doesn't unescape anything
+// and only stops at statement separators, quotes and escapes. "\;" and
+// "\&" are unescaped to ';' and '&' by the tokenizer.
+class cmd_statement_stream
+{
+public:
+    static constexpr char sequence_char = ';';
+    static constexpr char conjunction_char = '&';
+
+    explicit cmd_statement_stream(std::string_view line)
+        : mLine(line)
+        , mNextPos(0)
+    {
+    }
+
+    explicit operator bool() const
+    {
+        return mNextPos != mLine.size();
+    }
+
+    // returns the next statement which may be empty, e.g. for "a;;b".
+    // link describes how the statement is connected to the following one.
+    UCMDP_DECL std::string_view next(statement_link &link);
+
+    // the offset of the next statement within the line
+    std::size_t position() const
+    {
+        return mNextPos;
+    }
+
+private:
+    std::string_view mLine;
+    std::size_t mNextPos;
+};
+
+// the number of characters append_escaped_token() writes for token
+UCMDP_DECL std::size_t escaped_token_size(std::string_view token);
+
+// writes the canonical escaped form of token which cmd_token_stream will
+// read back as exactly this token. Empty tokens are written as "".
+// Behaves like std::to_chars if [first, last) is too small.
+UCMDP_DECL std::to_chars_result write_escaped_token(char *first, char *last, std::string_view token);
+
+UCMDP_DECL void append_escaped_token(std::string &out, std::string_view token);
+
 
 }
+
+#if defined(UCMDP_HEADER_ONLY)
+#include "impl/token_stream.ipp"
+#endif
@@ -0,0 +1,220 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UCMDP_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ucmdp::detail
+{
+
+
+// returns the length of the well formed UTF-8 sequence starting at first
+// and stores its code point in cp or returns 0 if the sequence is malformed
+// (truncated, overlong, surrogate or beyond U+10FFFF).
+inline std::size_t decode_utf8(const char *first, const char *last, char32_t &cp)
+{
+    const auto lead = static_cast<unsigned char>(*first);
+    std::size_t length;
+    char32_t minimum;
+    if (lead < 0x80)
+    {
+        cp = lead;
+        return 1;
+    }
+    else if ((lead & 0xE0) == 0xC0)
+    {
+        length = 2;
+        cp = lead & 0x1F;
+        minimum = 0x80;
+    }
+    else if ((lead & 0xF0) == 0xE0)
+    {
+        length = 3;
+        cp = lead & 0x0F;
+        minimum = 0x800;
+    }
+    else if ((lead & 0xF8) == 0xF0)
+    {
+        length = 4;
+        cp = lead & 0x07;
+        minimum = 0x10000;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (static_cast<std::size_t>(last - first) < length)
+    {
+        return 0;
+    }
+    for (std::size_t i = 1; i < length; ++i)
+    {
+        const auto trail = static_cast<unsigned char>(first[i]);
+        if ((trail & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+        cp = (cp << 6) | (trail & 0x3F);
+    }
+    if (cp < minimum || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    {
+        return 0;
+    }
+    return length;
+}
+
+// code points with the Unicode White_Space property
+inline bool is_unicode_space(char32_t cp)
+{
+    switch (cp)
+    {
+    case 0x0009: case 0x000A: case 0x000B: case 0x000C: case 0x000D:
+    case 0x0020: case 0x0085: case 0x00A0: case 0x1680:
+    case 0x2028: case 0x2029: case 0x202F: case 0x205F: case 0x3000:
+        return true;
+    default:
+        return cp >= 0x2000 && cp <= 0x200A;
+    }
+}
+
+inline bool is_ascii_space_control(unsigned char c)
+{
+    return c >= 0x09 && c <= 0x0D;
+}
+
+inline unsigned count_trailing_zeros(std::uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return static_cast<unsigned>(idx);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// returns the first position in [first, last) which holds one of the three
+// given ASCII characters or, if requested, a non ASCII byte or one of the
+// ASCII whitespace control characters \t\n\v\f\r. Processes 16 bytes per
+// step if SSE2 is available, so non ASCII detection rides along with the
+// delimiter scan at no extra cost for ASCII input.
+inline const char * find_token_special(const char *first, const char *last,
+                                       char c0, char c1, char c2,
+                                       bool nonAscii, bool asciiSpace)
+{
+#if defined(UCMDP_HAS_SSE2)
+    const __m128i v0 = _mm_set1_epi8(c0);
+    const __m128i v1 = _mm_set1_epi8(c1);
+    const __m128i v2 = _mm_set1_epi8(c2);
+    const __m128i spaceLow = _mm_set1_epi8(0x09);
+    const __m128i spaceRange = _mm_set1_epi8(0x0D - 0x09);
+    while (last - first >= 16)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+        const __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(block, v0), _mm_cmpeq_epi8(block, v1)),
+            _mm_cmpeq_epi8(block, v2));
+        auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(hits));
+        if (nonAscii)
+        {
+            mask |= static_cast<std::uint32_t>(_mm_movemask_epi8(block));
+        }
+        if (asciiSpace)
+        {
+            const __m128i offset = _mm_sub_epi8(block, spaceLow);
+            const __m128i inRange = _mm_cmpeq_epi8(_mm_min_epu8(offset, spaceRange), offset);
+            mask |= static_cast<std::uint32_t>(_mm_movemask_epi8(inRange));
+        }
+        if (mask != 0)
+        {
+            return first + count_trailing_zeros(mask);
+        }
+        first += 16;
+    }
+#endif
+    for (; first != last; ++first)
+    {
+        const char c = *first;
+        if (c == c0 || c == c1 || c == c2
+            || (nonAscii && static_cast<unsigned char>(c) >= 0x80)
+            || (asciiSpace && is_ascii_space_control(static_cast<unsigned char>(c))))
+        {
+            break;
+        }
+    }
+    return first;
+}
+
+// returns the first position in [first, last) at which no well formed UTF-8
+// sequence starts or last if there is none
+inline const char * find_invalid_utf8(const char *first, const char *last)
+{
+    while (first != last)
+    {
+        first = find_token_special(first, last, '\0', '\0', '\0', true, false);
+        if (first == last)
+        {
+            break;
+        }
+        char32_t cp = static_cast<unsigned char>(*first);
+        const auto width = cp < 0x80 ? 1 : decode_utf8(first, last, cp);
+        if (width == 0)
+        {
+            return first;
+        }
+        first += width;
+    }
+    return last;
+}
+
+// returns the first position in [first, last) which holds one of the four
+// given ASCII characters, like find_token_special() without the non ASCII
+// and whitespace detection
+inline const char * find_any_of4(const char *first, const char *last,
+                                 char c0, char c1, char c2, char c3)
+{
+#if defined(UCMDP_HAS_SSE2)
+    const __m128i v0 = _mm_set1_epi8(c0);
+    const __m128i v1 = _mm_set1_epi8(c1);
+    const __m128i v2 = _mm_set1_epi8(c2);
+    const __m128i v3 = _mm_set1_epi8(c3);
+    while (last - first >= 16)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+        const __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(block, v0), _mm_cmpeq_epi8(block, v1)),
+            _mm_or_si128(_mm_cmpeq_epi8(block, v2), _mm_cmpeq_epi8(block, v3)));
+        const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(hits));
+        if (mask != 0)
+        {
+            return first + count_trailing_zeros(mask);
+        }
+        first += 16;
+    }
+#endif
+    for (; first != last; ++first)
+    {
+        const char c = *first;
+        if (c == c0 || c == c1 || c == c2 || c == c3)
+        {
+            break;
+        }
+    }
+    return first;
+}
+
+
+}
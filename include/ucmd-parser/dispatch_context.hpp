@@ -0,0 +1,198 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <array>
+#include <tuple>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+namespace ucmdp
+{
+
+
+struct dispatch_context_stats
+{
+    // the number of buffers the dispatches have asked for and how many of
+    // them have been served from the retained ones
+    std::uint64_t buffers_requested = 0;
+    std::uint64_t buffers_reused = 0;
+    // the heap capacity of the idle buffers
+    std::size_t bytes_retained = 0;
+
+    double reuse_ratio() const noexcept
+    {
+        return buffers_requested
+            ? static_cast<double>(buffers_reused) / static_cast<double>(buffers_requested)
+            : 0.0;
+    }
+};
+
+// keeps the unescape buffers and std::string arguments of the commands
+// dispatched with it, i.e. once the buffers have grown to the size of the
+// arguments steady state dispatching doesn't allocate for them anymore.
+// Handlers should take std::string arguments by const reference, by value
+// parameters are still copied. A context is meant to be kept per thread and
+// must not be used concurrently; it may be shared by multiple trees.
+class dispatch_context
+{
+public:
+    // buffers which would raise the retained capacity above
+    // maxRetainedBytes are released instead
+    explicit dispatch_context(std::size_t maxRetainedBytes = 64 * 1024)
+        : mMaxRetainedBytes(maxRetainedBytes)
+    {
+    }
+    dispatch_context(const dispatch_context &) = delete;
+    dispatch_context & operator=(const dispatch_context &) = delete;
+
+    dispatch_context_stats stats() const noexcept
+    {
+        return mStats;
+    }
+    // releases the retained buffers, the counters are kept
+    void shrink() noexcept
+    {
+        mIdle.clear();
+        mIdle.shrink_to_fit();
+        mStats.bytes_retained = 0;
+    }
+
+    // returns an empty buffer which keeps the capacity of a released one
+    // if there is any
+    std::string acquire()
+    {
+        ++mStats.buffers_requested;
+        if (mIdle.empty())
+        {
+            return {};
+        }
+        ++mStats.buffers_reused;
+        auto buffer = std::move(mIdle.back());
+        mIdle.pop_back();
+        mStats.bytes_retained -= heap_capacity(buffer);
+        return buffer;
+    }
+    void release(std::string &&buffer) noexcept
+    {
+        const auto capacity = heap_capacity(buffer);
+        if (mStats.bytes_retained + capacity > mMaxRetainedBytes)
+        {
+            return;
+        }
+        try
+        {
+            mIdle.push_back(std::move(buffer));
+        }
+        catch (...)
+        {
+            // losing a buffer only costs a future allocation
+            return;
+        }
+        mIdle.back().clear();
+        mStats.bytes_retained += capacity;
+    }
+
+private:
+    static std::size_t heap_capacity(const std::string &buffer) noexcept
+    {
+        // the small string buffer is part of the object
+        static const auto inplace = std::string{}.capacity();
+        return buffer.capacity() > inplace ? buffer.capacity() + 1 : 0;
+    }
+
+    std::vector<std::string> mIdle;
+    std::size_t mMaxRetainedBytes;
+    dispatch_context_stats mStats;
+};
+
+
+}
+
+namespace ucmdp::detail
+{
+
+
+// lends the unescape buffers and the std::string arguments of a command
+// execution from a dispatch context and returns them on destruction. The
+// tokens of arithmetic and enum arguments fit into the small string buffer,
+// i.e. their unescape buffers aren't worth lending. Does nothing if there
+// is no context.
+template< typename Tuple >
+class recycled_buffers
+{
+    static constexpr std::size_t arity = std::tuple_size_v<Tuple>;
+
+public:
+    recycled_buffers(dispatch_context *context, Tuple &args,
+                     std::array<std::string, arity> &scratch)
+        : mContext(context)
+        , mArgs(args)
+        , mScratch(scratch)
+    {
+        if (mContext)
+        {
+            for_each_buffer<false>([this](std::string &buffer) { buffer = mContext->acquire(); },
+                                   std::make_index_sequence<arity>{});
+        }
+    }
+    ~recycled_buffers()
+    {
+        if (mContext)
+        {
+            // in reverse order, i.e. the next execution of the command gets
+            // the same buffers for the same purposes back
+            for_each_buffer<true>([this](std::string &buffer) { mContext->release(std::move(buffer)); },
+                                  std::make_index_sequence<arity>{});
+        }
+    }
+    recycled_buffers(const recycled_buffers &) = delete;
+    recycled_buffers & operator=(const recycled_buffers &) = delete;
+
+private:
+    template< bool Reverse, typename F, std::size_t... Is >
+    void for_each_buffer(F &&f, std::index_sequence<Is...>)
+    {
+        const auto visit = [&f](std::string &scratch, auto &arg)
+        {
+            using arg_type = std::remove_reference_t<decltype(arg)>;
+            constexpr bool lendScratch = !std::is_arithmetic_v<arg_type> && !std::is_enum_v<arg_type>;
+            constexpr bool lendArg = std::is_same_v<arg_type, std::string>;
+            if constexpr (lendScratch && !Reverse)
+            {
+                f(scratch);
+            }
+            if constexpr (lendArg)
+            {
+                f(arg);
+            }
+            if constexpr (lendScratch && Reverse)
+            {
+                f(scratch);
+            }
+        };
+        if constexpr (Reverse)
+        {
+            (visit(mScratch[arity - 1 - Is], std::get<arity - 1 - Is>(mArgs)), ...);
+        }
+        else
+        {
+            (visit(mScratch[Is], std::get<Is>(mArgs)), ...);
+        }
+        static_cast<void>(visit);
+    }
+
+    dispatch_context *mContext;
+    Tuple &mArgs;
+    std::array<std::string, arity> &mScratch;
+};
+
+
+}
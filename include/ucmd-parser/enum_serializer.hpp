@@ -0,0 +1,301 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <charconv>
+#include <optional>
+#include <type_traits>
+#include <string_view>
+#include <shared_mutex>
+#include <system_error>
+#include <unordered_map>
+
+#include "exceptions.hpp"
+#include "serializer.hpp"
+#include "detail/perfect_hash.hpp"
+#include "detail/token_stream.hpp"
+
+namespace ucmdp
+{
+
+
+template< typename E >
+struct enum_entry
+{
+    std::string_view name;
+    E value;
+};
+
+template< typename E >
+constexpr enum_entry<E> enum_name(std::string_view name, E value)
+{
+    return { name, value };
+}
+
+
+// maps the names of an enum's values to the values with a perfect hash
+// which is computed at compile time if the table is constexpr. A value may
+// be listed under several names, the first one is used for serialization.
+template< typename E, std::size_t N >
+class enum_name_table
+{
+public:
+    static_assert(std::is_enum_v<E>, "enum_name_table requires an enum type");
+
+    static constexpr std::size_t size = N;
+    static constexpr std::size_t npos = N;
+
+    constexpr explicit enum_name_table(const std::array<enum_entry<E>, N> &entries)
+        : mNames(names_of(entries))
+        , mValues(values_of(entries))
+    {
+    }
+
+    constexpr std::size_t find(std::string_view name) const
+    {
+        return mNames.find(name);
+    }
+    constexpr std::size_t find(E value) const
+    {
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            if (mValues[i] == value)
+            {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    constexpr std::string_view name(std::size_t i) const
+    {
+        return mNames.keys()[i];
+    }
+    constexpr E value(std::size_t i) const
+    {
+        return mValues[i];
+    }
+
+    // the names separated by ", "
+    std::string list() const
+    {
+        std::string names;
+        for (auto name : mNames.keys())
+        {
+            if (!names.empty())
+            {
+                names += ", ";
+            }
+            names += name;
+        }
+        return names;
+    }
+
+private:
+    static constexpr std::array<std::string_view, N> names_of(
+        const std::array<enum_entry<E>, N> &entries)
+    {
+        std::array<std::string_view, N> names{};
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            names[i] = entries[i].name;
+        }
+        return names;
+    }
+    static constexpr std::array<E, N> values_of(const std::array<enum_entry<E>, N> &entries)
+    {
+        std::array<E, N> values{};
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            values[i] = entries[i].value;
+        }
+        return values;
+    }
+
+    detail::perfect_hash_table<N> mNames;
+    std::array<E, N> mValues;
+};
+
+template< typename E, typename... Es >
+constexpr auto make_enum_names(enum_entry<E> entry, enum_entry<Es>... entries)
+{
+    static_assert((std::is_same_v<E, Es> && ...), "all names must belong to the same enum");
+    return enum_name_table<E, sizeof...(Es) + 1>(
+        std::array<enum_entry<E>, sizeof...(Es) + 1>{ { entry, entries... } });
+}
+
+
+// token serializer for enums. The token is looked up without allocating,
+// unknown names raise an invalid_enum_value_error listing the valid names.
+// Requires `serialization_traits<E>::names` to be a constexpr
+// enum_name_table created by make_enum_names.
+template< typename E >
+struct enum_serializer
+{
+    void deserialize(std::string_view str, E &out) const
+    {
+        const auto &names = serialization_traits<E>::names;
+        const auto idx = names.find(str);
+        if (idx == names.npos)
+        {
+            BOOST_THROW_EXCEPTION(
+                invalid_enum_value_error{}
+                    << valid_values_info{ names.list() }
+            );
+        }
+        out = names.value(idx);
+    }
+
+    std::to_chars_result serialize(char *first, char *last, E in) const
+    {
+        const auto &names = serialization_traits<E>::names;
+        const auto idx = names.find(in);
+        if (idx == names.npos)
+        {
+            return { last, std::errc::invalid_argument };
+        }
+        return detail::write_escaped_token(first, last, names.name(idx));
+    }
+};
+
+
+// interns names and hands out dense ids in the order of first appearance.
+// Ids and the returned names stay valid for the lifetime of the table.
+// All member functions are thread safe, looking up known names doesn't
+// allocate. The table never shrinks, i.e. names from untrusted input are
+// bounded by a capacity instead.
+class symbol_table
+{
+public:
+    using id_type = std::uint32_t;
+
+    static constexpr std::size_t default_max_symbols = 4096;
+    static constexpr std::size_t default_max_bytes = std::size_t{ 1 } << 20;
+
+    // interning a name which would exceed maxSymbols names or maxBytes
+    // name bytes throws a symbol_table_full_error
+    explicit symbol_table(std::size_t maxSymbols = default_max_symbols,
+                          std::size_t maxBytes = default_max_bytes)
+        : mMaxSymbols(maxSymbols)
+        , mMaxBytes(maxBytes)
+    {
+    }
+    symbol_table(const symbol_table &) = delete;
+    symbol_table & operator=(const symbol_table &) = delete;
+
+    id_type intern(std::string_view name)
+    {
+        if (auto id = find(name))
+        {
+            return *id;
+        }
+        std::unique_lock<std::shared_mutex> lock(mMutex);
+        auto it = mIds.find(name);
+        if (it != mIds.end())
+        {
+            return it->second;
+        }
+        if (mNames.size() == mMaxSymbols || name.size() > mMaxBytes - mBytes)
+        {
+            BOOST_THROW_EXCEPTION(
+                symbol_table_full_error{}
+                    << last_token_info{ std::string{ name } }
+            );
+        }
+        const auto id = static_cast<id_type>(mNames.size());
+        const auto &stored = mNames.emplace_back(name);
+        mIds.emplace(stored, id);
+        mBytes += name.size();
+        return id;
+    }
+
+    std::optional<id_type> find(std::string_view name) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mMutex);
+        auto it = mIds.find(name);
+        if (it == mIds.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    std::string_view name(id_type id) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mMutex);
+        return mNames.at(id);
+    }
+
+    std::size_t size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mMutex);
+        return mNames.size();
+    }
+
+    // the table used by symbol arguments, it has the default capacity
+    static symbol_table & global()
+    {
+        static symbol_table table;
+        return table;
+    }
+
+private:
+    mutable std::shared_mutex mMutex;
+    // deque elements don't move, i.e. the keys of mIds stay valid
+    std::deque<std::string> mNames;
+    std::unordered_map<std::string_view, id_type> mIds;
+    std::size_t mBytes = 0;
+    const std::size_t mMaxSymbols;
+    const std::size_t mMaxBytes;
+};
+
+// a free-form name argument which is interned into symbol_table::global(),
+// i.e. repeated names map to the same stable id. Once the table is full,
+// unknown names are rejected with a symbol_table_full_error.
+struct symbol
+{
+    symbol_table::id_type id;
+
+    std::string_view name() const
+    {
+        return symbol_table::global().name(id);
+    }
+
+    friend bool operator==(symbol lhs, symbol rhs)
+    {
+        return lhs.id == rhs.id;
+    }
+    friend bool operator!=(symbol lhs, symbol rhs)
+    {
+        return lhs.id != rhs.id;
+    }
+    friend bool operator<(symbol lhs, symbol rhs)
+    {
+        return lhs.id < rhs.id;
+    }
+};
+
+template< >
+struct serialization_traits< symbol >
+{
+    void deserialize(std::string_view str, symbol &out) const
+    {
+        out.id = symbol_table::global().intern(str);
+    }
+    std::to_chars_result serialize(char *first, char *last, symbol in) const
+    {
+        return detail::write_escaped_token(first, last, in.name());
+    }
+};
+
+
+}
@@ -5,10 +5,14 @@
 //
 #pragma once
 
+#include <cstddef>
 #include <exception>
 #include <string_view>
 
-#include <boost/exception/all.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/info.hpp>
+#include <boost/exception/exception.hpp>
+#include <boost/exception/get_error_info.hpp>
 
 namespace ucmdp
 {
@@ -16,6 +20,18 @@ namespace ucmdp
 using last_token_info = boost::error_info<struct last_token_info_tag, std::string>;
 using command_part_info = boost::error_info<struct command_part_info_tag, std::string>;
 using arg_part_info = boost::error_info<struct arg_part_info_tag, std::string>;
+using option_name_info = boost::error_info<struct option_name_info_tag, std::string>;
+// the rejected value of an option
+using option_value_info = boost::error_info<struct option_value_info_tag, std::string>;
+// byte offset of the offending input relative to the dispatched command
+using input_offset_info = boost::error_info<struct input_offset_info_tag, std::size_t>;
+// 1-based line number of the failing command within a script
+using script_line_info = boost::error_info<struct script_line_info_tag, std::size_t>;
+// 1-based number of the failing statement within a command line
+using statement_info = boost::error_info<struct statement_info_tag, std::size_t>;
+// the accepted values of an enum argument separated by ", "
+using valid_values_info = boost::error_info<struct valid_values_info_tag, std::string>;
+using nested_exception_info = boost::error_info<struct nested_exception_info_tag, std::exception_ptr>;
 
 class cmd_exception
     : public virtual std::exception
@@ -79,6 +95,42 @@ class invalid_floating_point_error
 {
 };
 
+class option_error
+    : public virtual command_argument_serialization_error
+{
+};
+
+class unknown_option_error
+    : public virtual option_error
+{
+};
+
+class duplicate_option_error
+    : public virtual option_error
+{
+};
+
+class missing_option_value_error
+    : public virtual option_error
+{
+};
+
+class invalid_option_value_error
+    : public virtual option_error
+{
+};
+
+// see valid_values_info
+class invalid_enum_value_error
+    : public virtual command_argument_serialization_error
+{
+};
+
+// a symbol argument would have exceeded the capacity of the symbol_table
+class symbol_table_full_error
+    : public virtual command_argument_serialization_error
+{
+};
 
 class too_many_arguments_error
     : public virtual command_not_found_error
@@ -92,6 +144,48 @@ class not_enough_arguments_error
 {
 };
 
+// wraps exceptions not derived from boost::exception which have been
+// thrown by script commands, see nested_exception_info
+class script_error
+    : public virtual cmd_exception
+{
+};
+
+// the command has been shed by a rate limit of the command tree before its
+// arguments were parsed, see command_tree::limit
+class rate_limited_error
+    : public virtual cmd_exception
+{
+};
+
+// a command_tree can't be mounted at a prefix which has commands below it,
+// commands can't be inserted below a mount point and mounts can't be cyclic
+class mount_error
+    : public virtual cmd_exception
+{
+};
+
+// a journal file couldn't be created or is malformed, see
+// boost::errinfo_file_name and boost::errinfo_errno
+class journal_error
+    : public virtual cmd_exception
+{
+};
+
+// a command tree image couldn't be written, is malformed or doesn't match
+// the registered commands, see boost::errinfo_file_name
+class tree_image_error
+    : public virtual cmd_exception
+{
+};
+
+// a shared memory command channel doesn't exist or has an incompatible
+// layout, see boost::errinfo_file_name
+class shm_channel_error
+    : public virtual cmd_exception
+{
+};
+
 class token_stream_error
     : public virtual cmd_exception
 {
@@ -102,5 +196,29 @@ class end_of_token_stream_error
 {
 };
 
+class invalid_escape_sequence_error
+    : public virtual token_stream_error
+{
+};
+
+class invalid_utf8_error
+    : public virtual token_stream_error
+{
+};
+
+// a bracketed or braced literal doesn't balance, isn't followed by a
+// separator or is malformed where a structured_view navigates it, see
+// input_offset_info
+class structured_literal_error
+    : public virtual token_stream_error
+{
+};
+
+// structured_view::operator[] didn't find the member or element
+class structured_member_not_found_error
+    : public virtual cmd_exception
+{
+};
+
 
 }
@@ -0,0 +1,868 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <algorithm>
+#include <string_view>
+
+#include <boost/predef.h>
+
+#include "../command_tree.hpp"
+
+namespace ucmdp
+{
+
+
+UCMDP_DECL auto command_tree::node::insert(detail::cmd_token_stream &nameTokenStream)
+    -> node &
+{
+    token_list path;
+    while (nameTokenStream)
+    {
+        path.push_back(nameTokenStream.next());
+    }
+    return insert(path.begin(), path.end());
+}
+
+UCMDP_DECL auto command_tree::node::insert(token_list::iterator first, token_list::iterator last)
+    -> node &
+{
+    if (first == last)
+    {
+        return *this;
+    }
+    if (mMount)
+    {
+        BOOST_THROW_EXCEPTION(
+            mount_error{}
+        );
+    }
+
+    auto childIter = mChilds.find(*first);
+    if (childIter == mChilds.end())
+    {
+        auto &child = mChilds[std::move(*first)];
+        child.assign_edge(std::next(first), last);
+        return child;
+    }
+
+    auto &child = childIter->second;
+    ++first;
+    if (!child.mEdge.empty())
+    {
+        auto edge = child.edge_tokens();
+        auto [edgeIter, pathIter] = std::mismatch(edge.begin(), edge.end(), first, last);
+        if (edgeIter != edge.end())
+        {
+            child.split_edge(edge, edgeIter - edge.begin());
+        }
+        first = pathIter;
+    }
+    return child.insert(first, last);
+}
+
+UCMDP_DECL auto command_tree::node::find(detail::cmd_token_stream &nameTokenStream) const
+    -> const node *
+{
+    const node *current = this;
+    std::string buffer;
+    while (nameTokenStream)
+    {
+        auto childIter = current->mChilds.find(nameTokenStream.next(buffer));
+        if (childIter == current->mChilds.end())
+        {
+            return nullptr;
+        }
+        current = &childIter->second;
+        for (auto &expected : current->edge_tokens())
+        {
+            if (!nameTokenStream || nameTokenStream.next(buffer) != expected)
+            {
+                return nullptr;
+            }
+        }
+    }
+    return current;
+}
+
+UCMDP_DECL auto command_tree::node::edge_tokens() const
+    -> token_list
+{
+    token_list tokens;
+    detail::cmd_token_stream edgeTokenStream{ mEdge };
+    while (edgeTokenStream)
+    {
+        tokens.push_back(edgeTokenStream.next());
+    }
+    return tokens;
+}
+
+UCMDP_DECL void command_tree::node::assign_edge(token_list::iterator first, token_list::iterator last)
+{
+    mEdge.clear();
+    for (auto it = first; it != last; ++it)
+    {
+        if (it != first)
+        {
+            mEdge.push_back(detail::cmd_token_stream::separator_char);
+        }
+        detail::append_escaped_token(mEdge, *it);
+    }
+}
+
+UCMDP_DECL void command_tree::node::split_edge(token_list &edge, std::size_t at)
+{
+    node tail;
+    tail.assign_edge(edge.begin() + at + 1, edge.end());
+    tail.mChilds = std::move(mChilds);
+    tail.mCommand = mCommand;
+    tail.mMount = std::move(mMount);
+    tail.mLimiter = std::move(mLimiter);
+
+    mChilds.clear();
+    mCommand = invalid_command_id;
+    mChilds.emplace(std::move(edge[at]), std::move(tail));
+    assign_edge(edge.begin(), edge.begin() + at);
+}
+
+UCMDP_DECL auto command_tree::node::resolve(detail::cmd_token_stream &params,
+                                       const command_tree *&owner) const
+    -> const node &
+{
+    return *walk(params, owner, true);
+}
+
+UCMDP_DECL auto command_tree::node::try_resolve(detail::cmd_token_stream &params,
+                                           const command_tree *&owner) const
+    -> const node *
+{
+    return walk(params, owner, false);
+}
+
+UCMDP_DECL auto command_tree::node::walk(detail::cmd_token_stream &params,
+                                    const command_tree *&owner, bool raise) const
+    -> const node *
+{
+    struct layout
+    {
+        const command_tree *&owner;
+
+        std::string_view edge(const node &current) const
+        {
+            return current.mEdge;
+        }
+        const node * enter(const node *current) const
+        {
+            if (current->mMount)
+            {
+                owner = current->mMount.get();
+                current = &owner->mCommandTreeRoot;
+            }
+            return current;
+        }
+        bool has_childs(const node &current) const
+        {
+            return !current.mChilds.empty();
+        }
+        const node * find_child(const node &current, std::string_view key) const
+        {
+            auto it = current.mChilds.find(key);
+            return it != current.mChilds.end() ? &it->second : nullptr;
+        }
+    };
+    return detail::walk_path(this, params, layout{ owner }, raise);
+}
+
+UCMDP_DECL command_tree::command_tree(tokenizer_options options)
+    : mCommandTreeRoot()
+    , mTokenizerOptions(options)
+{
+}
+
+UCMDP_DECL command_tree::command_tree(initializer_list cmds, tokenizer_options options)
+    : mCommandTreeRoot()
+    , mTokenizerOptions(options)
+{
+#if BOOST_COMP_MSVC <= BOOST_VERSION_NUMBER(19,11,0)
+    for (auto& t : cmds)
+    {
+        insert(std::get<0>(t), std::get<1>(t));
+    }
+#else
+    for (auto& [cmdName, cmdDelegate] : cmds)
+    {
+        insert(cmdName, cmdDelegate);
+    }
+#endif
+}
+
+UCMDP_DECL std::string command_tree::canonical_path(std::string_view cmd)
+{
+    detail::cmd_token_stream nameTokenStream { cmd };
+    std::string path;
+    for (std::string buffer; nameTokenStream;)
+    {
+        if (!path.empty())
+        {
+            path.push_back(detail::cmd_token_stream::separator_char);
+        }
+        detail::append_escaped_token(path, nameTokenStream.next(buffer));
+    }
+    return path;
+}
+
+UCMDP_DECL void command_tree::insert(std::string_view cmd, command_delegate action)
+{
+    auto path = canonical_path(cmd);
+    detail::cmd_token_stream pathTokenStream { path };
+    auto &target = mCommandTreeRoot.insert(pathTokenStream);
+    if (target.mMount)
+    {
+        BOOST_THROW_EXCEPTION(
+            mount_error{}
+                << command_part_info(std::move(path))
+        );
+    }
+    filter_path(path);
+    auto &id = target.mCommand;
+    if (id == invalid_command_id)
+    {
+        id = static_cast<command_id>(mCommands.size());
+        auto limiter = mLimited ? inherited_limiter(path) : nullptr;
+        mCommands.push_back({ std::move(path), std::move(action), std::move(limiter) });
+    }
+    else
+    {
+        mCommands[id].action = std::move(action);
+    }
+}
+
+UCMDP_DECL void command_tree::filter_path(std::string_view path)
+{
+    detail::cmd_token_stream pathTokenStream{ path };
+    if (!pathTokenStream)
+    {
+        mRootFilter.pass_all();
+        return;
+    }
+    const auto first = pathTokenStream.next();
+    if (!pathTokenStream)
+    {
+        mRootFilter.add_first(first, true);
+        return;
+    }
+    mRootFilter.add_first(first, false);
+    mRootFilter.add_pair(first, pathTokenStream.next());
+}
+
+UCMDP_DECL void command_tree::operator()(std::string_view cmd) const
+{
+    execute(prepare(cmd));
+}
+
+UCMDP_DECL auto command_tree::prepare(std::string_view cmd) const
+    -> prepared_command
+{
+    UCMDP_TRACE_SCOPE("resolve", invalid_command_id);
+    detail::cmd_token_stream cmdTokenStream { cmd, mTokenizerOptions };
+    const command_tree *owner = this;
+    auto &target = mCommandTreeRoot.resolve(cmdTokenStream, owner);
+    return prepared_command{ *owner, target.command(), cmdTokenStream };
+}
+
+UCMDP_DECL auto command_tree::parse(std::string_view cmd) const
+    -> prepared_command
+{
+    auto prepared = prepare(cmd);
+    const auto &owner = *prepared.mOwner;
+    if (prepared.mId >= owner.mCommands.size())
+    {
+        return prepared;
+    }
+    auto thunk = owner.mCommands[prepared.mId].action.target<detail::command_thunk>();
+    if (!thunk)
+    {
+        // other delegates can only be run as a whole
+        return prepared;
+    }
+    detail::dispatch_state state{ owner.mTokenizerOptions };
+    detail::dispatch_scope scope{ state };
+    try
+    {
+        prepared.mParsed = thunk->parse(thunk->command, prepared.mParams.remaining());
+    }
+    catch (boost::exception &exc)
+    {
+        annotate(exc, prepared.mParams);
+        throw;
+    }
+    return prepared;
+}
+
+UCMDP_DECL auto command_tree::resolve(std::string_view cmd) const
+    -> route
+{
+    UCMDP_TRACE_SCOPE("resolve", invalid_command_id);
+    if (!mRootFilter.may_resolve(cmd, mTokenizerOptions.unicode_whitespace))
+    {
+        return { invalid_command_id, this, 0 };
+    }
+    detail::cmd_token_stream cmdTokenStream { cmd, mTokenizerOptions };
+    const command_tree *owner = this;
+    auto target = mCommandTreeRoot.try_resolve(cmdTokenStream, owner);
+    return {
+        target ? target->command() : invalid_command_id,
+        owner,
+        cmdTokenStream.consumed().size()
+    };
+}
+
+UCMDP_DECL void command_tree::execute(const prepared_command &cmd) const
+{
+    if (try_execute(cmd) == dispatch_status::rate_limited)
+    {
+        BOOST_THROW_EXCEPTION(
+            rate_limited_error{}
+                << command_part_info(std::string{cmd.path()})
+        );
+    }
+}
+
+UCMDP_DECL dispatch_status command_tree::try_dispatch(std::string_view cmd) const
+{
+    if (!mRejectUnknown)
+    {
+        return try_execute(prepare(cmd));
+    }
+    if (!mRootFilter.may_resolve(cmd, mTokenizerOptions.unicode_whitespace))
+    {
+        return dispatch_status::unknown_command;
+    }
+
+    std::optional<prepared_command> prepared;
+    {
+        UCMDP_TRACE_SCOPE("resolve", invalid_command_id);
+        detail::cmd_token_stream cmdTokenStream { cmd, mTokenizerOptions };
+        const command_tree *owner = this;
+        auto target = mCommandTreeRoot.try_resolve(cmdTokenStream, owner);
+        if (!target || target->command() == invalid_command_id)
+        {
+            return dispatch_status::unknown_command;
+        }
+        prepared.emplace(prepared_command{ *owner, target->command(), cmdTokenStream });
+    }
+    return try_execute(*prepared);
+}
+
+UCMDP_DECL dispatch_status command_tree::try_execute(const prepared_command &cmd) const
+{
+    return execute_into(cmd, nullptr);
+}
+
+UCMDP_DECL std::to_chars_result command_tree::dispatch(std::string_view cmd,
+                                                       char *first, char *last) const
+{
+    return execute(prepare(cmd), first, last);
+}
+
+UCMDP_DECL std::to_chars_result command_tree::execute(const prepared_command &cmd,
+                                                      char *first, char *last) const
+{
+    detail::response_buffer response{ first, last };
+    if (execute_into(cmd, &response) == dispatch_status::rate_limited)
+    {
+        BOOST_THROW_EXCEPTION(
+            rate_limited_error{}
+                << command_part_info(std::string{cmd.path()})
+        );
+    }
+    return response.result;
+}
+
+UCMDP_DECL void command_tree::operator()(std::string_view cmd, dispatch_context &context) const
+{
+    execute(prepare(cmd), context);
+}
+
+UCMDP_DECL void command_tree::execute(const prepared_command &cmd, dispatch_context &context) const
+{
+    if (execute_into(cmd, nullptr, &context) == dispatch_status::rate_limited)
+    {
+        BOOST_THROW_EXCEPTION(
+            rate_limited_error{}
+                << command_part_info(std::string{cmd.path()})
+        );
+    }
+}
+
+UCMDP_DECL dispatch_status command_tree::execute_into(const prepared_command &cmd,
+                                                      detail::response_buffer *response,
+                                                      dispatch_context *context) const
+{
+    const auto &owner = *cmd.mOwner;
+    if (owner.mLimited && cmd.mId < owner.mCommands.size())
+    {
+        // shedding happens before anything else, i.e. before the observer
+        // and the argument parsing
+        const auto &limiter = owner.mCommands[cmd.mId].limiter;
+        if (limiter && !limiter->try_acquire())
+        {
+            return dispatch_status::rate_limited;
+        }
+    }
+
+    UCMDP_TRACE_SCOPE("execute", cmd.mId);
+    detail::dispatch_state state{ owner.mTokenizerOptions, response, context };
+    detail::dispatch_scope scope{ state };
+
+    if (mObserver)
+    {
+        mObserver(cmd);
+    }
+    owner.run(cmd);
+    return dispatch_status::executed;
+}
+
+UCMDP_DECL std::size_t command_tree::dispatch_line(std::string_view line) const
+{
+    detail::cmd_statement_stream statements{ line };
+    std::exception_ptr firstError;
+    std::size_t executed = 0;
+    std::size_t number = 0;
+    bool skip = false;
+    while (statements)
+    {
+        detail::statement_link link;
+        const auto statement = statements.next(link);
+        if (statement.empty())
+        {
+            skip = skip && link == detail::statement_link::conjunction;
+            continue;
+        }
+        ++number;
+
+        bool succeeded = false;
+        if (!skip)
+        {
+            try
+            {
+                (*this)(statement);
+                succeeded = true;
+                ++executed;
+            }
+            catch (boost::exception &exc)
+            {
+                exc << statement_info{ number };
+                if (!firstError)
+                {
+                    firstError = std::current_exception();
+                }
+            }
+            catch (...)
+            {
+                if (!firstError)
+                {
+                    firstError = std::current_exception();
+                }
+            }
+        }
+        // a skipped statement fails the remaining statements of its chain
+        skip = !succeeded && link == detail::statement_link::conjunction;
+    }
+    if (firstError)
+    {
+        std::rethrow_exception(firstError);
+    }
+    return executed;
+}
+
+UCMDP_DECL void command_tree::mount(std::string_view prefix, std::shared_ptr<const command_tree> tree)
+{
+    auto path = canonical_path(prefix);
+    if (!tree || tree.get() == this || tree->mounts(*this))
+    {
+        BOOST_THROW_EXCEPTION(
+            mount_error{}
+                << command_part_info(std::move(path))
+        );
+    }
+
+    detail::cmd_token_stream pathTokenStream { path };
+    auto &target = mCommandTreeRoot.insert(pathTokenStream);
+    if (!target.mChilds.empty() || target.mCommand != invalid_command_id)
+    {
+        BOOST_THROW_EXCEPTION(
+            mount_error{}
+                << command_part_info(std::move(path))
+        );
+    }
+    target.mMount = std::move(tree);
+    filter_path(path);
+}
+
+UCMDP_DECL bool command_tree::unmount(std::string_view prefix)
+{
+    auto path = canonical_path(prefix);
+    detail::cmd_token_stream pathTokenStream { path };
+    auto target = mCommandTreeRoot.find(pathTokenStream);
+    if (!target || !target->mMount)
+    {
+        return false;
+    }
+    target->mMount.reset();
+    return true;
+}
+
+UCMDP_DECL void command_tree::limit(std::string_view prefix, rate_limit limit)
+{
+    auto path = canonical_path(prefix);
+    detail::cmd_token_stream pathTokenStream { path };
+    auto &target = mCommandTreeRoot.insert(pathTokenStream);
+    if (target.mMount)
+    {
+        // the commands below belong to the mounted tree
+        BOOST_THROW_EXCEPTION(
+            mount_error{}
+                << command_part_info(std::move(path))
+        );
+    }
+    target.mLimiter = std::make_shared<detail::rate_limiter>(limit);
+    update_limiters();
+}
+
+UCMDP_DECL bool command_tree::unlimit(std::string_view prefix)
+{
+    auto path = canonical_path(prefix);
+    detail::cmd_token_stream pathTokenStream { path };
+    auto target = mCommandTreeRoot.find(pathTokenStream);
+    if (!target || !target->mLimiter)
+    {
+        return false;
+    }
+    target->mLimiter.reset();
+    update_limiters();
+    return true;
+}
+
+UCMDP_DECL auto command_tree::limit_stats(std::string_view prefix) const
+    -> std::optional<rate_limit_stats>
+{
+    auto path = canonical_path(prefix);
+    detail::cmd_token_stream pathTokenStream { path };
+    auto target = mCommandTreeRoot.find(pathTokenStream);
+    if (!target || !target->mLimiter)
+    {
+        return std::nullopt;
+    }
+    return target->mLimiter->stats();
+}
+
+UCMDP_DECL auto command_tree::find_command(std::string_view path) const
+    -> const command_entry *
+{
+    auto canonical = canonical_path(path);
+    detail::cmd_token_stream pathTokenStream { canonical };
+    auto target = mCommandTreeRoot.find(pathTokenStream);
+    if (!target || target->mCommand == invalid_command_id)
+    {
+        return nullptr;
+    }
+    return &mCommands[target->mCommand];
+}
+
+UCMDP_DECL void command_tree::coalesce(std::string_view path, coalesce_key_extractor key,
+                                       coalesce_policy policy)
+{
+    auto command = find_command(path);
+    if (!command)
+    {
+        BOOST_THROW_EXCEPTION(
+            command_not_found_error{}
+                << command_part_info(std::string{path})
+        );
+    }
+    command->coalescer = std::make_shared<detail::coalesce_rule>(std::move(key), policy);
+}
+
+UCMDP_DECL bool command_tree::uncoalesce(std::string_view path)
+{
+    auto command = find_command(path);
+    if (!command || !command->coalescer)
+    {
+        return false;
+    }
+    command->coalescer.reset();
+    return true;
+}
+
+UCMDP_DECL auto command_tree::coalesce_stats(std::string_view path) const
+    -> std::optional<coalescing_stats>
+{
+    auto command = find_command(path);
+    if (!command || !command->coalescer)
+    {
+        return std::nullopt;
+    }
+    return command->coalescer->stats();
+}
+
+UCMDP_DECL std::size_t command_tree::dispatch_batch(const std::string_view *cmds,
+                                                    std::size_t count,
+                                                    std::size_t *consumed) const
+{
+    struct batch_item
+    {
+        std::optional<prepared_command> cmd;
+        // rethrown when the command is due to keep the order of failures
+        std::exception_ptr error;
+        detail::coalesce_rule *rule = nullptr;
+        std::string_view key;
+        bool skip = false;
+    };
+
+    std::vector<batch_item> items(count);
+    std::vector<std::size_t> coalescible;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto &item = items[i];
+        try
+        {
+            item.cmd.emplace(prepare(cmds[i]));
+            const auto &owner = *item.cmd->mOwner;
+            if (item.cmd->mId >= owner.mCommands.size())
+            {
+                continue;
+            }
+            if (auto &rule = owner.mCommands[item.cmd->mId].coalescer)
+            {
+                if (auto key = rule->key(item.cmd->arguments(), owner.mTokenizerOptions))
+                {
+                    item.rule = rule.get();
+                    item.key = *key;
+                    coalescible.push_back(i);
+                }
+            }
+        }
+        catch (...)
+        {
+            item.error = std::current_exception();
+        }
+    }
+
+    // groups the commands with equal rules and keys in batch order and
+    // marks all but the one to keep
+    std::sort(coalescible.begin(), coalescible.end(),
+        [&items](std::size_t lhs, std::size_t rhs)
+        {
+            const auto &l = items[lhs];
+            const auto &r = items[rhs];
+            if (l.rule != r.rule)
+            {
+                return std::less<>{}(l.rule, r.rule);
+            }
+            return l.key != r.key ? l.key < r.key : lhs < rhs;
+        });
+    for (auto first = coalescible.begin(); first != coalescible.end();)
+    {
+        const auto &head = items[*first];
+        auto last = std::find_if(first, coalescible.end(), [&](std::size_t i)
+        {
+            return items[i].rule != head.rule || items[i].key != head.key;
+        });
+        const auto keep = head.rule->policy == coalesce_policy::keep_first ? *first : *(last - 1);
+        for (auto it = first; it != last; ++it)
+        {
+            items[*it].skip = *it != keep;
+        }
+        first = last;
+    }
+
+    std::size_t executed = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto &item = items[i];
+        if (consumed)
+        {
+            *consumed = i + 1;
+        }
+        if (item.error)
+        {
+            std::rethrow_exception(item.error);
+        }
+        if (item.skip)
+        {
+            // counted once reached, the commands behind a failure are left
+            // to the caller and may be dispatched again
+            item.rule->coalesced.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        execute(*item.cmd);
+        if (item.rule)
+        {
+            item.rule->executed.fetch_add(1, std::memory_order_relaxed);
+        }
+        ++executed;
+    }
+    return executed;
+}
+
+UCMDP_DECL auto command_tree::inherited_limiter(std::string_view path) const
+    -> std::shared_ptr<detail::rate_limiter>
+{
+    // path is canonical and leads to an existing node, i.e. the edges match
+    // bytewise
+    detail::cmd_token_stream pathTokenStream { path };
+    const node *current = &mCommandTreeRoot;
+    auto limiter = current->mLimiter;
+    std::string buffer;
+    while (pathTokenStream)
+    {
+        auto childIter = current->mChilds.find(pathTokenStream.next(buffer));
+        if (childIter == current->mChilds.end())
+        {
+            break;
+        }
+        current = &childIter->second;
+        if (!current->mEdge.empty() && !pathTokenStream.skip_prefix(current->mEdge))
+        {
+            break;
+        }
+        if (current->mLimiter)
+        {
+            limiter = current->mLimiter;
+        }
+    }
+    return limiter;
+}
+
+UCMDP_DECL void command_tree::update_limiters()
+{
+    mLimited = false;
+    std::vector<std::pair<const node *, std::shared_ptr<detail::rate_limiter>>> pending{
+        { &mCommandTreeRoot, nullptr }
+    };
+    while (!pending.empty())
+    {
+        auto [current, limiter] = std::move(pending.back());
+        pending.pop_back();
+        if (current->mLimiter)
+        {
+            limiter = current->mLimiter;
+            mLimited = true;
+        }
+        if (current->mCommand != invalid_command_id)
+        {
+            mCommands[current->mCommand].limiter = limiter;
+        }
+        for (auto &child : current->mChilds)
+        {
+            pending.emplace_back(&child.second, limiter);
+        }
+    }
+}
+
+UCMDP_DECL bool command_tree::mounts(const command_tree &tree) const
+{
+    std::vector<const node *> pending{ &mCommandTreeRoot };
+    while (!pending.empty())
+    {
+        auto current = pending.back();
+        pending.pop_back();
+        if (current->mMount)
+        {
+            if (current->mMount.get() == &tree || current->mMount->mounts(tree))
+            {
+                return true;
+            }
+        }
+        for (auto &child : current->mChilds)
+        {
+            pending.push_back(&child.second);
+        }
+    }
+    return false;
+}
+
+UCMDP_DECL auto command_tree::rebind(command_id id, std::string_view cmd, std::size_t argsOffset) const
+    -> std::optional<prepared_command>
+{
+    if (id >= mCommands.size() || argsOffset > cmd.size())
+    {
+        return std::nullopt;
+    }
+
+    // the command path has been consumed including the trailing separator
+    auto recordedPath = cmd.substr(0, argsOffset);
+    const auto &path = mCommands[id].path;
+    if (recordedPath != path
+        && !(recordedPath.size() == path.size() + 1
+            && recordedPath.compare(0, path.size(), path) == 0
+            && recordedPath.back() == detail::cmd_token_stream::separator_char))
+    {
+        return std::nullopt;
+    }
+
+    detail::cmd_token_stream cmdTokenStream { cmd, mTokenizerOptions };
+    cmdTokenStream.skip_to(argsOffset);
+    return prepared_command{ *this, id, cmdTokenStream };
+}
+
+UCMDP_DECL void command_tree::run(const prepared_command &cmd) const
+{
+    const auto id = cmd.mId;
+    auto args = cmd.mParams.remaining();
+    try
+    {
+        if (cmd.mParsed)
+        {
+            cmd.mParsed->invoke();
+            return;
+        }
+        detail::run_delegate(id != invalid_command_id ? &mCommands[id].action : nullptr,
+                             args, mTokenizerOptions);
+    }
+    catch (boost::exception &exc)
+    {
+        annotate(exc, cmd.mParams);
+        throw;
+    }
+}
+
+UCMDP_DECL void command_tree::annotate(boost::exception &exc, const detail::cmd_token_stream &params)
+{
+    auto args = params.remaining();
+    if (!args.empty())
+    {
+        if (auto offset = boost::get_error_info<input_offset_info>(exc))
+        {
+            *offset += args.data() - params.sequence().data();
+        }
+        exc << arg_part_info(std::string{args});
+        // resolve() doesn't read the arguments of leaves, i.e. the first
+        // token may be the malformed one exc is about
+        try
+        {
+            auto argTokens = params;
+            std::string unescapeBuffer;
+            exc << last_token_info{ std::string{argTokens.next(unescapeBuffer)} };
+        }
+        catch (...)
+        {
+        }
+    }
+    exc << command_part_info(std::string{params.consumed()});
+}
+
+
+}
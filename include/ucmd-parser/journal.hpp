@@ -0,0 +1,476 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cerrno>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+#include <condition_variable>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+
+#include "exceptions.hpp"
+#include "command_tree.hpp"
+
+namespace ucmdp
+{
+
+
+// binary journal layout (native byte order):
+//   file header: magic "UCMDJRN\0", u32 version, u32 byte order mark
+//   record:      u64 system clock timestamp in ns, u32 command id,
+//                u32 argument offset, u32 command length, u32 reserved,
+//                command bytes
+namespace detail
+{
+    constexpr char journal_magic[8] = { 'U', 'C', 'M', 'D', 'J', 'R', 'N', '\0' };
+    constexpr std::uint32_t journal_version = 1;
+    constexpr std::uint32_t journal_byte_order_mark = 0x01020304;
+
+    struct journal_file_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order_mark;
+    };
+
+    struct journal_record_header
+    {
+        std::uint64_t timestamp;
+        std::uint32_t id;
+        std::uint32_t args_offset;
+        std::uint32_t length;
+        std::uint32_t reserved;
+    };
+    static_assert(sizeof(journal_record_header) == 24);
+}
+
+struct journal_options
+{
+    // per thread record buffer size, rounded up to a power of two
+    std::size_t thread_buffer_size = std::size_t{ 1 } << 20;
+    std::chrono::milliseconds flush_interval{ 5 };
+    // wait for the background flush if a thread buffer is full instead of
+    // dropping the record
+    bool block_when_full = true;
+};
+
+// appends dispatched commands to a journal file. Each producing thread
+// writes into its own wait free single producer/single consumer ring which
+// a background thread drains into the file. Records of different threads
+// are therefore only ordered per flush cycle.
+class journal_writer
+{
+public:
+    explicit journal_writer(const std::string &path,
+                            journal_options options = journal_options{});
+    ~journal_writer();
+    journal_writer(const journal_writer &) = delete;
+    journal_writer & operator=(const journal_writer &) = delete;
+
+    void append(command_tree::command_id id, std::string_view cmd, std::size_t argsOffset);
+    void append(const command_tree::prepared_command &cmd);
+    // writes all records appended before the call to the file
+    void flush();
+
+    std::uint64_t records_dropped() const
+    {
+        return mDropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    class thread_buffer
+    {
+    public:
+        explicit thread_buffer(std::size_t capacity)
+            : mData(std::make_unique<char[]>(capacity))
+            , mMask(capacity - 1)
+        {
+        }
+
+        std::size_t capacity() const
+        {
+            return mMask + 1;
+        }
+
+        bool try_write(const detail::journal_record_header &header, std::string_view cmd)
+        {
+            const auto size = sizeof(header) + cmd.size();
+            const auto head = mHead.load(std::memory_order_relaxed);
+            const auto tail = mTail.load(std::memory_order_acquire);
+            if (capacity() - (head - tail) < size)
+            {
+                return false;
+            }
+            copy_in(head, reinterpret_cast<const char *>(&header), sizeof(header));
+            copy_in(head + sizeof(header), cmd.data(), cmd.size());
+            mHead.store(head + size, std::memory_order_release);
+            return true;
+        }
+
+        void drain_to(std::FILE *file)
+        {
+            const auto tail = mTail.load(std::memory_order_relaxed);
+            const auto head = mHead.load(std::memory_order_acquire);
+            if (head == tail)
+            {
+                return;
+            }
+            const auto first = tail & mMask;
+            const auto size = head - tail;
+            const auto firstPart = std::min(size, capacity() - first);
+            std::fwrite(mData.get() + first, 1, firstPart, file);
+            std::fwrite(mData.get(), 1, size - firstPart, file);
+            mTail.store(head, std::memory_order_release);
+        }
+
+    private:
+        void copy_in(std::size_t pos, const char *data, std::size_t size)
+        {
+            const auto first = pos & mMask;
+            const auto firstPart = std::min(size, capacity() - first);
+            std::memcpy(mData.get() + first, data, firstPart);
+            std::memcpy(mData.get(), data + firstPart, size - firstPart);
+        }
+
+        std::unique_ptr<char[]> mData;
+        const std::size_t mMask;
+        alignas(64) std::atomic<std::size_t> mHead{ 0 };
+        alignas(64) std::atomic<std::size_t> mTail{ 0 };
+    };
+
+    struct file_closer
+    {
+        void operator()(std::FILE *file) const
+        {
+            std::fclose(file);
+        }
+    };
+
+    thread_buffer & local_buffer();
+    void flush_loop();
+    void drain();
+
+    static std::uint64_t next_instance_id()
+    {
+        static std::atomic<std::uint64_t> counter{ 0 };
+        return ++counter;
+    }
+
+    const std::uint64_t mInstanceId;
+    const journal_options mOptions;
+    std::unique_ptr<std::FILE, file_closer> mFile;
+
+    std::mutex mBuffersMutex;
+    std::vector<std::shared_ptr<thread_buffer>> mBuffers;
+
+    std::mutex mFlushMutex;
+    std::condition_variable mWakeUp;
+    bool mStop = false;
+    std::atomic<std::uint64_t> mDropped{ 0 };
+    std::thread mFlusher;
+};
+
+inline journal_writer::journal_writer(const std::string &path, journal_options options)
+    : mInstanceId(next_instance_id())
+    , mOptions(options)
+    , mFile(std::fopen(path.c_str(), "wb"))
+{
+    if (!mFile)
+    {
+        BOOST_THROW_EXCEPTION(
+            journal_error{}
+                << boost::errinfo_file_name(path)
+                << boost::errinfo_errno(errno)
+        );
+    }
+    std::size_t capacity = 1;
+    while (capacity < std::max<std::size_t>(mOptions.thread_buffer_size, 64))
+    {
+        capacity *= 2;
+    }
+    const_cast<journal_options &>(mOptions).thread_buffer_size = capacity;
+
+    detail::journal_file_header header{};
+    std::memcpy(header.magic, detail::journal_magic, sizeof(header.magic));
+    header.version = detail::journal_version;
+    header.byte_order_mark = detail::journal_byte_order_mark;
+    std::fwrite(&header, sizeof(header), 1, mFile.get());
+
+    mFlusher = std::thread([this]() { flush_loop(); });
+}
+
+inline journal_writer::~journal_writer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mFlushMutex);
+        mStop = true;
+    }
+    mWakeUp.notify_one();
+    mFlusher.join();
+}
+
+inline auto journal_writer::local_buffer()
+    -> thread_buffer &
+{
+    struct cache_entry
+    {
+        std::uint64_t instance;
+        std::shared_ptr<thread_buffer> buffer;
+    };
+    static thread_local std::vector<cache_entry> cache;
+
+    for (auto &entry : cache)
+    {
+        if (entry.instance == mInstanceId)
+        {
+            return *entry.buffer;
+        }
+    }
+
+    // forget the buffers of destroyed writers
+    cache.erase(std::remove_if(cache.begin(), cache.end(),
+        [](const cache_entry &entry) { return entry.buffer.use_count() == 1; }),
+        cache.end());
+
+    auto buffer = std::make_shared<thread_buffer>(mOptions.thread_buffer_size);
+    {
+        std::lock_guard<std::mutex> lock(mBuffersMutex);
+        mBuffers.push_back(buffer);
+    }
+    cache.push_back({ mInstanceId, buffer });
+    return *buffer;
+}
+
+inline void journal_writer::append(command_tree::command_id id, std::string_view cmd,
+                                   std::size_t argsOffset)
+{
+    detail::journal_record_header header{};
+    header.timestamp = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    header.id = id;
+    header.args_offset = static_cast<std::uint32_t>(argsOffset);
+    header.length = static_cast<std::uint32_t>(cmd.size());
+
+    auto &buffer = local_buffer();
+    if (sizeof(header) + cmd.size() > buffer.capacity())
+    {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    while (!buffer.try_write(header, cmd))
+    {
+        if (!mOptions.block_when_full)
+        {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        mWakeUp.notify_one();
+        std::this_thread::yield();
+    }
+}
+
+inline void journal_writer::append(const command_tree::prepared_command &cmd)
+{
+    append(cmd.id(), cmd.command(), cmd.path().size());
+}
+
+inline void journal_writer::drain()
+{
+    std::vector<std::shared_ptr<thread_buffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mBuffersMutex);
+        buffers = mBuffers;
+    }
+    for (auto &buffer : buffers)
+    {
+        buffer->drain_to(mFile.get());
+    }
+}
+
+inline void journal_writer::flush()
+{
+    std::lock_guard<std::mutex> lock(mFlushMutex);
+    drain();
+    std::fflush(mFile.get());
+}
+
+inline void journal_writer::flush_loop()
+{
+    std::unique_lock<std::mutex> lock(mFlushMutex);
+    while (!mStop)
+    {
+        mWakeUp.wait_for(lock, mOptions.flush_interval);
+        drain();
+    }
+    drain();
+    std::fflush(mFile.get());
+}
+
+// appends every command executed by tree to journal
+inline void record_journal(command_tree &tree, std::shared_ptr<journal_writer> journal)
+{
+    tree.observe([journal = std::move(journal)](const command_tree::prepared_command &cmd)
+    {
+        journal->append(cmd);
+    });
+}
+
+
+struct journal_record
+{
+    std::chrono::nanoseconds timestamp;
+    command_tree::command_id id;
+    std::string_view command;
+    std::size_t args_offset;
+};
+
+// maps a journal file into memory. An incomplete trailing record, e.g.
+// after a crash, is ignored.
+class journal_reader
+{
+public:
+    explicit journal_reader(const std::string &path);
+
+    template< typename F >
+    void for_each(F &&f) const;
+
+private:
+    boost::interprocess::mapped_region mRegion;
+    std::string_view mRecords;
+};
+
+inline journal_reader::journal_reader(const std::string &path)
+{
+    namespace bip = boost::interprocess;
+
+    detail::journal_file_header header{};
+    if (std::filesystem::file_size(path) >= sizeof(header))
+    {
+        bip::file_mapping file{ path.c_str(), bip::read_only };
+        mRegion = bip::mapped_region{ file, bip::read_only };
+        mRegion.advise(bip::mapped_region::advice_sequential);
+        std::memcpy(&header, mRegion.get_address(), sizeof(header));
+    }
+    if (std::memcmp(header.magic, detail::journal_magic, sizeof(header.magic)) != 0
+        || header.version != detail::journal_version
+        || header.byte_order_mark != detail::journal_byte_order_mark)
+    {
+        BOOST_THROW_EXCEPTION(
+            journal_error{}
+                << boost::errinfo_file_name(path)
+        );
+    }
+    mRecords = std::string_view{ static_cast<const char *>(mRegion.get_address()), mRegion.get_size() }
+        .substr(sizeof(header));
+}
+
+template< typename F >
+inline void journal_reader::for_each(F &&f) const
+{
+    auto records = mRecords;
+    detail::journal_record_header header;
+    while (records.size() >= sizeof(header))
+    {
+        std::memcpy(&header, records.data(), sizeof(header));
+        if (records.size() - sizeof(header) < header.length)
+        {
+            break;
+        }
+        f(journal_record{
+            std::chrono::nanoseconds{ header.timestamp },
+            header.id,
+            records.substr(sizeof(header), header.length),
+            header.args_offset
+        });
+        records.remove_prefix(sizeof(header) + header.length);
+    }
+}
+
+
+enum class replay_pacing
+{
+    // reproduce the recorded gaps between the commands
+    recorded,
+    // execute the commands as fast as possible
+    unpaced,
+};
+
+struct replay_statistics
+{
+    std::uint64_t commands = 0;
+    // commands executed with their recorded command id
+    std::uint64_t rebound = 0;
+    // commands whose path had to be resolved again
+    std::uint64_t resolved = 0;
+    // commands which failed with a cmd_exception
+    std::uint64_t failed = 0;
+    std::chrono::nanoseconds elapsed{ 0 };
+};
+
+// feeds a journal back into tree. Records whose command id still belongs to
+// the recorded command path skip the tree walk.
+inline replay_statistics replay_journal(const command_tree &tree, const journal_reader &journal,
+                                        replay_pacing pacing = replay_pacing::unpaced)
+{
+    replay_statistics stats;
+    const auto start = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds firstTimestamp{ -1 };
+
+    journal.for_each([&](const journal_record &record)
+    {
+        if (pacing == replay_pacing::recorded)
+        {
+            if (firstTimestamp.count() < 0)
+            {
+                firstTimestamp = record.timestamp;
+            }
+            std::this_thread::sleep_until(start + (record.timestamp - firstTimestamp));
+        }
+
+        ++stats.commands;
+        try
+        {
+            auto cmd = tree.rebind(record.id, record.command, record.args_offset);
+            if (cmd)
+            {
+                ++stats.rebound;
+            }
+            else
+            {
+                ++stats.resolved;
+                cmd = tree.prepare(record.command);
+            }
+            tree.execute(*cmd);
+        }
+        catch (cmd_exception &)
+        {
+            ++stats.failed;
+        }
+    });
+
+    stats.elapsed = std::chrono::steady_clock::now() - start;
+    return stats;
+}
+
+
+}
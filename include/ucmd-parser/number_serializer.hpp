@@ -8,6 +8,7 @@
 #include <cerrno>
 #include <cstddef>
 #include <cstdlib>
+#include <charconv>
 #include <memory.h>
 #include <malloc.h>
 
@@ -16,9 +17,11 @@
 #include <type_traits>
 #include <stdexcept>
 #include <string_view>
+#include <system_error>
 
 #include <boost/config.hpp>
 
+#include "config.hpp"
 #include "exceptions.hpp"
 #include "serializer.hpp"
 
@@ -37,59 +40,11 @@ struct integer_serializer_base
     static constexpr std::size_t max_stack_alloc = 72;
 
     // no inline because of alloca usage
-    BOOST_NOINLINE void deserialize(std::string_view str, T &dest) const
-    {
-        if (str.empty())
-        {
-            BOOST_THROW_EXCEPTION(
-                empty_argument_error{}
-            );
-        }
-        std::unique_ptr<char[]> mem_holder;
-        if (str.back() != '\0')
-        {
-            char *mem;
-            if (str.size() < max_stack_alloc)
-            {
-                mem = reinterpret_cast<char *>(alloca(str.size() + 1));
-            }
-            else
-            {
-                mem_holder = std::make_unique<char[]>(str.size() + 1);
-                mem = mem_holder.get();
-            }
-            memcpy(mem, str.data(), str.size());
-            mem[str.size()] = '\0';
-            str = std::string_view{ mem, str.size() };
-        }
+    BOOST_NOINLINE void deserialize(std::string_view str, T &dest) const;
 
-        char *end;
-        auto tmp = rdrFunc(str.data(), &end, base);
-        if (errno == ERANGE)
-        {
-            if (tmp == std::numeric_limits<T>::max())
-            {
-                BOOST_THROW_EXCEPTION(
-                    integer_overflow_serialization_error{}
-                );
-            }
-            if (tmp == std::numeric_limits<T>::min())
-            {
-                BOOST_THROW_EXCEPTION(
-                    integer_underflow_serialization_error{}
-                );
-            }
-            BOOST_THROW_EXCEPTION(
-                integer_serialization_error{}
-            );
-        }
-        if (str.data() + str.size() != end)
-        {
-            BOOST_THROW_EXCEPTION(
-                invalid_integer_error{}
-            );
-        }
-        dest = tmp;
+    std::to_chars_result serialize(char *first, char *last, T value) const
+    {
+        return std::to_chars(first, last, value, base == 0 ? 10 : base);
     }
 
 protected:
@@ -109,6 +64,63 @@ private:
     const int base;
 };
 
+template< typename T, T(*rdrFunc)(const char *, char **, int) >
+void integer_serializer_base<T, rdrFunc>::deserialize(std::string_view str, T &dest) const
+{
+    if (str.empty())
+    {
+        BOOST_THROW_EXCEPTION(
+            empty_argument_error{}
+        );
+    }
+    std::unique_ptr<char[]> mem_holder;
+    if (str.back() != '\0')
+    {
+        char *mem;
+        if (str.size() < max_stack_alloc)
+        {
+            mem = reinterpret_cast<char *>(alloca(str.size() + 1));
+        }
+        else
+        {
+            mem_holder = std::make_unique<char[]>(str.size() + 1);
+            mem = mem_holder.get();
+        }
+        memcpy(mem, str.data(), str.size());
+        mem[str.size()] = '\0';
+        str = std::string_view{ mem, str.size() };
+    }
+
+    char *end;
+    errno = 0;
+    auto tmp = rdrFunc(str.data(), &end, base);
+    if (errno == ERANGE)
+    {
+        if (tmp == std::numeric_limits<T>::max())
+        {
+            BOOST_THROW_EXCEPTION(
+                integer_overflow_serialization_error{}
+            );
+        }
+        if (tmp == std::numeric_limits<T>::min())
+        {
+            BOOST_THROW_EXCEPTION(
+                integer_underflow_serialization_error{}
+            );
+        }
+        BOOST_THROW_EXCEPTION(
+            integer_serialization_error{}
+        );
+    }
+    if (str.data() + str.size() != end)
+    {
+        BOOST_THROW_EXCEPTION(
+            invalid_integer_error{}
+        );
+    }
+    dest = tmp;
+}
+
 using longlong_serializer = integer_serializer_base<long long, strtoll>;
 using long_serializer = integer_serializer_base<long, strtol>;
 using ulonglong_serializer = integer_serializer_base<unsigned long long, strtoull>;
@@ -154,6 +166,11 @@ public:
         }
         dest = static_cast<T>(tmp);
     }
+
+    std::to_chars_result serialize(char *first, char *last, T value) const
+    {
+        return base_t::serialize(first, last, value);
+    }
 };
 
 
@@ -165,63 +182,201 @@ struct floating_point_serializer_base
 
     static constexpr std::size_t max_stack_alloc = 72;
 
-    BOOST_NOINLINE static void deserialize(std::string_view str, T &dest)
+    BOOST_NOINLINE static void deserialize(std::string_view str, T &dest);
+
+    // shortest representation which reads back as value
+    static std::to_chars_result serialize(char *first, char *last, T value)
+    {
+        return std::to_chars(first, last, value);
+    }
+
+protected:
+    constexpr floating_point_serializer_base() = default;
+    ~floating_point_serializer_base() = default;
+};
+
+template< typename T, T(*rdrFunc)(const char *, char**) >
+void floating_point_serializer_base<T, rdrFunc>::deserialize(std::string_view str, T &dest)
+{
+    if (str.empty())
+    {
+        BOOST_THROW_EXCEPTION(
+            empty_argument_error{}
+        );
+    }
+    std::unique_ptr<char[]> mem_holder;
+    if (str.back() != '\0')
+    {
+        char *mem;
+        if (str.size() < max_stack_alloc)
+        {
+            mem = reinterpret_cast<char *>(alloca(str.size() + 1));
+        }
+        else
+        {
+            mem_holder = std::make_unique<char[]>(str.size() + 1);
+            mem = mem_holder.get();
+        }
+        memcpy(mem, str.data(), str.size());
+        mem[str.size()] = '\0';
+        str = std::string_view{ mem, str.size() };
+    }
+
+    char *end;
+    errno = 0;
+    auto tmp = rdrFunc(str.data(), &end);
+    if (errno == ERANGE)
     {
-        if (str.empty())
+        if (tmp == std::numeric_limits<T>::infinity())
         {
             BOOST_THROW_EXCEPTION(
-                empty_argument_error{}
+                floating_point_overflow_serialization_error{}
             );
         }
-        std::unique_ptr<char[]> mem_holder;
-        if (str.back() != '\0')
+        if (tmp == -std::numeric_limits<T>::infinity())
         {
-            char *mem;
-            if (str.size() < max_stack_alloc)
-            {
-                mem = reinterpret_cast<char *>(alloca(str.size() + 1));
-            }
-            else
-            {
-                mem_holder = std::make_unique<char[]>(str.size() + 1);
-                mem = mem_holder.get();
-            }
-            memcpy(mem, str.data(), str.size());
-            mem[str.size()] = '\0';
-            str = std::string_view{ mem, str.size() };
+            BOOST_THROW_EXCEPTION(
+                floating_point_underflow_serialization_error{}
+            );
         }
+        // value underflow
+    }
+    if (str.data() + str.size() != end)
+    {
+        BOOST_THROW_EXCEPTION(
+            invalid_floating_point_error{}
+        );
+    }
+    dest = tmp;
+}
+
+#if !defined(UCMDP_HEADER_ONLY)
+// instantiated by the core library
+extern template struct integer_serializer_base<long long, strtoll>;
+extern template struct integer_serializer_base<long, strtol>;
+extern template struct integer_serializer_base<unsigned long long, strtoull>;
+extern template struct integer_serializer_base<unsigned long, strtoul>;
+extern template struct floating_point_serializer_base<long double, &strtold>;
+extern template struct floating_point_serializer_base<double, &strtod>;
+extern template struct floating_point_serializer_base<float, &strtof>;
+#endif
+
+
+constexpr unsigned digit_value(char c)
+{
+    return c >= '0' && c <= '9' ? static_cast<unsigned>(c - '0')
+        : c >= 'a' && c <= 'z' ? static_cast<unsigned>(c - 'a' + 10)
+        : c >= 'A' && c <= 'Z' ? static_cast<unsigned>(c - 'A' + 10)
+        : 36u;
+}
 
-        char *end;
-        auto tmp = rdrFunc(str.data(), &end);
-        if (errno == ERANGE)
+// accumulates the digits of the given base in [first, last) into value and
+// returns the end of the digit sequence
+template< typename U >
+inline const char * accumulate_digits(const char *first, const char *last,
+                                      unsigned base, U &value)
+{
+    static_assert(std::is_unsigned_v<U>);
+    for (; first != last; ++first)
+    {
+        const auto digit = digit_value(*first);
+        if (digit >= base)
         {
-            if (tmp == std::numeric_limits<T>::infinity())
-            {
-                BOOST_THROW_EXCEPTION(
-                    floating_point_overflow_serialization_error{}
-                );
-            }
-            if (tmp == -std::numeric_limits<T>::infinity())
+            break;
+        }
+        if (value > (std::numeric_limits<U>::max() - digit) / base)
+        {
+            BOOST_THROW_EXCEPTION(
+                integer_overflow_serialization_error{}
+            );
+        }
+        value = static_cast<U>(value * base + digit);
+    }
+    return first;
+}
+
+// parses an optionally signed integer in a single pass without any runtime
+// configuration. Base 2 and 16 accept a 0b and 0x prefix, base 0 detects
+// the base from the prefix like strtol (plus 0b for binary numbers).
+template< typename T, unsigned Base >
+inline T parse_integer(std::string_view str)
+{
+    static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>);
+    static_assert(Base == 0 || (Base >= 2 && Base <= 36),
+        "Base is neither 0 nor in the interval [2, 36]");
+    using unsigned_type = std::make_unsigned_t<T>;
+
+    if (str.empty())
+    {
+        BOOST_THROW_EXCEPTION(
+            empty_argument_error{}
+        );
+    }
+    auto first = str.data();
+    const auto last = first + str.size();
+    const bool negative = *first == '-';
+    if (negative || *first == '+')
+    {
+        ++first;
+    }
+    if (negative && std::is_unsigned_v<T>)
+    {
+        BOOST_THROW_EXCEPTION(
+            invalid_integer_error{}
+        );
+    }
+
+    unsigned base = Base;
+    const auto prefixed = [&](char lower)
+    {
+        return last - first > 2 && first[0] == '0' && (first[1] | 0x20) == lower;
+    };
+    if ((Base == 0 || Base == 16) && prefixed('x'))
+    {
+        base = 16;
+        first += 2;
+    }
+    else if ((Base == 0 || Base == 2) && prefixed('b'))
+    {
+        base = 2;
+        first += 2;
+    }
+    else if (Base == 0)
+    {
+        base = last - first > 1 && first[0] == '0' ? 8 : 10;
+    }
+
+    unsigned_type magnitude = 0;
+    const auto end = accumulate_digits(first, last, base, magnitude);
+    if (end == first || end != last)
+    {
+        BOOST_THROW_EXCEPTION(
+            invalid_integer_error{}
+        );
+    }
+
+    if constexpr (std::is_signed_v<T>)
+    {
+        constexpr auto maxMagnitude = static_cast<unsigned_type>(std::numeric_limits<T>::max());
+        if (negative)
+        {
+            if (magnitude > maxMagnitude + 1)
             {
                 BOOST_THROW_EXCEPTION(
-                    floating_point_underflow_serialization_error{}
+                    integer_underflow_serialization_error{}
                 );
             }
-            // value underflow
+            return static_cast<T>(-static_cast<T>(magnitude - 1) - 1);
         }
-        if (str.data() + str.size() != end)
+        if (magnitude > maxMagnitude)
         {
             BOOST_THROW_EXCEPTION(
-                invalid_floating_point_error{}
+                integer_overflow_serialization_error{}
             );
         }
-        dest = tmp;
     }
-
-protected:
-    constexpr floating_point_serializer_base() = default;
-    ~floating_point_serializer_base() = default;
-};
+    return static_cast<T>(magnitude);
+}
 
 
 }
@@ -234,12 +389,14 @@ struct serialization_traits<long long>
     : private detail::longlong_serializer
 {
     using detail::longlong_serializer::deserialize;
+    using detail::longlong_serializer::serialize;
 };
 template< >
 struct serialization_traits<unsigned long long>
     : private detail::ulonglong_serializer
 {
     using detail::ulonglong_serializer::deserialize;
+    using detail::ulonglong_serializer::serialize;
 };
 
 template< >
@@ -247,12 +404,14 @@ struct serialization_traits<long>
     : private detail::long_serializer
 {
     using detail::long_serializer::deserialize;
+    using detail::long_serializer::serialize;
 };
 template< >
 struct serialization_traits<unsigned long>
     : private detail::ulong_serializer
 {
     using detail::ulong_serializer::deserialize;
+    using detail::ulong_serializer::serialize;
 };
 
 template< >
@@ -260,39 +419,56 @@ struct serialization_traits<int>
     : private detail::small_integer_serializer<int>
 {
     using detail::small_integer_serializer<int>::deserialize;
+    using detail::small_integer_serializer<int>::serialize;
 };
 template< >
 struct serialization_traits<unsigned int>
     : private detail::small_integer_serializer<unsigned int>
 {
     using detail::small_integer_serializer<unsigned int>::deserialize;
+    using detail::small_integer_serializer<unsigned int>::serialize;
 };
 
+// accepts decimal, 0x hexadecimal, 0 octal and 0b binary notation
 template< >
 struct serialization_traits<std::byte>
 {
 private:
     using number_type = std::underlying_type_t<std::byte>;
-    using impl_type = detail::small_integer_serializer<number_type>;
 
 public:
-    void deserialize(std::string_view str, std::byte &out)
+    void deserialize(std::string_view str, std::byte &out) const
     {
-        number_type tmp;
-        if (str.size() > 2 && str[0] == '0' && str[1] == 'b')
-        {
-            mBinSerializer.deserialize(str, tmp);
-        }
-        else
-        {
-            mStdSerializer.deserialize(str, tmp);
-        }
-        out = std::byte{tmp};
+        out = std::byte{ detail::parse_integer<number_type, 0>(str) };
+    }
+    std::to_chars_result serialize(char *first, char *last, std::byte in) const
+    {
+        return std::to_chars(first, last, std::to_integer<number_type>(in));
     }
+};
 
-private:
-    impl_type mStdSerializer = impl_type(0);
-    impl_type mBinSerializer = impl_type(2);
+
+// an integer argument written in a fixed base, e.g. with_base<2> for bit
+// masks. Base 2 and 16 accept an optional 0b or 0x prefix.
+template< unsigned Base, typename T = unsigned long long >
+struct with_base
+{
+    static_assert(Base >= 2 && Base <= 36, "Base must be in the interval [2, 36]");
+
+    T value;
+};
+
+template< unsigned Base, typename T >
+struct serialization_traits< with_base<Base, T> >
+{
+    void deserialize(std::string_view str, with_base<Base, T> &out) const
+    {
+        out.value = detail::parse_integer<T, Base>(str);
+    }
+    std::to_chars_result serialize(char *first, char *last, with_base<Base, T> in) const
+    {
+        return std::to_chars(first, last, in.value, static_cast<int>(Base));
+    }
 };
 
 
@@ -301,6 +477,7 @@ struct serialization_traits<long double>
     : private detail::floating_point_serializer_base<long double, &strtold>
 {
     using detail::floating_point_serializer_base<long double, &strtold>::deserialize;
+    using detail::floating_point_serializer_base<long double, &strtold>::serialize;
 };
 
 template< >
@@ -308,6 +485,7 @@ struct serialization_traits<double>
     : private detail::floating_point_serializer_base<double, &strtod>
 {
     using detail::floating_point_serializer_base<double, &strtod>::deserialize;
+    using detail::floating_point_serializer_base<double, &strtod>::serialize;
 };
 
 template< >
@@ -315,6 +493,7 @@ struct serialization_traits<float>
     : private detail::floating_point_serializer_base<float, &strtof>
 {
     using detail::floating_point_serializer_base<float, &strtof>::deserialize;
+    using detail::floating_point_serializer_base<float, &strtof>::serialize;
 };
 
 }
@@ -0,0 +1,373 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <tuple>
+#include <bitset>
+#include <string>
+#include <cstddef>
+#include <charconv>
+#include <utility>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <string_view>
+#include <system_error>
+
+#include "exceptions.hpp"
+#include "serializer.hpp"
+#include "detail/perfect_hash.hpp"
+#include "detail/token_stream.hpp"
+
+namespace ucmdp
+{
+
+
+// describes a named option which is stored in the data member `member`.
+// bool members are flags, all other members take a value which is
+// deserialized with the member's serialization_traits.
+template< typename T, typename M >
+struct option_field
+{
+    using object_type = T;
+    using member_type = M;
+
+    std::string_view name;
+    char short_name;
+    M T::*member;
+};
+
+template< typename T, typename M >
+constexpr option_field<T, M> option(std::string_view name, char shortName, M T::*member)
+{
+    return { name, shortName, member };
+}
+template< typename T, typename M >
+constexpr option_field<T, M> option(std::string_view name, M T::*member)
+{
+    return { name, '\0', member };
+}
+
+
+template< typename T, typename... Fields >
+class option_schema
+{
+public:
+    static constexpr std::size_t size = sizeof...(Fields);
+    static constexpr std::size_t npos = size;
+
+    constexpr explicit option_schema(Fields... fields)
+        : mFields(fields...)
+        , mLongNames(std::array<std::string_view, size>{ fields.name... })
+        , mShortNames(make_short_name_table({ fields.short_name... }))
+    {
+    }
+
+    constexpr std::size_t find(std::string_view name) const
+    {
+        return mLongNames.find(name);
+    }
+    constexpr std::size_t find(char shortName) const
+    {
+        return mShortNames[static_cast<unsigned char>(shortName)];
+    }
+
+    constexpr std::string_view name(std::size_t i) const
+    {
+        return mLongNames.keys()[i];
+    }
+
+    // invokes `f(field)` with the field at runtime index i
+    template< typename F >
+    void visit(std::size_t i, F &&f) const
+    {
+        visit_impl(i, f, std::index_sequence_for<Fields...>{});
+    }
+
+private:
+    using short_name_table = std::array<std::size_t, 256>;
+
+    static constexpr short_name_table make_short_name_table(
+        const std::array<char, size> &shortNames)
+    {
+        short_name_table table{};
+        for (auto &entry : table)
+        {
+            entry = npos;
+        }
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (shortNames[i] == '\0')
+            {
+                continue;
+            }
+            auto &entry = table[static_cast<unsigned char>(shortNames[i])];
+            if (entry != npos)
+            {
+                throw std::logic_error("option short names must be unique");
+            }
+            entry = i;
+        }
+        return table;
+    }
+
+    template< typename F, std::size_t... Is >
+    void visit_impl(std::size_t i, F &f, std::index_sequence<Is...>) const
+    {
+        ((i == Is ? (f(std::get<Is>(mFields)), true) : false) || ...);
+    }
+
+    std::tuple<Fields...> mFields;
+    detail::perfect_hash_table<size> mLongNames;
+    short_name_table mShortNames;
+};
+
+template< typename T, typename... Ms >
+constexpr auto make_option_schema(option_field<T, Ms>... fields)
+{
+    return option_schema<T, option_field<T, Ms>...>(fields...);
+}
+
+
+}
+
+namespace ucmdp::detail
+{
+
+
+inline bool looks_like_option(std::string_view raw)
+{
+    // negative numbers are treated as positional arguments
+    return raw.size() > 1 && raw[0] == '-'
+        && !(raw[1] >= '0' && raw[1] <= '9') && raw[1] != '.';
+}
+
+inline bool parse_flag_value(std::string_view name, std::string_view value)
+{
+    if (value == "true" || value == "1")
+    {
+        return true;
+    }
+    if (value == "false" || value == "0")
+    {
+        return false;
+    }
+    BOOST_THROW_EXCEPTION(
+        invalid_option_value_error{}
+            << option_name_info{ std::string{ name } }
+            << option_value_info{ std::string{ value } }
+    );
+}
+
+
+}
+
+namespace ucmdp
+{
+
+
+// token consumer for option structs. It parses a run of `--name=value`,
+// `--name value`, `--flag`, `-f` (bundled flags like `-abc` included) and
+// `-n value` / `-nvalue` tokens and stops at the first positional token or
+// after a `--` token. Requires `serialization_traits<T>::schema` to be a
+// constexpr option_schema created by make_option_schema.
+template< typename T >
+struct options_serializer
+{
+    void deserialize(detail::cmd_token_stream &tokens, T &out) const
+    {
+        const auto &schema = serialization_traits<T>::schema;
+        std::bitset<std::decay_t<decltype(schema)>::size + 1> seen;
+
+        std::string nameBuffer;
+        std::string valueBuffer;
+        while (tokens && detail::looks_like_option(tokens.remaining()))
+        {
+            auto token = tokens.next(nameBuffer);
+            if (token == "--")
+            {
+                break;
+            }
+
+            if (token[1] == '-')
+            {
+                auto name = token.substr(2);
+                std::optional<std::string_view> value;
+                if (auto eqPos = name.find('='); eqPos != std::string_view::npos)
+                {
+                    value = name.substr(eqPos + 1);
+                    name = name.substr(0, eqPos);
+                }
+
+                auto idx = schema.find(name);
+                assign(schema, idx, name, value, tokens, valueBuffer, seen, out);
+            }
+            else
+            {
+                for (std::size_t i = 1; i < token.size(); ++i)
+                {
+                    auto idx = schema.find(token[i]);
+                    auto name = token.substr(i, 1);
+                    if (idx == schema.npos || is_flag(schema, idx))
+                    {
+                        assign(schema, idx, name, std::nullopt, tokens, valueBuffer, seen, out);
+                        continue;
+                    }
+
+                    std::optional<std::string_view> value;
+                    if (i + 1 < token.size())
+                    {
+                        value = token.substr(i + 1);
+                    }
+                    assign(schema, idx, name, value, tokens, valueBuffer, seen, out);
+                    break;
+                }
+            }
+        }
+    }
+
+    // writes every option as `--name=value` token, flags as `--name` or
+    // `--name=false` and leaves out empty optional members
+    std::to_chars_result serialize(char *first, char *last, const T &in) const
+    {
+        const auto &schema = serialization_traits<T>::schema;
+        std::to_chars_result result{ first, std::errc{} };
+        for (std::size_t i = 0; i < schema.size && result.ec == std::errc{}; ++i)
+        {
+            schema.visit(i, [&](const auto &field)
+            {
+                result = write_option(result.ptr, last, result.ptr != first,
+                                      field.name, in.*(field.member));
+            });
+        }
+        return result;
+    }
+
+private:
+    template< typename M >
+    static std::to_chars_result write_option(char *first, char *last, bool separate,
+                                             std::string_view name, const M &value)
+    {
+        if constexpr (is_optional_v<M>)
+        {
+            if (!value)
+            {
+                return { first, std::errc{} };
+            }
+            return write_option(first, last, separate, name, *value);
+        }
+        else
+        {
+            constexpr std::string_view falseSuffix = "=false";
+            std::size_t size = (separate ? 1 : 0) + 2 + name.size() + 1;
+            if constexpr (std::is_same_v<M, bool>)
+            {
+                size = value ? size - 1 : size - 1 + falseSuffix.size();
+            }
+            if (static_cast<std::size_t>(last - first) < size)
+            {
+                return { last, std::errc::value_too_large };
+            }
+            if (separate)
+            {
+                *first++ = detail::cmd_token_stream::separator_char;
+            }
+            *first++ = '-';
+            *first++ = '-';
+            first = std::copy(name.begin(), name.end(), first);
+            if constexpr (std::is_same_v<M, bool>)
+            {
+                if (!value)
+                {
+                    first = std::copy(falseSuffix.begin(), falseSuffix.end(), first);
+                }
+                return { first, std::errc{} };
+            }
+            else
+            {
+                *first++ = '=';
+                return detail::serialize_argument(first, last, value);
+            }
+        }
+    }
+
+    template< typename Schema >
+    static bool is_flag(const Schema &schema, std::size_t idx)
+    {
+        bool flag = false;
+        schema.visit(idx, [&flag](const auto &field)
+        {
+            using field_t = std::decay_t<decltype(field)>;
+            flag = std::is_same_v<typename field_t::member_type, bool>;
+        });
+        return flag;
+    }
+
+    template< typename Schema, typename Seen >
+    static void assign(const Schema &schema, std::size_t idx,
+                       std::string_view name,
+                       std::optional<std::string_view> value,
+                       detail::cmd_token_stream &tokens,
+                       std::string &valueBuffer, Seen &seen, T &out)
+    {
+        if (idx == schema.npos)
+        {
+            BOOST_THROW_EXCEPTION(
+                unknown_option_error{}
+                    << option_name_info{ std::string{ name } }
+            );
+        }
+        if (seen.test(idx))
+        {
+            BOOST_THROW_EXCEPTION(
+                duplicate_option_error{}
+                    << option_name_info{ std::string{ schema.name(idx) } }
+            );
+        }
+        seen.set(idx);
+
+        schema.visit(idx, [&](const auto &field)
+        {
+            using member_t = typename std::decay_t<decltype(field)>::member_type;
+            static_assert(!is_string_view_v<member_t>,
+                "string_view options would dangle, use std::string instead!");
+
+            auto &dest = out.*(field.member);
+            if constexpr (std::is_same_v<member_t, bool>)
+            {
+                dest = value ? detail::parse_flag_value(field.name, *value) : true;
+            }
+            else
+            {
+                if (!value)
+                {
+                    if (!tokens)
+                    {
+                        BOOST_THROW_EXCEPTION(
+                            missing_option_value_error{}
+                                << option_name_info{ std::string{ field.name } }
+                        );
+                    }
+                    value = tokens.next(valueBuffer);
+                }
+                if constexpr (is_optional_v<member_t>)
+                {
+                    serialization_traits<typename member_t::value_type>{}
+                        .deserialize(*value, dest.emplace());
+                }
+                else
+                {
+                    serialization_traits<member_t>{}.deserialize(*value, dest);
+                }
+            }
+        });
+    }
+};
+
+
+}
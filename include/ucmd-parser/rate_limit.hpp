@@ -0,0 +1,107 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <cstdint>
+
+namespace ucmdp
+{
+
+
+// the time source of a rate limit, a monotonic count of nanoseconds
+using rate_limit_clock = std::chrono::nanoseconds (*)();
+
+inline std::chrono::nanoseconds steady_rate_limit_clock()
+{
+    return std::chrono::steady_clock::now().time_since_epoch();
+}
+
+// a token bucket which is refilled with one command per interval and holds
+// up to burst commands
+struct rate_limit
+{
+    std::chrono::nanoseconds interval;
+    std::uint32_t burst = 1;
+    rate_limit_clock clock = &steady_rate_limit_clock;
+
+    static rate_limit per_second(double rate, std::uint32_t burst = 1)
+    {
+        return { std::chrono::nanoseconds{ static_cast<std::int64_t>(1e9 / rate) }, burst };
+    }
+};
+
+struct rate_limit_stats
+{
+    std::uint64_t admitted;
+    std::uint64_t rejected;
+};
+
+
+}
+
+namespace ucmdp::detail
+{
+
+
+// lock free token bucket implemented as generic cell rate algorithm, i.e.
+// the state is the theoretical arrival time of the next command which
+// leaves the bucket empty. A burst of 0 rejects all commands.
+class rate_limiter
+{
+public:
+    explicit rate_limiter(const rate_limit &limit)
+        : mLimit(limit)
+        , mTolerance(limit.burst == 0 ? -1
+            : limit.interval.count() * (static_cast<std::int64_t>(limit.burst) - 1))
+    {
+    }
+
+    bool try_acquire()
+    {
+        const auto now = mLimit.clock().count();
+        const auto interval = mLimit.interval.count();
+        auto arrival = mArrival.load(std::memory_order_relaxed);
+        std::int64_t next;
+        do
+        {
+            const auto start = arrival > now ? arrival : now;
+            if (start - now > mTolerance)
+            {
+                mRejected.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            next = start + interval;
+        }
+        while (!mArrival.compare_exchange_weak(arrival, next, std::memory_order_relaxed));
+        mAdmitted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    const rate_limit & limit() const
+    {
+        return mLimit;
+    }
+    rate_limit_stats stats() const
+    {
+        return {
+            mAdmitted.load(std::memory_order_relaxed),
+            mRejected.load(std::memory_order_relaxed)
+        };
+    }
+
+private:
+    const rate_limit mLimit;
+    const std::int64_t mTolerance;
+    std::atomic<std::int64_t> mArrival{ std::numeric_limits<std::int64_t>::min() };
+    std::atomic<std::uint64_t> mAdmitted{ 0 };
+    std::atomic<std::uint64_t> mRejected{ 0 };
+};
+
+
+}
@@ -0,0 +1,304 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <mutex>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <thread>
+#include <cstddef>
+#include <optional>
+#include <exception>
+#include <filesystem>
+#include <string_view>
+#include <condition_variable>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "exceptions.hpp"
+#include "command_tree.hpp"
+
+namespace ucmdp
+{
+
+
+struct script_runner_options
+{
+    // number of threads parsing lines ahead of execution,
+    // 0 executes the script sequentially on the calling thread
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    // approximate number of bytes per work item
+    std::size_t chunk_size = std::size_t{ 1 } << 20;
+    // upper bound of parsed but not yet executed work items per thread
+    std::size_t chunks_in_flight_per_thread = 4;
+};
+
+// executes newline separated command scripts. Worker threads resolve the
+// command paths and parse the arguments of commands created by make_command
+// while the calling thread only invokes the handlers strictly in script
+// order. Empty lines are skipped, a trailing '\r' is
+// stripped. Execution stops at the first failing line whose 1-based number
+// is attached to the exception as script_line_info.
+class script_runner
+{
+public:
+    explicit script_runner(const command_tree &tree,
+                           script_runner_options options = script_runner_options{});
+
+    void run(std::string_view script) const;
+    // maps the file into memory instead of reading it
+    void run_file(const std::string &path) const;
+    void run_sequential(std::string_view script) const;
+
+private:
+    struct prepared_line
+    {
+        std::size_t line;
+        std::optional<command_tree::prepared_command> command;
+        std::exception_ptr error;
+    };
+
+    struct chunk
+    {
+        std::string_view text;
+        std::size_t line_count = 0;
+        std::vector<prepared_line> lines;
+        bool ready = false;
+    };
+
+    template< typename F >
+    static std::size_t for_each_line(std::string_view text, F &&f);
+    static std::vector<chunk> split(std::string_view script, std::size_t chunkSize);
+
+    void prepare(chunk &work) const;
+    void execute(std::size_t lineBase, const prepared_line &work) const;
+
+    const command_tree &mTree;
+    script_runner_options mOptions;
+};
+
+inline script_runner::script_runner(const command_tree &tree, script_runner_options options)
+    : mTree(tree)
+    , mOptions(options)
+{
+}
+
+template< typename F >
+inline std::size_t script_runner::for_each_line(std::string_view text, F &&f)
+{
+    std::size_t line = 0;
+    for (std::size_t pos = 0; pos < text.size(); ++line)
+    {
+        auto end = text.find('\n', pos);
+        if (end == std::string_view::npos)
+        {
+            end = text.size();
+        }
+        auto content = text.substr(pos, end - pos);
+        if (!content.empty() && content.back() == '\r')
+        {
+            content.remove_suffix(1);
+        }
+        if (!content.empty())
+        {
+            f(line, content);
+        }
+        pos = end + 1;
+    }
+    return line;
+}
+
+inline auto script_runner::split(std::string_view script, std::size_t chunkSize)
+    -> std::vector<chunk>
+{
+    std::vector<chunk> chunks;
+    chunks.reserve(script.size() / chunkSize + 1);
+    for (std::size_t pos = 0; pos < script.size();)
+    {
+        auto end = script.find('\n', std::min(pos + chunkSize, script.size()) - 1);
+        end = end == std::string_view::npos ? script.size() : end + 1;
+        chunks.emplace_back().text = script.substr(pos, end - pos);
+        pos = end;
+    }
+    return chunks;
+}
+
+inline void script_runner::prepare(chunk &work) const
+{
+    work.line_count = for_each_line(work.text,
+        [this, &work](std::size_t line, std::string_view content)
+    {
+        try
+        {
+            work.lines.push_back({ line, mTree.parse(content), nullptr });
+        }
+        catch (...)
+        {
+            work.lines.push_back({ line, std::nullopt, std::current_exception() });
+        }
+    });
+}
+
+inline void script_runner::execute(std::size_t lineBase, const prepared_line &work) const
+{
+    const auto line = lineBase + work.line + 1;
+    try
+    {
+        if (work.error)
+        {
+            std::rethrow_exception(work.error);
+        }
+        mTree.execute(*work.command);
+    }
+    catch (boost::exception &exc)
+    {
+        exc << script_line_info{ line };
+        throw;
+    }
+    catch (...)
+    {
+        BOOST_THROW_EXCEPTION(
+            script_error{}
+                << script_line_info{ line }
+                << nested_exception_info(std::current_exception())
+        );
+    }
+}
+
+inline void script_runner::run_sequential(std::string_view script) const
+{
+    for_each_line(script, [this](std::size_t line, std::string_view content)
+    {
+        prepared_line work{ line, std::nullopt, nullptr };
+        try
+        {
+            work.command = mTree.prepare(content);
+        }
+        catch (...)
+        {
+            work.error = std::current_exception();
+        }
+        execute(0, work);
+    });
+}
+
+inline void script_runner::run(std::string_view script) const
+{
+    if (mOptions.threads == 0)
+    {
+        run_sequential(script);
+        return;
+    }
+
+    auto chunks = split(script, std::max<std::size_t>(mOptions.chunk_size, 1));
+    const auto window = std::max<std::size_t>(
+        mOptions.threads * mOptions.chunks_in_flight_per_thread, 1);
+
+    std::mutex sync;
+    std::condition_variable prepared;
+    std::condition_variable executed;
+    std::size_t nextChunk = 0;
+    std::size_t executedChunks = 0;
+    bool abort = false;
+
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            std::size_t idx;
+            {
+                std::unique_lock<std::mutex> lock(sync);
+                executed.wait(lock, [&]()
+                {
+                    return abort || nextChunk == chunks.size()
+                        || nextChunk < executedChunks + window;
+                });
+                if (abort || nextChunk == chunks.size())
+                {
+                    return;
+                }
+                idx = nextChunk++;
+            }
+
+            prepare(chunks[idx]);
+            {
+                std::lock_guard<std::mutex> lock(sync);
+                chunks[idx].ready = true;
+            }
+            prepared.notify_one();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(mOptions.threads);
+    auto stop = [&]()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sync);
+            abort = true;
+        }
+        executed.notify_all();
+        for (auto &thread : workers)
+        {
+            thread.join();
+        }
+    };
+
+    try
+    {
+        for (unsigned int i = 0; i < mOptions.threads; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+
+        std::size_t lineBase = 0;
+        for (auto &work : chunks)
+        {
+            {
+                std::unique_lock<std::mutex> lock(sync);
+                prepared.wait(lock, [&work]() { return work.ready; });
+            }
+            for (auto &line : work.lines)
+            {
+                execute(lineBase, line);
+            }
+            lineBase += work.line_count;
+            std::vector<prepared_line>{}.swap(work.lines);
+            {
+                std::lock_guard<std::mutex> lock(sync);
+                ++executedChunks;
+            }
+            executed.notify_all();
+        }
+    }
+    catch (...)
+    {
+        stop();
+        throw;
+    }
+    stop();
+}
+
+inline void script_runner::run_file(const std::string &path) const
+{
+    namespace bip = boost::interprocess;
+
+    // empty files can't be mapped
+    if (std::filesystem::file_size(path) == 0)
+    {
+        return;
+    }
+    bip::file_mapping file{ path.c_str(), bip::read_only };
+    bip::mapped_region region{ file, bip::read_only };
+    region.advise(bip::mapped_region::advice_sequential);
+
+    run(std::string_view{ static_cast<const char *>(region.get_address()), region.get_size() });
+}
+
+
+}
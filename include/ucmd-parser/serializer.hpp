@@ -6,21 +6,25 @@
 #pragma once
 
 #include <tuple>
+#include <algorithm>
 #include <string>
+#include <cstddef>
+#include <charconv>
 #include <optional>
+#include <string_view>
 #include <type_traits>
+#include <system_error>
 
-namespace ucmdp::detail
-{
-
-class cmd_token_stream;
-
-}
+#include "detail/token_stream.hpp"
 
 namespace ucmdp
 {
 
 
+// deserialize(std::string_view, T &) or, for types spanning several tokens,
+// deserialize(detail::cmd_token_stream &, T &) parses a command argument.
+// serialize(char *first, char *last, const T &) writes the argument in a form
+// which deserialize reads back and reports the result like std::to_chars.
 template< typename T >
 struct serialization_traits;
 
@@ -67,7 +71,157 @@ struct serialization_traits< std::string >
     {
         out = in;
     }
+    std::to_chars_result serialize(char *first, char *last, std::string_view in) const
+    {
+        return detail::write_escaped_token(first, last, in);
+    }
+};
+
+// the view refers either to the command string or to an unescape buffer which
+// is owned by the dispatching command, i.e. it must not outlive the call.
+template< >
+struct serialization_traits< std::string_view >
+{
+    void deserialize(std::string_view in, std::string_view &out)
+    {
+        out = in;
+    }
+    std::to_chars_result serialize(char *first, char *last, std::string_view in) const
+    {
+        return detail::write_escaped_token(first, last, in);
+    }
 };
 
 
+}
+
+namespace ucmdp::detail
+{
+
+
+template< typename T >
+inline std::to_chars_result serialize_argument(char *first, char *last, const T &arg)
+{
+    if constexpr (is_optional_v<T>)
+    {
+        // an empty optional argument is simply left out
+        if (!arg)
+        {
+            return { first, std::errc{} };
+        }
+        return serialize_argument(first, last, *arg);
+    }
+    else if constexpr (std::is_convertible_v<const T &, std::string_view>)
+    {
+        return serialization_traits<std::string_view>{}.serialize(first, last, arg);
+    }
+    else
+    {
+        return serialization_traits<T>{}.serialize(first, last, arg);
+    }
+}
+
+// writes a separator followed by arg unless arg serializes to nothing
+template< typename T >
+inline std::to_chars_result append_argument(char *first, char *last, bool separate, const T &arg)
+{
+    if (!separate)
+    {
+        return serialize_argument(first, last, arg);
+    }
+    if (first == last)
+    {
+        return { last, std::errc::value_too_large };
+    }
+    auto result = serialize_argument(first + 1, last, arg);
+    if (result.ec != std::errc{})
+    {
+        return result;
+    }
+    if (result.ptr == first + 1)
+    {
+        return { first, std::errc{} };
+    }
+    *first = cmd_token_stream::separator_char;
+    return result;
+}
+
+// appends the arguments to the command at [first, result.ptr) and stops at
+// the first one which doesn't fit. An engaged optional following an empty
+// one is reported as invalid_argument, it would be parsed in its place.
+inline std::to_chars_result append_arguments(char *, char *, std::to_chars_result result, bool)
+{
+    return result;
+}
+template< typename T, typename... Rest >
+inline std::to_chars_result append_arguments(char *first, char *last, std::to_chars_result result,
+                                             bool omitted, const T &arg, const Rest &... rest)
+{
+    if constexpr (is_optional_v<T>)
+    {
+        if (!arg)
+        {
+            return append_arguments(first, last, result, true, rest...);
+        }
+        if (omitted)
+        {
+            return { first, std::errc::invalid_argument };
+        }
+    }
+    result = append_argument(result.ptr, last, result.ptr != first, arg);
+    if (result.ec != std::errc{})
+    {
+        return result;
+    }
+    return append_arguments(first, last, result, omitted, rest...);
+}
+
+// an empty optional is left out, i.e. the arguments following it would be
+// parsed in its place
+template< typename... Args >
+constexpr bool has_trailing_optionals_only()
+{
+    constexpr bool optionals[] = { is_optional_v<Args>..., false };
+    bool seen = false;
+    for (std::size_t i = 0; i != sizeof...(Args); ++i)
+    {
+        if (seen && !optionals[i])
+        {
+            return false;
+        }
+        seen = seen || optionals[i];
+    }
+    return true;
+}
+
+
+}
+
+namespace ucmdp
+{
+
+
+// writes `path arg...` to [first, last) without allocating. path is copied
+// verbatim, i.e. it must already be a valid command path, the arguments are
+// serialized with their serialization_traits. Reports the result like
+// std::to_chars, i.e. returns { last, std::errc::value_too_large } if the
+// buffer is too small. Empty optionals are left out which is why they may
+// only be followed by other optionals which are empty as well, otherwise
+// { first, std::errc::invalid_argument } is returned.
+template< typename... Args >
+inline std::to_chars_result format_command(char *first, char *last,
+                                           std::string_view path, const Args &... args)
+{
+    static_assert(detail::has_trailing_optionals_only<Args...>(),
+        "std::optional arguments may only be followed by std::optional arguments");
+
+    if (static_cast<std::size_t>(last - first) < path.size())
+    {
+        return { last, std::errc::value_too_large };
+    }
+    std::to_chars_result result{ std::copy(path.begin(), path.end(), first), std::errc{} };
+    return detail::append_arguments(first, last, result, false, args...);
+}
+
+
 }
@@ -0,0 +1,575 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include <boost/exception/errinfo_file_name.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#if defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "command_tree.hpp"
+
+namespace ucmdp::detail
+{
+
+
+// the calling thread sleeps while *word == expected, but at most timeout.
+// Spurious wakeups are possible. Other platforms than Linux poll instead.
+inline void futex_wait(std::atomic<std::uint32_t> &word, std::uint32_t expected,
+                       std::chrono::nanoseconds timeout)
+{
+#if defined(__linux__)
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+    timespec relative;
+    relative.tv_sec = static_cast<std::time_t>(timeout.count() / 1000000000);
+    relative.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    // not FUTEX_PRIVATE_FLAG, the word lives in shared memory
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAIT,
+            expected, &relative, nullptr, 0);
+#else
+    if (word.load(std::memory_order_relaxed) == expected)
+    {
+        std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(
+            timeout, std::chrono::microseconds{ 50 }));
+    }
+#endif
+}
+
+inline void futex_wake(std::atomic<std::uint32_t> &word)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE,
+            INT_MAX, nullptr, nullptr, 0);
+#else
+    static_cast<void>(word);
+#endif
+}
+
+// a futex word paired with a flag which the (single) waiter raises before
+// it sleeps, i.e. signalling costs a fence and a load unless the other
+// side is idle
+struct shm_event
+{
+    std::atomic<std::uint32_t> sequence{ 0 };
+    std::atomic<std::uint32_t> waiting{ 0 };
+
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed))
+        {
+            sequence.fetch_add(1, std::memory_order_release);
+            futex_wake(sequence);
+        }
+    }
+
+    // waits until ready() returns true or the deadline has passed
+    template< typename Predicate >
+    bool wait(Predicate &&ready, std::chrono::steady_clock::time_point deadline)
+    {
+        // the other side usually reacts within a few microseconds
+        for (int i = 0; i < 256; ++i)
+        {
+            if (ready())
+            {
+                return true;
+            }
+        }
+        for (;;)
+        {
+            const auto current = sequence.load(std::memory_order_acquire);
+            waiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ready())
+            {
+                waiting.store(0, std::memory_order_relaxed);
+                return true;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+            {
+                waiting.store(0, std::memory_order_relaxed);
+                return false;
+            }
+            futex_wait(sequence, current, deadline - now);
+        }
+    }
+};
+
+// control block of a single producer/single consumer ring in shared memory
+struct shm_ring_control
+{
+    alignas(64) std::atomic<std::uint64_t> head{ 0 };
+    shm_event writable;
+    alignas(64) std::atomic<std::uint64_t> tail{ 0 };
+    shm_event readable;
+};
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free
+    && std::atomic<std::uint32_t>::is_always_lock_free,
+    "the shared memory rings need address free atomics");
+
+struct shm_channel_header
+{
+    static constexpr char magic_value[8] = { 'U', 'C', 'M', 'D', 'S', 'H', 'M', '\0' };
+    static constexpr std::uint32_t current_version = 1;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t ring_capacity;
+};
+
+// view of a ring whose records consist of an 8 byte header {length, tag}
+// followed by the payload padded to 8 bytes. Records don't wrap, the rest
+// of the ring is skipped with a padding record instead.
+class shm_ring
+{
+public:
+    static constexpr std::size_t record_header_size = 8;
+    static constexpr std::uint32_t padding_tag = ~std::uint32_t{};
+
+    shm_ring() = default;
+    shm_ring(shm_ring_control *control, char *data, std::size_t capacity)
+        : mControl(control)
+        , mData(data)
+        , mMask(capacity - 1)
+    {
+    }
+
+    static std::size_t record_size(std::size_t length)
+    {
+        return (record_header_size + length + 7) & ~std::size_t{ 7 };
+    }
+    std::size_t max_payload_size() const
+    {
+        return (mMask + 1) / 2 - record_header_size;
+    }
+
+    // producer side
+    bool try_push(std::uint32_t tag, std::string_view payload)
+    {
+        const auto size = record_size(payload.size());
+        auto head = mControl->head.load(std::memory_order_relaxed);
+        const auto offset = head & mMask;
+        const auto padding = offset + size > mMask + 1 ? mMask + 1 - offset : 0;
+        if (head + padding + size - mControl->tail.load(std::memory_order_acquire) > mMask + 1)
+        {
+            return false;
+        }
+        if (padding != 0)
+        {
+            write_header(offset, static_cast<std::uint32_t>(padding), padding_tag);
+            head += padding;
+        }
+        write_header(head & mMask, static_cast<std::uint32_t>(payload.size()), tag);
+        std::memcpy(mData + (head & mMask) + record_header_size, payload.data(), payload.size());
+        mControl->head.store(head + size, std::memory_order_release);
+        mControl->readable.notify();
+        return true;
+    }
+    bool push(std::uint32_t tag, std::string_view payload,
+              std::chrono::steady_clock::time_point deadline)
+    {
+        if (payload.size() > max_payload_size())
+        {
+            return false;
+        }
+        return mControl->writable.wait([&]() { return try_push(tag, payload); }, deadline);
+    }
+
+    // consumer side, invokes f(tag, payload) for up to maxBatch records
+    // until f returns false. The payloads are valid until consume()
+    // returns. If f throws, the record it threw for is consumed. Throws a
+    // shm_channel_error for malformed records.
+    template< typename F >
+    std::size_t consume(F &&f, std::size_t maxBatch)
+    {
+        auto tail = mControl->tail.load(std::memory_order_relaxed);
+        const auto head = mControl->head.load(std::memory_order_acquire);
+        std::size_t count = 0;
+        try
+        {
+            bool proceed = true;
+            while (proceed && count < maxBatch && tail != head)
+            {
+                std::uint32_t header[2];
+                std::memcpy(header, mData + (tail & mMask), sizeof(header));
+                // the other process isn't trusted to write sane records
+                const auto size = header[1] == padding_tag ? header[0] : record_size(header[0]);
+                if (header[0] > max_payload_size() + record_header_size
+                    || (tail & mMask) + size > mMask + 1 || size > head - tail
+                    || (header[1] == padding_tag && (tail & mMask) + size != mMask + 1))
+                {
+                    BOOST_THROW_EXCEPTION(
+                        shm_channel_error{}
+                    );
+                }
+                if (header[1] == padding_tag)
+                {
+                    tail += size;
+                    continue;
+                }
+                std::string_view payload{ mData + (tail & mMask) + record_header_size, header[0] };
+                tail += size;
+                ++count;
+                proceed = f(header[1], payload);
+            }
+        }
+        catch (...)
+        {
+            release(tail);
+            throw;
+        }
+        release(tail);
+        return count;
+    }
+    bool wait_readable(std::chrono::steady_clock::time_point deadline)
+    {
+        return mControl->readable.wait([this]() { return !empty(); }, deadline);
+    }
+    bool empty() const
+    {
+        return mControl->head.load(std::memory_order_acquire)
+            == mControl->tail.load(std::memory_order_relaxed);
+    }
+
+private:
+    void write_header(std::size_t offset, std::uint32_t length, std::uint32_t tag)
+    {
+        const std::uint32_t header[2] = { length, tag };
+        std::memcpy(mData + offset, header, sizeof(header));
+    }
+    void release(std::uint64_t tail)
+    {
+        if (tail != mControl->tail.load(std::memory_order_relaxed))
+        {
+            mControl->tail.store(tail, std::memory_order_release);
+            mControl->writable.notify();
+        }
+    }
+
+    shm_ring_control *mControl = nullptr;
+    char *mData = nullptr;
+    std::size_t mMask = 0;
+};
+
+// the mapped shared memory object: header, request ring control, response
+// ring control, request ring, response ring
+class shm_channel
+{
+public:
+    static constexpr std::size_t control_offset = 64;
+
+    static std::size_t round_capacity(std::size_t capacity)
+    {
+        std::size_t size = 64;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        return size;
+    }
+    static std::size_t mapping_size(std::size_t ringCapacity)
+    {
+        return control_offset + 2 * sizeof(shm_ring_control) + 2 * ringCapacity;
+    }
+
+    void map(boost::interprocess::shared_memory_object &object)
+    {
+        namespace bip = boost::interprocess;
+        mRegion = bip::mapped_region{ object, bip::read_write };
+        mHeader = static_cast<shm_channel_header *>(mRegion.get_address());
+    }
+    void attach()
+    {
+        const auto base = static_cast<char *>(mRegion.get_address());
+        const auto capacity = static_cast<std::size_t>(mHeader->ring_capacity);
+        const auto controls = reinterpret_cast<shm_ring_control *>(base + control_offset);
+        const auto data = reinterpret_cast<char *>(controls + 2);
+        mRequests = shm_ring{ controls, data, capacity };
+        mResponses = shm_ring{ controls + 1, data + capacity, capacity };
+    }
+
+    boost::interprocess::mapped_region mRegion;
+    shm_channel_header *mHeader = nullptr;
+    shm_ring mRequests;
+    shm_ring mResponses;
+};
+
+
+}
+
+namespace ucmdp
+{
+
+
+enum class shm_response_status : std::uint32_t
+{
+    // the payload holds the serialized result of the action
+    ok,
+    // the payload holds the diagnostic information of the exception
+    failed,
+    // the command has been shed by a rate limit, see command_tree::limit
+    rate_limited,
+    // the result didn't fit into a response
+    response_too_large,
+};
+
+// creates and owns a shared memory object through which one local client
+// process sends commands. They are dispatched in batches by serve() and
+// answered in order through a second ring. Either side only issues a futex
+// wakeup if the other side sleeps.
+class shm_command_server
+{
+public:
+    // replaces a stale shared memory object of the same name. ringCapacity
+    // is rounded up to a power of two bytes per direction.
+    explicit shm_command_server(std::string name, std::size_t ringCapacity = 1 << 20);
+    ~shm_command_server();
+    shm_command_server(const shm_command_server &) = delete;
+    shm_command_server & operator=(const shm_command_server &) = delete;
+
+    // waits up to timeout for requests and dispatches up to maxBatch of
+    // them through tree. The batch ends early if the response ring is full,
+    // the pending response is sent by the next call which waits up to
+    // timeout for space first. Returns the number of dispatched commands.
+    // Throws a shm_channel_error if the client wrote malformed records.
+    std::size_t serve(const command_tree &tree, std::chrono::nanoseconds timeout,
+                      std::size_t maxBatch = std::numeric_limits<std::size_t>::max());
+
+    const std::string & name() const
+    {
+        return mName;
+    }
+
+private:
+    // the response is stored in mResult and sent if there is space
+    void dispatch(const command_tree &tree, std::string_view cmd);
+    bool try_respond();
+
+    const std::string mName;
+    detail::shm_channel mChannel;
+    std::vector<char> mResult;
+    std::size_t mResultSize = 0;
+    shm_response_status mStatus = shm_response_status::ok;
+    bool mPending = false;
+};
+
+// the client side of a shm_command_server. Requests are pipelined, i.e. a
+// client must receive responses while it sends commands, otherwise both
+// rings fill up and send() times out.
+class shm_command_client
+{
+public:
+    // throws a shm_channel_error if there is no compatible server channel
+    explicit shm_command_client(const std::string &name);
+
+    // queues cmd, waiting up to timeout for space. Fails for commands
+    // larger than half of the ring capacity.
+    bool send(std::string_view cmd,
+              std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+
+    // waits up to timeout for responses and invokes
+    // f(shm_response_status, std::string_view) for up to maxBatch of them.
+    // The payloads are valid until receive() returns.
+    template< typename F >
+    std::size_t receive(F &&f, std::chrono::nanoseconds timeout,
+                        std::size_t maxBatch = std::numeric_limits<std::size_t>::max());
+
+private:
+    detail::shm_channel mChannel;
+};
+
+
+namespace detail
+{
+    inline std::chrono::steady_clock::time_point shm_deadline(std::chrono::nanoseconds timeout)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        return timeout >= std::chrono::steady_clock::time_point::max() - now
+            ? std::chrono::steady_clock::time_point::max()
+            : now + timeout;
+    }
+}
+
+inline shm_command_server::shm_command_server(std::string name, std::size_t ringCapacity)
+    : mName(std::move(name))
+{
+    namespace bip = boost::interprocess;
+
+    const auto capacity = detail::shm_channel::round_capacity(ringCapacity);
+    bip::shared_memory_object::remove(mName.c_str());
+    bip::shared_memory_object object{ bip::create_only, mName.c_str(), bip::read_write };
+    object.truncate(static_cast<bip::offset_t>(detail::shm_channel::mapping_size(capacity)));
+    mChannel.map(object);
+
+    // the client checks the magic last
+    auto &header = *mChannel.mHeader;
+    header.version = detail::shm_channel_header::current_version;
+    header.header_size = sizeof(detail::shm_channel_header);
+    header.ring_capacity = capacity;
+    const auto base = static_cast<char *>(mChannel.mRegion.get_address());
+    const auto controls = base + detail::shm_channel::control_offset;
+    new (controls) detail::shm_ring_control;
+    new (controls + sizeof(detail::shm_ring_control)) detail::shm_ring_control;
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header.magic, detail::shm_channel_header::magic_value, sizeof(header.magic));
+
+    mChannel.attach();
+    mResult.resize(mChannel.mResponses.max_payload_size());
+}
+
+inline shm_command_server::~shm_command_server()
+{
+    boost::interprocess::shared_memory_object::remove(mName.c_str());
+}
+
+inline bool shm_command_server::try_respond()
+{
+    mPending = !mChannel.mResponses.try_push(static_cast<std::uint32_t>(mStatus),
+                                             { mResult.data(), mResultSize });
+    return !mPending;
+}
+
+inline void shm_command_server::dispatch(const command_tree &tree, std::string_view cmd)
+{
+    const auto first = mResult.data();
+    const auto last = first + mResult.size();
+    mResultSize = 0;
+    try
+    {
+        auto prepared = tree.prepare(cmd);
+        detail::response_buffer response{ first, last };
+        if (tree.execute_into(prepared, &response) == dispatch_status::rate_limited)
+        {
+            mStatus = shm_response_status::rate_limited;
+        }
+        else if (response.result.ec != std::errc{})
+        {
+            mStatus = shm_response_status::response_too_large;
+        }
+        else
+        {
+            mStatus = shm_response_status::ok;
+            mResultSize = static_cast<std::size_t>(response.result.ptr - first);
+        }
+    }
+    catch (...)
+    {
+        // truncated to the maximum response size
+        const auto diagnostic = boost::current_exception_diagnostic_information(false);
+        mStatus = shm_response_status::failed;
+        mResultSize = std::min(diagnostic.size(), mResult.size());
+        std::memcpy(first, diagnostic.data(), mResultSize);
+    }
+}
+
+inline std::size_t shm_command_server::serve(const command_tree &tree,
+                                             std::chrono::nanoseconds timeout,
+                                             std::size_t maxBatch)
+{
+    const auto deadline = detail::shm_deadline(timeout);
+    if (mPending && !mChannel.mResponses.push(static_cast<std::uint32_t>(mStatus),
+                                              { mResult.data(), mResultSize }, deadline))
+    {
+        return 0;
+    }
+    mPending = false;
+    if (!mChannel.mRequests.wait_readable(deadline))
+    {
+        return 0;
+    }
+    return mChannel.mRequests.consume([&](std::uint32_t, std::string_view cmd)
+    {
+        dispatch(tree, cmd);
+        return try_respond();
+    }, maxBatch);
+}
+
+inline shm_command_client::shm_command_client(const std::string &name)
+{
+    namespace bip = boost::interprocess;
+
+    const auto fail = [&name]()
+    {
+        BOOST_THROW_EXCEPTION(
+            shm_channel_error{}
+                << boost::errinfo_file_name(name)
+        );
+    };
+    try
+    {
+        bip::shared_memory_object object{ bip::open_only, name.c_str(), bip::read_write };
+        bip::offset_t size = 0;
+        if (!object.get_size(size) || size < static_cast<bip::offset_t>(detail::shm_channel::control_offset))
+        {
+            fail();
+        }
+        mChannel.map(object);
+        const auto &header = *mChannel.mHeader;
+        if (std::memcmp(header.magic, detail::shm_channel_header::magic_value, sizeof(header.magic)) != 0)
+        {
+            fail();
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header.version != detail::shm_channel_header::current_version
+            || header.header_size != sizeof(detail::shm_channel_header)
+            || header.ring_capacity != detail::shm_channel::round_capacity(header.ring_capacity)
+            || static_cast<std::uint64_t>(size) != detail::shm_channel::mapping_size(header.ring_capacity))
+        {
+            fail();
+        }
+    }
+    catch (bip::interprocess_exception &)
+    {
+        fail();
+    }
+    mChannel.attach();
+}
+
+inline bool shm_command_client::send(std::string_view cmd, std::chrono::nanoseconds timeout)
+{
+    return mChannel.mRequests.push(0, cmd, detail::shm_deadline(timeout));
+}
+
+template< typename F >
+inline std::size_t shm_command_client::receive(F &&f, std::chrono::nanoseconds timeout,
+                                               std::size_t maxBatch)
+{
+    if (!mChannel.mResponses.wait_readable(detail::shm_deadline(timeout)))
+    {
+        return 0;
+    }
+    return mChannel.mResponses.consume([&f](std::uint32_t status, std::string_view payload)
+    {
+        f(static_cast<shm_response_status>(status), payload);
+        return true;
+    }, maxBatch);
+}
+
+
+}
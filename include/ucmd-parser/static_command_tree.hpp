@@ -0,0 +1,455 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+// a freestanding command tree for targets without a heap or exceptions. It
+// neither includes Boost nor allocates; nodes live in a fixed size array and
+// errors are reported as static_errc. The token syntax is the one of the
+// hosted command_tree with the default tokenizer_options, apart from the
+// utf8 validation which isn't performed.
+
+#include <tuple>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <charconv>
+#include <string_view>
+#include <type_traits>
+
+namespace ucmdp
+{
+
+
+enum class static_errc : std::uint8_t
+{
+    ok = 0,
+    command_not_found,
+    not_enough_arguments,
+    too_many_arguments,
+    invalid_argument,
+    argument_out_of_range,
+    invalid_escape_sequence,
+    // an unescaped token didn't fit into the scratch buffer
+    scratch_exhausted,
+    // all nodes are in use
+    tree_full,
+    // the path is already bound to a command
+    command_exists,
+};
+
+struct static_dispatch_result
+{
+    static_errc error;
+    // the offset into the command at which the error has been detected
+    std::size_t offset;
+
+    explicit operator bool() const noexcept
+    {
+        return error == static_errc::ok;
+    }
+};
+
+
+}
+
+namespace ucmdp::detail
+{
+
+
+// splits a command into tokens. Tokens which contain escape sequences or
+// quotes are unescaped into a caller provided scratch area, all others are
+// views into the command
+class static_token_cursor
+{
+public:
+    static constexpr char separator_char = ' ';
+    static constexpr char quote_char = '"';
+    static constexpr char escape_char = '\\';
+
+    constexpr explicit static_token_cursor(std::string_view sequence) noexcept
+        : mSequence(sequence)
+        , mPos(0)
+    {
+        skip_separators();
+    }
+
+    constexpr explicit operator bool() const noexcept
+    {
+        return mPos != mSequence.size();
+    }
+    constexpr std::size_t position() const noexcept
+    {
+        return mPos;
+    }
+
+    // scratch is advanced past the unescaped token if one has been written
+    constexpr static_errc next(std::string_view &token, char *&scratch, char *scratchEnd) noexcept
+    {
+        const auto begin = mPos;
+        auto end = begin;
+        bool plain = true;
+        for (bool inQuote = false; end != mSequence.size(); ++end)
+        {
+            const auto c = mSequence[end];
+            if (c == separator_char && !inQuote)
+            {
+                break;
+            }
+            if (c == quote_char)
+            {
+                inQuote = !inQuote;
+                plain = false;
+            }
+            else if (c == escape_char)
+            {
+                if (++end == mSequence.size())
+                {
+                    mPos = end;
+                    return static_errc::invalid_escape_sequence;
+                }
+                plain = false;
+            }
+        }
+
+        if (plain)
+        {
+            token = mSequence.substr(begin, end - begin);
+        }
+        else
+        {
+            char *out = scratch;
+            for (auto i = begin; i != end; ++i)
+            {
+                auto c = mSequence[i];
+                if (c == quote_char)
+                {
+                    continue;
+                }
+                if (c == escape_char)
+                {
+                    c = mSequence[++i];
+                    if (c == 'n')
+                    {
+                        c = '\n';
+                    }
+                    else if (c != escape_char && c != separator_char && c != quote_char)
+                    {
+                        mPos = i;
+                        return static_errc::invalid_escape_sequence;
+                    }
+                }
+                if (out == scratchEnd)
+                {
+                    mPos = begin;
+                    return static_errc::scratch_exhausted;
+                }
+                *out++ = c;
+            }
+            token = std::string_view{ scratch, static_cast<std::size_t>(out - scratch) };
+            scratch = out;
+        }
+        mPos = end;
+        skip_separators();
+        return static_errc::ok;
+    }
+
+private:
+    constexpr void skip_separators() noexcept
+    {
+        while (mPos != mSequence.size() && mSequence[mPos] == separator_char)
+        {
+            ++mPos;
+        }
+    }
+
+    std::string_view mSequence;
+    std::size_t mPos;
+};
+
+
+template< typename T >
+constexpr bool is_static_argument_v = std::is_arithmetic_v<T>
+    || std::is_same_v<T, std::string_view>;
+
+template< typename T >
+static_errc parse_static_argument(std::string_view token, T &value) noexcept
+{
+    static_assert(is_static_argument_v<T>,
+        "static commands accept arithmetic and std::string_view arguments only");
+
+    if constexpr (std::is_same_v<T, std::string_view>)
+    {
+        value = token;
+        return static_errc::ok;
+    }
+    else if constexpr (std::is_same_v<T, bool>)
+    {
+        if (token == "true" || token == "1")
+        {
+            value = true;
+        }
+        else if (token == "false" || token == "0")
+        {
+            value = false;
+        }
+        else
+        {
+            return static_errc::invalid_argument;
+        }
+        return static_errc::ok;
+    }
+    else
+    {
+        const auto last = token.data() + token.size();
+        auto [ptr, ec] = std::from_chars(token.data(), last, value);
+        if (ec == std::errc::result_out_of_range)
+        {
+            return static_errc::argument_out_of_range;
+        }
+        if (ec != std::errc{} || ptr != last)
+        {
+            return static_errc::invalid_argument;
+        }
+        return static_errc::ok;
+    }
+}
+
+
+}
+
+namespace ucmdp
+{
+
+
+// a type erased command, i.e. a handler function pointer with an opaque
+// context pointer and the thunk which knows how to parse its arguments
+struct static_delegate
+{
+    using thunk_type = static_errc (*)(const static_delegate &self,
+        detail::static_token_cursor &args, char *scratch, char *scratchEnd,
+        std::size_t &errorOffset) noexcept;
+
+    thunk_type thunk = nullptr;
+    void (*function)() = nullptr;
+    void *context = nullptr;
+
+    constexpr explicit operator bool() const noexcept
+    {
+        return thunk != nullptr;
+    }
+};
+
+namespace detail
+{
+    template< typename R, typename... Args, std::size_t... Is >
+    static_errc invoke_static_command(const static_delegate &self,
+        detail::static_token_cursor &args, char *scratch, char *scratchEnd,
+        std::size_t &errorOffset, std::index_sequence<Is...>) noexcept
+    {
+        std::tuple<Args...> values{};
+        static_errc ec = static_errc::ok;
+        // parses the arguments in order and stops at the first failure
+        const auto parse = [&](auto &value) noexcept
+        {
+            if (ec != static_errc::ok)
+            {
+                return;
+            }
+            errorOffset = args.position();
+            if (!args)
+            {
+                ec = static_errc::not_enough_arguments;
+                return;
+            }
+            std::string_view token;
+            ec = args.next(token, scratch, scratchEnd);
+            if (ec == static_errc::ok)
+            {
+                ec = parse_static_argument(token, value);
+            }
+            else
+            {
+                errorOffset = args.position();
+            }
+        };
+        (parse(std::get<Is>(values)), ...);
+        static_cast<void>(parse);
+        if (ec != static_errc::ok)
+        {
+            return ec;
+        }
+        if (args)
+        {
+            errorOffset = args.position();
+            return static_errc::too_many_arguments;
+        }
+
+        const auto fn = reinterpret_cast<R (*)(void *, Args...)>(self.function);
+        if constexpr (std::is_void_v<R>)
+        {
+            fn(self.context, std::get<Is>(values)...);
+            return static_errc::ok;
+        }
+        else
+        {
+            return fn(self.context, std::get<Is>(values)...);
+        }
+    }
+
+    template< typename R, typename... Args >
+    static_errc static_command_thunk(const static_delegate &self,
+        detail::static_token_cursor &args, char *scratch, char *scratchEnd,
+        std::size_t &errorOffset) noexcept
+    {
+        return invoke_static_command<R, Args...>(self, args, scratch, scratchEnd,
+            errorOffset, std::index_sequence_for<Args...>{});
+    }
+}
+
+// binds fn(context, args...) to a delegate. The handler may return void or
+// a static_errc which is passed on to the caller of the dispatch.
+template< typename R, typename... Args >
+constexpr static_delegate make_static_command(R (*fn)(void *, Args...), void *context = nullptr) noexcept
+{
+    static_assert(std::is_void_v<R> || std::is_same_v<R, static_errc>,
+        "static command handlers must return void or static_errc");
+    static_assert((detail::is_static_argument_v<Args> && ...),
+        "static commands accept arithmetic and std::string_view arguments by value only");
+
+    static_delegate delegate;
+    delegate.thunk = &detail::static_command_thunk<R, Args...>;
+    delegate.function = reinterpret_cast<void (*)()>(fn);
+    delegate.context = context;
+    return delegate;
+}
+
+
+// a command tree with room for MaxNodes nodes (including the root). Unescaped
+// tokens of a dispatch are stored in a ScratchSize byte stack buffer.
+template< std::size_t MaxNodes, std::size_t ScratchSize = 128 >
+class static_command_tree
+{
+    static_assert(MaxNodes > 0 && MaxNodes < std::numeric_limits<std::uint32_t>::max());
+
+public:
+    using node_index = std::conditional_t<(MaxNodes < std::numeric_limits<std::uint16_t>::max()),
+        std::uint16_t, std::uint32_t>;
+    static constexpr node_index npos = std::numeric_limits<node_index>::max();
+
+    static constexpr std::size_t max_size() noexcept
+    {
+        return MaxNodes;
+    }
+    constexpr std::size_t size() const noexcept
+    {
+        return mSize;
+    }
+
+    // the tree references the path tokens, i.e. the path must outlive the
+    // tree which is why string literals are recommended. Path tokens must
+    // not contain quotes or escape sequences.
+    static_errc insert(std::string_view path, static_delegate action) noexcept
+    {
+        detail::static_token_cursor tokens{ path };
+        node_index current = 0;
+        while (tokens)
+        {
+            std::string_view token;
+            char *noScratch = nullptr;
+            if (auto ec = tokens.next(token, noScratch, nullptr); ec != static_errc::ok)
+            {
+                return static_errc::invalid_escape_sequence;
+            }
+            if (token.data() < path.data() || token.data() >= path.data() + path.size())
+            {
+                // an empty quoted token
+                return static_errc::invalid_escape_sequence;
+            }
+
+            auto child = find_child(current, token);
+            if (child == npos)
+            {
+                if (mSize == MaxNodes)
+                {
+                    return static_errc::tree_full;
+                }
+                child = static_cast<node_index>(mSize++);
+                auto &created = mNodes[child];
+                created.name = token;
+                created.nextSibling = mNodes[current].firstChild;
+                mNodes[current].firstChild = child;
+            }
+            current = child;
+        }
+        if (mNodes[current].action)
+        {
+            return static_errc::command_exists;
+        }
+        mNodes[current].action = action;
+        return static_errc::ok;
+    }
+
+    static_dispatch_result operator()(std::string_view cmd) const noexcept
+    {
+        char scratch[ScratchSize];
+        char *const scratchEnd = scratch + ScratchSize;
+
+        detail::static_token_cursor tokens{ cmd };
+        node_index current = 0;
+        while (tokens)
+        {
+            const auto args = tokens;
+            std::string_view token;
+            char *out = scratch;
+            if (auto ec = tokens.next(token, out, scratchEnd); ec != static_errc::ok)
+            {
+                return { ec, tokens.position() };
+            }
+            const auto child = find_child(current, token);
+            if (child == npos)
+            {
+                tokens = args;
+                break;
+            }
+            current = child;
+        }
+
+        const auto &action = mNodes[current].action;
+        if (!action)
+        {
+            return { static_errc::command_not_found, tokens.position() };
+        }
+        std::size_t errorOffset = tokens.position();
+        const auto ec = action.thunk(action, tokens, scratch, scratchEnd, errorOffset);
+        return { ec, ec == static_errc::ok ? cmd.size() : errorOffset };
+    }
+
+private:
+    struct node
+    {
+        std::string_view name;
+        node_index firstChild = npos;
+        node_index nextSibling = npos;
+        static_delegate action;
+    };
+
+    node_index find_child(node_index parent, std::string_view name) const noexcept
+    {
+        auto child = mNodes[parent].firstChild;
+        while (child != npos && mNodes[child].name != name)
+        {
+            child = mNodes[child].nextSibling;
+        }
+        return child;
+    }
+
+    node mNodes[MaxNodes];
+    std::size_t mSize = 1;
+};
+
+
+}
@@ -0,0 +1,512 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <charconv>
+#include <optional>
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+
+#include "exceptions.hpp"
+#include "serializer.hpp"
+#include "detail/structural_index.hpp"
+
+namespace ucmdp::detail
+{
+
+
+inline bool is_json_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+[[noreturn]] inline void throw_malformed_structure(std::size_t offset)
+{
+    BOOST_THROW_EXCEPTION(
+        structured_literal_error{}
+            << input_offset_info{ offset }
+    );
+}
+
+// returns the position behind the closing quote of the string at pos
+inline std::size_t json_string_end(std::string_view text, std::size_t pos)
+{
+    for (auto i = pos + 1; i < text.size(); ++i)
+    {
+        if (text[i] == '\\')
+        {
+            ++i;
+        }
+        else if (text[i] == '"')
+        {
+            return i + 1;
+        }
+    }
+    throw_malformed_structure(pos);
+}
+
+// returns the position behind the value at pos
+inline std::size_t json_value_end(std::string_view text, std::size_t pos)
+{
+    const auto data = text.data();
+    switch (text[pos])
+    {
+    case '[':
+    case '{':
+        if (auto end = find_structure_end(data + pos, data + text.size()))
+        {
+            return static_cast<std::size_t>(end - data);
+        }
+        throw_malformed_structure(pos);
+    case '"':
+        return json_string_end(text, pos);
+    default:
+        break;
+    }
+    auto end = pos;
+    while (end != text.size() && text[end] != ',' && text[end] != ']'
+        && text[end] != '}' && !is_json_space(text[end]))
+    {
+        ++end;
+    }
+    if (end == pos)
+    {
+        throw_malformed_structure(pos);
+    }
+    return end;
+}
+
+inline void append_utf8(std::string &out, char32_t cp)
+{
+    if (cp < 0x80)
+    {
+        out.push_back(static_cast<char>(cp));
+    }
+    else if (cp < 0x800)
+    {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else if (cp < 0x10000)
+    {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// decodes the JSON escape sequences of the string contents raw
+inline void unescape_json(std::string_view raw, std::string &out)
+{
+    out.clear();
+    out.reserve(raw.size());
+    const auto hex = [raw](std::size_t pos)
+    {
+        std::uint32_t value = 0;
+        auto [ptr, ec] = std::from_chars(raw.data() + pos, raw.data() + std::min(pos + 4, raw.size()), value, 16);
+        if (ec != std::errc{} || ptr != raw.data() + pos + 4)
+        {
+            throw_malformed_structure(pos);
+        }
+        return static_cast<char32_t>(value);
+    };
+    for (std::size_t i = 0; i < raw.size(); ++i)
+    {
+        if (raw[i] != '\\')
+        {
+            out.push_back(raw[i]);
+            continue;
+        }
+        if (++i == raw.size())
+        {
+            throw_malformed_structure(i);
+        }
+        switch (raw[i])
+        {
+        case '"': case '\\': case '/':
+            out.push_back(raw[i]);
+            break;
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u':
+        {
+            auto cp = hex(i + 1);
+            i += 4;
+            if (cp >= 0xD800 && cp < 0xDC00)
+            {
+                // a high surrogate must be followed by a low one
+                if (i + 2 >= raw.size() || raw[i + 1] != '\\' || raw[i + 2] != 'u')
+                {
+                    throw_malformed_structure(i);
+                }
+                const auto low = hex(i + 3);
+                if (low < 0xDC00 || low >= 0xE000)
+                {
+                    throw_malformed_structure(i);
+                }
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                i += 6;
+            }
+            else if (cp >= 0xDC00 && cp < 0xE000)
+            {
+                throw_malformed_structure(i);
+            }
+            append_utf8(out, cp);
+            break;
+        }
+        default:
+            throw_malformed_structure(i);
+        }
+    }
+}
+
+// iterates over the members of an object or the elements of an array
+class structure_cursor
+{
+public:
+    // text must start with '[' or '{' and end with the matching bracket
+    explicit structure_cursor(std::string_view text)
+        : mText(text)
+        , mPos(1)
+        , mObject(text.front() == '{')
+        , mFirst(true)
+    {
+    }
+
+    // returns false once the closing bracket has been reached. key is left
+    // untouched for arrays and refers to the escaped key of objects.
+    bool next(std::string_view &key, std::string_view &value)
+    {
+        skip_space();
+        if (mText[mPos] == (mObject ? '}' : ']'))
+        {
+            if (mPos + 1 != mText.size())
+            {
+                throw_malformed_structure(mPos);
+            }
+            return false;
+        }
+        if (!mFirst)
+        {
+            expect(',');
+            skip_space();
+        }
+        mFirst = false;
+        if (mObject)
+        {
+            if (mText[mPos] != '"')
+            {
+                throw_malformed_structure(mPos);
+            }
+            const auto keyEnd = json_string_end(mText, mPos);
+            key = mText.substr(mPos + 1, keyEnd - mPos - 2);
+            mPos = keyEnd;
+            skip_space();
+            expect(':');
+            skip_space();
+        }
+        const auto valueEnd = json_value_end(mText, mPos);
+        value = mText.substr(mPos, valueEnd - mPos);
+        mPos = valueEnd;
+        return true;
+    }
+
+private:
+    void skip_space()
+    {
+        while (mPos != mText.size() && is_json_space(mText[mPos]))
+        {
+            ++mPos;
+        }
+        if (mPos == mText.size())
+        {
+            throw_malformed_structure(mPos);
+        }
+    }
+    void expect(char c)
+    {
+        if (mText[mPos] != c)
+        {
+            throw_malformed_structure(mPos);
+        }
+        ++mPos;
+    }
+
+    std::string_view mText;
+    std::size_t mPos;
+    bool mObject;
+    bool mFirst;
+};
+
+
+}
+
+namespace ucmdp
+{
+
+
+// a lazily navigated JSON like value, e.g. a structured literal argument.
+// Nothing is parsed upfront, every access only scans the level it navigates
+// and skips nested structures through the structural index. Member keys
+// are compared in their escaped form. The view refers to the command
+// string, i.e. like std::string_view arguments it must not outlive the call.
+class structured_view
+{
+public:
+    enum class kind
+    {
+        object,
+        array,
+        string,
+        // numbers, true, false and null
+        literal,
+    };
+
+    structured_view() = default;
+    explicit structured_view(std::string_view text)
+        : mText(text)
+    {
+    }
+
+    std::string_view text() const
+    {
+        return mText;
+    }
+    kind type() const
+    {
+        if (mText.empty())
+        {
+            return kind::literal;
+        }
+        switch (mText.front())
+        {
+        case '{':
+            return kind::object;
+        case '[':
+            return kind::array;
+        case '"':
+            return kind::string;
+        default:
+            return kind::literal;
+        }
+    }
+
+    // the number of members or elements, 0 for strings and literals
+    std::size_t size() const
+    {
+        std::size_t count = 0;
+        for_each_entry([&count](std::string_view, std::string_view)
+        {
+            ++count;
+            return true;
+        });
+        return count;
+    }
+
+    // returns the first member named key or nullopt, e.g. if this isn't
+    // an object
+    std::optional<structured_view> find(std::string_view key) const
+    {
+        std::optional<structured_view> result;
+        if (type() == kind::object)
+        {
+            for_each_entry([&](std::string_view name, std::string_view value)
+            {
+                if (name == key)
+                {
+                    result.emplace(value);
+                }
+                return !result;
+            });
+        }
+        return result;
+    }
+    // throws a structured_member_not_found_error if there is no such member
+    structured_view operator[](std::string_view key) const
+    {
+        auto member = find(key);
+        if (!member)
+        {
+            BOOST_THROW_EXCEPTION(
+                structured_member_not_found_error{}
+                    << last_token_info{ std::string{ key } }
+            );
+        }
+        return *member;
+    }
+    // the element of an array or the value of the member of an object at
+    // index. Throws a structured_member_not_found_error if there is none.
+    structured_view operator[](std::size_t index) const
+    {
+        std::optional<structured_view> result;
+        for_each_entry([&](std::string_view, std::string_view value)
+        {
+            if (index-- == 0)
+            {
+                result.emplace(value);
+            }
+            return !result;
+        });
+        if (!result)
+        {
+            BOOST_THROW_EXCEPTION(
+                structured_member_not_found_error{}
+            );
+        }
+        return *result;
+    }
+
+    // calls f(element) for the elements of an array and f(key, value) for
+    // the members of an object
+    template< typename F >
+    void for_each(F &&f) const
+    {
+        const bool object = type() == kind::object;
+        for_each_entry([&](std::string_view key, std::string_view value)
+        {
+            if (object)
+            {
+                if constexpr (std::is_invocable_v<F &, std::string_view, structured_view>)
+                {
+                    f(key, structured_view{ value });
+                }
+            }
+            else
+            {
+                if constexpr (std::is_invocable_v<F &, structured_view>)
+                {
+                    f(structured_view{ value });
+                }
+            }
+            return true;
+        });
+    }
+
+    // strings are unescaped into a std::string and yield their escaped
+    // contents as std::string_view, "null" yields an empty optional. All
+    // other values are deserialized from their text with the
+    // serialization_traits of T.
+    template< typename T >
+    T as() const
+    {
+        if constexpr (std::is_same_v<T, structured_view>)
+        {
+            return *this;
+        }
+        else if constexpr (is_optional_v<T>)
+        {
+            if (mText == "null")
+            {
+                return T{};
+            }
+            return as<typename T::value_type>();
+        }
+        else if constexpr (std::is_same_v<T, std::string_view>)
+        {
+            return type() == kind::string ? string_contents() : mText;
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            std::string out;
+            if (type() == kind::string)
+            {
+                detail::unescape_json(string_contents(), out);
+            }
+            else
+            {
+                out = mText;
+            }
+            return out;
+        }
+        else if constexpr (std::is_same_v<T, bool>)
+        {
+            if (mText != "true" && mText != "false")
+            {
+                detail::throw_malformed_structure(0);
+            }
+            return mText == "true";
+        }
+        else
+        {
+            T out{};
+            serialization_traits<T>{}.deserialize(mText, out);
+            return out;
+        }
+    }
+
+private:
+    std::string_view string_contents() const
+    {
+        if (mText.size() < 2 || mText.back() != '"')
+        {
+            detail::throw_malformed_structure(0);
+        }
+        return mText.substr(1, mText.size() - 2);
+    }
+
+    // calls f(key, value) until it returns false
+    template< typename F >
+    void for_each_entry(F &&f) const
+    {
+        const auto t = type();
+        if (t != kind::object && t != kind::array)
+        {
+            return;
+        }
+        detail::structure_cursor cursor{ mText };
+        std::string_view key;
+        std::string_view value;
+        while (cursor.next(key, value) && f(key, value))
+        {
+        }
+    }
+
+    std::string_view mText;
+};
+
+// structured literals are only tokenized as such if the tokenizer_options
+// of the command tree enable structured_literals
+template< >
+struct serialization_traits< structured_view >
+{
+    void deserialize(std::string_view in, structured_view &out)
+    {
+        // the brackets are balanced if the tokenizer has recognized the
+        // literal, its contents are validated as far as they are accessed
+        if (in.empty() || (in.front() != '{' && in.front() != '[')
+            || in.back() != (in.front() == '{' ? '}' : ']'))
+        {
+            detail::throw_malformed_structure(0);
+        }
+        out = structured_view{ in };
+    }
+    std::to_chars_result serialize(char *first, char *last, const structured_view &in) const
+    {
+        const auto text = in.text();
+        if (static_cast<std::size_t>(last - first) < text.size())
+        {
+            return { last, std::errc::value_too_large };
+        }
+        return { std::copy(text.begin(), text.end(), first), std::errc{} };
+    }
+};
+
+
+}
@@ -0,0 +1,287 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <charconv>
+#include <algorithm>
+
+#include <boost/config.hpp>
+
+// The dispatch phases are traced if UCMDP_ENABLE_TRACING is defined. It must
+// be defined consistently for all translation units, including the core
+// library. Otherwise the hooks compile to nothing.
+#if defined(UCMDP_ENABLE_TRACING)
+#   define UCMDP_TRACE_SCOPE(name, id) \
+        const ::ucmdp::detail::trace_scope BOOST_JOIN(ucmdpTraceScope, __LINE__){ name, id }
+#else
+#   define UCMDP_TRACE_SCOPE(name, id) static_cast<void>(0)
+#endif
+
+namespace ucmdp::detail
+{
+
+
+struct trace_event
+{
+    const char *name;
+    std::uint32_t id;
+    std::int64_t begin;
+    std::int64_t end;
+};
+
+// written by a single thread, read by the exporter. Events are never
+// overwritten, i.e. the exporter may read [0, size) while the owning
+// thread appends further events.
+class trace_buffer
+{
+public:
+    trace_buffer(std::size_t capacity, std::uint32_t threadId)
+        : mEvents(std::make_unique<trace_event[]>(capacity))
+        , mCapacity(capacity)
+        , mThreadId(threadId)
+    {
+    }
+
+    void append(const trace_event &event) noexcept
+    {
+        const auto size = mSize.load(std::memory_order_relaxed);
+        if (size == mCapacity)
+        {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        mEvents[size] = event;
+        mSize.store(size + 1, std::memory_order_release);
+    }
+
+    template< typename F >
+    void for_each(F &&f) const
+    {
+        const auto size = mSize.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            f(mEvents[i]);
+        }
+    }
+
+    void clear() noexcept
+    {
+        mSize.store(0, std::memory_order_relaxed);
+        mDropped.store(0, std::memory_order_relaxed);
+    }
+
+    std::uint32_t thread_id() const
+    {
+        return mThreadId;
+    }
+    std::uint64_t dropped() const
+    {
+        return mDropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    const std::unique_ptr<trace_event[]> mEvents;
+    const std::size_t mCapacity;
+    const std::uint32_t mThreadId;
+    std::atomic<std::size_t> mSize{ 0 };
+    std::atomic<std::uint64_t> mDropped{ 0 };
+};
+
+// constant initialized, i.e. checking it doesn't need an initialization
+// guard
+inline std::atomic<bool> & tracing_enabled() noexcept
+{
+    static std::atomic<bool> enabled{ false };
+    return enabled;
+}
+
+// owns the buffers of all threads which have traced anything. The buffers
+// outlive their threads, so their events can still be exported.
+class trace_registry
+{
+public:
+    static trace_registry & instance()
+    {
+        static trace_registry registry;
+        return registry;
+    }
+
+    std::atomic<std::size_t> buffer_capacity{ 1 << 16 };
+
+    trace_buffer & thread_buffer()
+    {
+        static thread_local trace_buffer *buffer = nullptr;
+        if (BOOST_UNLIKELY(!buffer))
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mBuffers.push_back(std::make_shared<trace_buffer>(
+                buffer_capacity.load(std::memory_order_relaxed),
+                static_cast<std::uint32_t>(mBuffers.size() + 1)));
+            buffer = mBuffers.back().get();
+        }
+        return *buffer;
+    }
+
+    std::vector<std::shared_ptr<trace_buffer>> buffers() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mBuffers;
+    }
+
+private:
+    mutable std::mutex mMutex;
+    std::vector<std::shared_ptr<trace_buffer>> mBuffers;
+};
+
+inline std::int64_t trace_clock() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// records a complete event for its lifetime if tracing has been enabled
+// when it was created. Otherwise it costs a relaxed load and two branches.
+// mBegin is 0 for disabled scopes.
+class trace_scope
+{
+public:
+    trace_scope(const char *name, std::uint32_t id) noexcept
+        : mName(name)
+        , mId(id)
+        , mBegin(0)
+    {
+        if (BOOST_UNLIKELY(tracing_enabled().load(std::memory_order_relaxed)))
+        {
+            mBegin = trace_clock();
+        }
+    }
+    ~trace_scope()
+    {
+        if (BOOST_UNLIKELY(mBegin != 0))
+        {
+            trace_registry::instance().thread_buffer()
+                .append({ mName, mId, mBegin, trace_clock() });
+        }
+    }
+    trace_scope(const trace_scope &) = delete;
+    trace_scope & operator=(const trace_scope &) = delete;
+
+private:
+    const char *mName;
+    std::uint32_t mId;
+    std::int64_t mBegin;
+};
+
+// appends ns as microseconds with three decimals
+inline void append_trace_time(std::string &out, std::int64_t ns)
+{
+    char buffer[24];
+    auto end = std::to_chars(buffer, buffer + sizeof(buffer), ns / 1000).ptr;
+    out.append(buffer, end);
+    const auto fraction = static_cast<int>(ns % 1000);
+    out.push_back('.');
+    out.push_back(static_cast<char>('0' + fraction / 100));
+    out.push_back(static_cast<char>('0' + fraction / 10 % 10));
+    out.push_back(static_cast<char>('0' + fraction % 10));
+}
+
+
+}
+
+namespace ucmdp
+{
+
+
+// starts recording the dispatch phases of all threads. Threads which
+// haven't traced before get buffers for eventsPerThread events, further
+// events are dropped.
+inline void start_tracing(std::size_t eventsPerThread = 1 << 16)
+{
+    auto &registry = detail::trace_registry::instance();
+    registry.buffer_capacity.store(std::max<std::size_t>(eventsPerThread, 1),
+                                   std::memory_order_relaxed);
+    detail::tracing_enabled().store(true, std::memory_order_relaxed);
+}
+
+inline void stop_tracing()
+{
+    detail::tracing_enabled().store(false, std::memory_order_relaxed);
+}
+
+// discards all recorded events. Must not run concurrently with traced
+// dispatches.
+inline void clear_trace()
+{
+    for (auto &buffer : detail::trace_registry::instance().buffers())
+    {
+        buffer->clear();
+    }
+}
+
+// the number of events which didn't fit into the per thread buffers
+inline std::uint64_t trace_events_dropped()
+{
+    std::uint64_t dropped = 0;
+    for (auto &buffer : detail::trace_registry::instance().buffers())
+    {
+        dropped += buffer->dropped();
+    }
+    return dropped;
+}
+
+// the recorded events in the Chrome trace event format which can be loaded
+// by chrome://tracing and Perfetto. Events are complete ("X") events, the
+// command id is attached as argument where it is known.
+inline std::string chrome_trace_json()
+{
+    std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    char number[16];
+    for (auto &buffer : detail::trace_registry::instance().buffers())
+    {
+        const auto tid = std::to_chars(number, number + sizeof(number), buffer->thread_id()).ptr;
+        const std::string threadId(number, tid);
+        buffer->for_each([&](const detail::trace_event &event)
+        {
+            json += first ? "\n{\"name\":\"" : ",\n{\"name\":\"";
+            first = false;
+            for (auto name = event.name; *name; ++name)
+            {
+                if (*name == '"' || *name == '\\')
+                {
+                    json.push_back('\\');
+                }
+                json.push_back(*name);
+            }
+            json += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+            json += threadId;
+            json += ",\"ts\":";
+            detail::append_trace_time(json, event.begin);
+            json += ",\"dur\":";
+            detail::append_trace_time(json, event.end - event.begin);
+            if (event.id != static_cast<std::uint32_t>(-1))
+            {
+                json += ",\"args\":{\"id\":";
+                json.append(number, std::to_chars(number, number + sizeof(number), event.id).ptr);
+                json.push_back('}');
+            }
+            json.push_back('}');
+        });
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+
+}
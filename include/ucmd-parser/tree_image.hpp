@@ -0,0 +1,477 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <utility>
+#include <stdexcept>
+#include <cerrno>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <string_view>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+
+#include "exceptions.hpp"
+#include "command_tree.hpp"
+#include "command_delegate.hpp"
+#include "detail/token_stream.hpp"
+#include "detail/command_path.hpp"
+#include "detail/dispatch_scope.hpp"
+
+namespace ucmdp
+{
+
+
+// position independent tree image layout (native byte order):
+//   header:   magic "UCMDIMG\0", u32 version, u32 byte order mark,
+//             u64 schema hash, u64 image size, u32 tokenizer flags,
+//             u32 node count, u32 command count, u32 string bytes
+//   nodes:    u32 key offset, u32 key size, u32 edge offset, u32 edge size,
+//             u32 first child, u32 child count, u32 command id, u32 reserved
+//   commands: u32 path offset, u32 path size
+//   strings
+// The root is the first node, the childs of a node are stored contiguously
+// and sorted by key. Offsets are relative to the string section.
+namespace detail
+{
+    constexpr char tree_image_magic[8] = { 'U', 'C', 'M', 'D', 'I', 'M', 'G', '\0' };
+    constexpr std::uint32_t tree_image_version = 1;
+    constexpr std::uint32_t tree_image_byte_order_mark = 0x01020304;
+
+    constexpr std::uint32_t tree_image_validate_utf8 = 1;
+    constexpr std::uint32_t tree_image_unicode_whitespace = 2;
+    constexpr std::uint32_t tree_image_structured_literals = 4;
+
+    struct tree_image_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order_mark;
+        std::uint64_t schema_hash;
+        std::uint64_t size;
+        std::uint32_t tokenizer_flags;
+        std::uint32_t node_count;
+        std::uint32_t command_count;
+        std::uint32_t string_size;
+    };
+    static_assert(sizeof(tree_image_header) == 48);
+
+    struct tree_image_string
+    {
+        std::uint32_t offset;
+        std::uint32_t size;
+    };
+
+    struct tree_image_node
+    {
+        tree_image_string key;
+        tree_image_string edge;
+        std::uint32_t first_child;
+        std::uint32_t child_count;
+        std::uint32_t command;
+        std::uint32_t reserved;
+    };
+    static_assert(sizeof(tree_image_node) == 32);
+
+    // FNV-1a over the length prefixed canonical command paths in id order
+    class schema_hasher
+    {
+    public:
+        void add(std::string_view path)
+        {
+            const std::uint64_t size = path.size();
+            for (std::size_t i = 0; i < sizeof(size); ++i)
+            {
+                add_byte(static_cast<unsigned char>(size >> (8 * i)));
+            }
+            for (char c : path)
+            {
+                add_byte(static_cast<unsigned char>(c));
+            }
+        }
+
+        std::uint64_t value() const
+        {
+            return mValue;
+        }
+
+    private:
+        void add_byte(unsigned char byte)
+        {
+            mValue = (mValue ^ byte) * 0x100000001b3;
+        }
+
+        std::uint64_t mValue = 0xcbf29ce484222325;
+    };
+}
+
+// a command tree whose layout has been loaded from an image written by
+// write_image() instead of being built from registration calls. The image
+// is mapped read only and used in place, i.e. processes loading the same
+// image share its pages. The actions are bound by command id afterwards.
+class frozen_command_tree
+{
+public:
+    using command_id = command_tree::command_id;
+    static constexpr command_id invalid_command_id = command_tree::invalid_command_id;
+    // the commands in insertion order, i.e. command i has id i
+    using registration_table = std::vector<command_tree::name_cmd_tuple>;
+
+    // writes the layout, command paths and tokenizer options of tree to
+    // path. Throws a mount_error if tree has mounted subtrees. The image is
+    // written to path + ".tmp" and then renamed over path, i.e. processes
+    // which have mapped the previous image keep their intact copy.
+    static void write_image(const command_tree &tree, const std::string &path);
+
+    // the schema hash of a tree created by inserting commands in order.
+    // Requires commands to be free of duplicate paths.
+    static std::uint64_t schema_hash(const registration_table &commands);
+
+    // maps the image at path and binds the actions of commands by position
+    // which must be the same registration table the image's tree has been
+    // created from. Throws a tree_image_error if the image is malformed, has
+    // been written by another version or for a different schema.
+    frozen_command_tree(const std::string &path, const registration_table &commands);
+    frozen_command_tree(const frozen_command_tree &) = delete;
+    frozen_command_tree & operator=(const frozen_command_tree &) = delete;
+
+    void operator()(std::string_view cmd) const;
+
+    // replaces the action of a command
+    void bind(command_id id, command_delegate action)
+    {
+        mActions.at(id) = std::move(action);
+    }
+
+    // resolves the command path of cmd without running the action and
+    // returns the command id and the offset of the arguments
+    std::pair<command_id, std::size_t> resolve(std::string_view cmd) const;
+
+    std::size_t size() const
+    {
+        return mActions.size();
+    }
+    std::string_view path(command_id id) const
+    {
+        if (id >= size())
+        {
+            BOOST_THROW_EXCEPTION(
+                std::out_of_range("invalid command id")
+            );
+        }
+        return string(mCommands[id]);
+    }
+    const tokenizer_options & options() const
+    {
+        return mTokenizerOptions;
+    }
+    std::uint64_t schema_hash() const
+    {
+        return mHeader->schema_hash;
+    }
+
+private:
+    std::string_view string(detail::tree_image_string str) const
+    {
+        return { mStrings + str.offset, str.size };
+    }
+
+    void validate(const std::string &path) const;
+    const detail::tree_image_node & resolve(detail::cmd_token_stream &params) const;
+
+    boost::interprocess::mapped_region mRegion;
+    const detail::tree_image_header *mHeader = nullptr;
+    const detail::tree_image_node *mNodes = nullptr;
+    const detail::tree_image_string *mCommands = nullptr;
+    const char *mStrings = nullptr;
+    tokenizer_options mTokenizerOptions;
+    std::vector<command_delegate> mActions;
+};
+
+inline void frozen_command_tree::write_image(const command_tree &tree, const std::string &path)
+{
+    std::string strings;
+    const auto addString = [&strings](std::string_view str)
+    {
+        detail::tree_image_string ref{
+            static_cast<std::uint32_t>(strings.size()),
+            static_cast<std::uint32_t>(str.size())
+        };
+        strings.append(str);
+        return ref;
+    };
+
+    // breadth first, i.e. the childs of each node end up next to each other
+    std::vector<const command_tree::node *> pending{ &tree.mCommandTreeRoot };
+    std::vector<std::string_view> keys{ std::string_view{} };
+    std::vector<detail::tree_image_node> nodes;
+    for (std::size_t i = 0; i < pending.size(); ++i)
+    {
+        const auto &current = *pending[i];
+        if (current.mMount)
+        {
+            BOOST_THROW_EXCEPTION(
+                mount_error{}
+                    << boost::errinfo_file_name(path)
+            );
+        }
+        detail::tree_image_node node{};
+        node.key = addString(keys[i]);
+        node.edge = addString(current.mEdge);
+        node.first_child = static_cast<std::uint32_t>(pending.size());
+        node.child_count = static_cast<std::uint32_t>(current.mChilds.size());
+        node.command = current.mCommand;
+        nodes.push_back(node);
+        for (auto &[key, child] : current.mChilds)
+        {
+            pending.push_back(&child);
+            keys.push_back(key);
+        }
+    }
+
+    detail::schema_hasher hasher;
+    std::vector<detail::tree_image_string> commands;
+    for (auto &entry : tree.mCommands)
+    {
+        hasher.add(entry.path);
+        commands.push_back(addString(entry.path));
+    }
+
+    detail::tree_image_header header{};
+    std::memcpy(header.magic, detail::tree_image_magic, sizeof(header.magic));
+    header.version = detail::tree_image_version;
+    header.byte_order_mark = detail::tree_image_byte_order_mark;
+    header.schema_hash = hasher.value();
+    header.tokenizer_flags
+        = (tree.mTokenizerOptions.validate_utf8 ? detail::tree_image_validate_utf8 : 0)
+        | (tree.mTokenizerOptions.unicode_whitespace ? detail::tree_image_unicode_whitespace : 0)
+        | (tree.mTokenizerOptions.structured_literals ? detail::tree_image_structured_literals : 0);
+    header.node_count = static_cast<std::uint32_t>(nodes.size());
+    header.command_count = static_cast<std::uint32_t>(commands.size());
+    header.string_size = static_cast<std::uint32_t>(strings.size());
+    header.size = sizeof(header)
+        + nodes.size() * sizeof(detail::tree_image_node)
+        + commands.size() * sizeof(detail::tree_image_string)
+        + strings.size();
+
+    // truncating a mapped image in place would fault its readers
+    const auto tmpPath = path + ".tmp";
+    const auto fail = [&tmpPath](const std::string &name, int error)
+    {
+        std::error_code ignored;
+        std::filesystem::remove(tmpPath, ignored);
+        BOOST_THROW_EXCEPTION(
+            tree_image_error{}
+                << boost::errinfo_file_name(name)
+                << boost::errinfo_errno(error)
+        );
+    };
+    {
+        std::unique_ptr<std::FILE, int(*)(std::FILE *)> file{ std::fopen(tmpPath.c_str(), "wb"), &std::fclose };
+        if (!file
+            || std::fwrite(&header, sizeof(header), 1, file.get()) != 1
+            || std::fwrite(nodes.data(), sizeof(detail::tree_image_node), nodes.size(), file.get()) != nodes.size()
+            || std::fwrite(commands.data(), sizeof(detail::tree_image_string), commands.size(), file.get()) != commands.size()
+            || std::fwrite(strings.data(), 1, strings.size(), file.get()) != strings.size()
+            || std::fflush(file.get()) != 0
+#if defined(_WIN32)
+            || _commit(_fileno(file.get())) != 0
+#else
+            || fsync(fileno(file.get())) != 0
+#endif
+            || std::fclose(file.release()) != 0)
+        {
+            fail(tmpPath, errno);
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec)
+    {
+        fail(path, ec.value());
+    }
+}
+
+inline std::uint64_t frozen_command_tree::schema_hash(const registration_table &commands)
+{
+    detail::schema_hasher hasher;
+    for (auto &command : commands)
+    {
+        hasher.add(command_tree::canonical_path(std::get<0>(command)));
+    }
+    return hasher.value();
+}
+
+inline frozen_command_tree::frozen_command_tree(const std::string &path,
+                                                const registration_table &commands)
+{
+    namespace bip = boost::interprocess;
+
+    if (std::filesystem::file_size(path) >= sizeof(detail::tree_image_header))
+    {
+        bip::file_mapping file{ path.c_str(), bip::read_only };
+        mRegion = bip::mapped_region{ file, bip::read_only };
+        mHeader = static_cast<const detail::tree_image_header *>(mRegion.get_address());
+    }
+    validate(path);
+
+    const auto base = static_cast<const char *>(mRegion.get_address());
+    mNodes = reinterpret_cast<const detail::tree_image_node *>(base + sizeof(*mHeader));
+    mCommands = reinterpret_cast<const detail::tree_image_string *>(mNodes + mHeader->node_count);
+    mStrings = reinterpret_cast<const char *>(mCommands + mHeader->command_count);
+    mTokenizerOptions.validate_utf8 = mHeader->tokenizer_flags & detail::tree_image_validate_utf8;
+    mTokenizerOptions.unicode_whitespace = mHeader->tokenizer_flags & detail::tree_image_unicode_whitespace;
+    mTokenizerOptions.structured_literals = mHeader->tokenizer_flags & detail::tree_image_structured_literals;
+
+    if (commands.size() != mHeader->command_count || schema_hash(commands) != mHeader->schema_hash)
+    {
+        BOOST_THROW_EXCEPTION(
+            tree_image_error{}
+                << boost::errinfo_file_name(path)
+        );
+    }
+    mActions.reserve(commands.size());
+    for (auto &command : commands)
+    {
+        mActions.push_back(std::get<1>(command));
+    }
+}
+
+inline void frozen_command_tree::validate(const std::string &path) const
+{
+    const auto fail = [&path]()
+    {
+        BOOST_THROW_EXCEPTION(
+            tree_image_error{}
+                << boost::errinfo_file_name(path)
+        );
+    };
+    if (!mHeader
+        || std::memcmp(mHeader->magic, detail::tree_image_magic, sizeof(mHeader->magic)) != 0
+        || mHeader->version != detail::tree_image_version
+        || mHeader->byte_order_mark != detail::tree_image_byte_order_mark
+        || mHeader->size != mRegion.get_size()
+        || mHeader->node_count == 0
+        || mHeader->size != sizeof(*mHeader)
+            + std::uint64_t{ mHeader->node_count } * sizeof(detail::tree_image_node)
+            + std::uint64_t{ mHeader->command_count } * sizeof(detail::tree_image_string)
+            + mHeader->string_size)
+    {
+        fail();
+    }
+
+    // the nodes are only read, but a corrupted image mustn't make the
+    // resolution read out of bounds or loop forever
+    const auto base = static_cast<const char *>(mRegion.get_address());
+    const auto nodes = reinterpret_cast<const detail::tree_image_node *>(base + sizeof(*mHeader));
+    const auto commands = reinterpret_cast<const detail::tree_image_string *>(nodes + mHeader->node_count);
+    const auto validString = [this](detail::tree_image_string str)
+    {
+        return str.offset <= mHeader->string_size && str.size <= mHeader->string_size - str.offset;
+    };
+    for (std::uint32_t i = 0; i < mHeader->node_count; ++i)
+    {
+        const auto &node = nodes[i];
+        if (!validString(node.key) || !validString(node.edge)
+            || (node.command != invalid_command_id && node.command >= mHeader->command_count)
+            || (node.child_count != 0 && node.first_child <= i)
+            || node.first_child > mHeader->node_count
+            || node.child_count > mHeader->node_count - node.first_child)
+        {
+            fail();
+        }
+    }
+    for (std::uint32_t i = 0; i < mHeader->command_count; ++i)
+    {
+        if (!validString(commands[i]))
+        {
+            fail();
+        }
+    }
+}
+
+inline auto frozen_command_tree::resolve(detail::cmd_token_stream &params) const
+    -> const detail::tree_image_node &
+{
+    struct layout
+    {
+        const frozen_command_tree &tree;
+
+        std::string_view edge(const detail::tree_image_node &node) const
+        {
+            return tree.string(node.edge);
+        }
+        const detail::tree_image_node * enter(const detail::tree_image_node *node) const
+        {
+            return node;
+        }
+        bool has_childs(const detail::tree_image_node &node) const
+        {
+            return node.child_count != 0;
+        }
+        const detail::tree_image_node * find_child(const detail::tree_image_node &node,
+                                                   std::string_view key) const
+        {
+            const auto first = tree.mNodes + node.first_child;
+            const auto last = first + node.child_count;
+            auto child = std::lower_bound(first, last, key,
+                [this](const detail::tree_image_node &candidate, std::string_view value)
+            {
+                return tree.string(candidate.key) < value;
+            });
+            return child != last && tree.string(child->key) == key ? child : nullptr;
+        }
+    };
+    return *detail::walk_path(mNodes, params, layout{ *this }, true);
+}
+
+inline auto frozen_command_tree::resolve(std::string_view cmd) const
+    -> std::pair<command_id, std::size_t>
+{
+    detail::cmd_token_stream params{ cmd, mTokenizerOptions };
+    const auto &target = resolve(params);
+    return { target.command, params.consumed().size() };
+}
+
+inline void frozen_command_tree::operator()(std::string_view cmd) const
+{
+    detail::cmd_token_stream params{ cmd, mTokenizerOptions };
+    const auto id = resolve(params).command;
+
+    detail::dispatch_state state{ mTokenizerOptions };
+    detail::dispatch_scope scope{ state };
+
+    try
+    {
+        detail::run_delegate(id != invalid_command_id ? &mActions[id] : nullptr,
+                             params.remaining(), mTokenizerOptions);
+    }
+    catch (boost::exception &exc)
+    {
+        command_tree::annotate(exc, params);
+        throw;
+    }
+}
+
+
+}
@@ -0,0 +1,372 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <array>
+#include <ratio>
+#include <chrono>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+#include <charconv>
+#include <algorithm>
+#include <type_traits>
+#include <string_view>
+#include <system_error>
+
+#include "exceptions.hpp"
+#include "serializer.hpp"
+#include "number_serializer.hpp"
+
+namespace ucmdp
+{
+
+
+// a byte count written with an optional binary magnitude suffix, i.e.
+// `64K`, `1.5G`, `2MiB` or `512B`. K, M, G, T, P and E denote powers of 1024
+// and may be followed by `i` and/or `B`. Fractional amounts are truncated.
+template< typename T = std::uint64_t >
+struct si_size
+{
+    static_assert(std::is_unsigned_v<T> && !std::is_same_v<T, bool>,
+        "si_size requires an unsigned integer type");
+
+    T value;
+};
+
+
+}
+
+namespace ucmdp::detail
+{
+
+
+// a decimal number as written, i.e. `integer.fraction` followed by suffix
+struct decimal_token
+{
+    std::uint64_t integer;
+    std::string_view fraction;
+    std::string_view suffix;
+};
+
+inline decimal_token split_decimal(std::string_view str)
+{
+    if (str.empty())
+    {
+        BOOST_THROW_EXCEPTION(
+            empty_argument_error{}
+        );
+    }
+    decimal_token token{ 0, {}, {} };
+    const auto last = str.data() + str.size();
+    auto pos = accumulate_digits(str.data(), last, 10, token.integer);
+    const bool hasInteger = pos != str.data();
+    if (pos != last && *pos == '.')
+    {
+        const auto fractionBegin = ++pos;
+        while (pos != last && *pos >= '0' && *pos <= '9')
+        {
+            ++pos;
+        }
+        token.fraction = std::string_view(fractionBegin, pos - fractionBegin);
+    }
+    if (!hasInteger && token.fraction.empty())
+    {
+        BOOST_THROW_EXCEPTION(
+            invalid_integer_error{}
+        );
+    }
+    token.suffix = std::string_view(pos, last - pos);
+    return token;
+}
+
+// returns floor(number * num / den) and checks for overflow after scaling.
+// Requires 10 * num to be representable.
+inline std::uint64_t scale_decimal(const decimal_token &number,
+                                   std::uint64_t num, std::uint64_t den)
+{
+    constexpr auto max = std::numeric_limits<std::uint64_t>::max();
+    if (number.integer != 0 && num > max / number.integer)
+    {
+        BOOST_THROW_EXCEPTION(
+            integer_overflow_serialization_error{}
+        );
+    }
+    auto scaled = number.integer * num;
+
+    // floor(0.d1...dn * num) computed digit by digit from the back. Taking
+    // the floor in every step is exact because num is an integer.
+    std::uint64_t fraction = 0;
+    for (auto it = number.fraction.rbegin(); it != number.fraction.rend(); ++it)
+    {
+        fraction = (static_cast<std::uint64_t>(*it - '0') * num + fraction) / 10;
+    }
+    if (scaled > max - fraction)
+    {
+        BOOST_THROW_EXCEPTION(
+            integer_overflow_serialization_error{}
+        );
+    }
+    return (scaled + fraction) / den;
+}
+
+template< typename T >
+inline T checked_narrow(std::uint64_t value)
+{
+    if (value > static_cast<std::uint64_t>(std::numeric_limits<T>::max()))
+    {
+        BOOST_THROW_EXCEPTION(
+            integer_overflow_serialization_error{}
+        );
+    }
+    return static_cast<T>(value);
+}
+
+constexpr std::string_view si_magnitudes = "KMGTPE";
+
+// returns the power of 1024 denoted by suffix
+inline unsigned parse_si_suffix(std::string_view suffix)
+{
+    unsigned magnitude = 0;
+    if (!suffix.empty() && suffix[0] != 'B')
+    {
+        const auto pos = si_magnitudes.find(suffix[0] == 'k' ? 'K' : suffix[0]);
+        if (pos == std::string_view::npos)
+        {
+            BOOST_THROW_EXCEPTION(
+                invalid_integer_error{}
+            );
+        }
+        magnitude = static_cast<unsigned>(pos) + 1;
+        suffix.remove_prefix(1);
+        if (!suffix.empty() && suffix[0] == 'i')
+        {
+            suffix.remove_prefix(1);
+        }
+    }
+    if (suffix == "B")
+    {
+        suffix.remove_prefix(1);
+    }
+    if (!suffix.empty())
+    {
+        BOOST_THROW_EXCEPTION(
+            invalid_integer_error{}
+        );
+    }
+    return magnitude;
+}
+
+
+// duration units by suffix; the empty suffix denotes the duration's own
+// period which is handled separately
+struct duration_unit
+{
+    std::string_view suffix;
+    std::intmax_t num;
+    std::intmax_t den;
+};
+
+constexpr std::array<duration_unit, 8> duration_units{ {
+    { "ns", 1, 1000000000 },
+    { "us", 1, 1000000 },
+    { "\xC2\xB5s", 1, 1000000 },
+    { "ms", 1, 1000 },
+    { "s", 1, 1 },
+    { "min", 60, 1 },
+    { "h", 3600, 1 },
+    { "d", 86400, 1 },
+} };
+
+constexpr std::intmax_t gcd(std::intmax_t a, std::intmax_t b)
+{
+    return b == 0 ? a : gcd(b, a % b);
+}
+
+// the factors converting a count of unit into a count of Period, reduced
+// at compile time
+template< typename Period >
+constexpr auto make_duration_scales()
+{
+    std::array<duration_unit, duration_units.size()> scales{};
+    for (std::size_t i = 0; i < duration_units.size(); ++i)
+    {
+        // unit / Period = (unit.num * Period::den) / (unit.den * Period::num)
+        const auto g1 = gcd(duration_units[i].num, Period::num);
+        const auto g2 = gcd(Period::den, duration_units[i].den);
+        scales[i] = {
+            duration_units[i].suffix,
+            (duration_units[i].num / g1) * (Period::den / g2),
+            (duration_units[i].den / g2) * (Period::num / g1)
+        };
+    }
+    return scales;
+}
+
+template< typename Period >
+constexpr std::string_view duration_suffix()
+{
+    for (auto &unit : duration_units)
+    {
+        if (unit.num == Period::num && unit.den == Period::den)
+        {
+            return unit.suffix;
+        }
+    }
+    return {};
+}
+
+
+}
+
+namespace ucmdp
+{
+
+
+template< typename T >
+struct serialization_traits< si_size<T> >
+{
+    void deserialize(std::string_view str, si_size<T> &out) const
+    {
+        const auto number = detail::split_decimal(str);
+        const auto magnitude = detail::parse_si_suffix(number.suffix);
+        if (magnitude == 0 && !number.fraction.empty())
+        {
+            BOOST_THROW_EXCEPTION(
+                invalid_integer_error{}
+            );
+        }
+        out.value = detail::checked_narrow<T>(
+            detail::scale_decimal(number, std::uint64_t{ 1 } << (10 * magnitude), 1));
+    }
+
+    // uses the largest magnitude which represents the value exactly
+    std::to_chars_result serialize(char *first, char *last, si_size<T> in) const
+    {
+        auto value = static_cast<std::uint64_t>(in.value);
+        std::size_t magnitude = 0;
+        while (value != 0 && magnitude < detail::si_magnitudes.size() && (value & 1023) == 0)
+        {
+            value >>= 10;
+            ++magnitude;
+        }
+        auto result = std::to_chars(first, last, value);
+        if (result.ec != std::errc{} || magnitude == 0)
+        {
+            return result;
+        }
+        if (result.ptr == last)
+        {
+            return { last, std::errc::value_too_large };
+        }
+        *result.ptr++ = detail::si_magnitudes[magnitude - 1];
+        return result;
+    }
+};
+
+// durations are written as a decimal count followed by one of the units
+// ns, us, µs, ms, s, min, h or d. A count without unit is taken in the
+// duration's own period. Integral counts are truncated.
+template< typename Rep, typename Period >
+struct serialization_traits< std::chrono::duration<Rep, Period> >
+{
+    using duration_type = std::chrono::duration<Rep, Period>;
+
+    void deserialize(std::string_view str, duration_type &out) const
+    {
+        static constexpr auto scales = detail::make_duration_scales<Period>();
+
+        const bool negative = !str.empty() && str[0] == '-';
+        if (negative && std::is_unsigned_v<Rep>)
+        {
+            BOOST_THROW_EXCEPTION(
+                invalid_integer_error{}
+            );
+        }
+        if (negative)
+        {
+            str.remove_prefix(1);
+        }
+
+        const auto number = detail::split_decimal(str);
+        std::intmax_t num = 1;
+        std::intmax_t den = 1;
+        if (!number.suffix.empty())
+        {
+            auto unit = std::find_if(scales.begin(), scales.end(),
+                [&number](const detail::duration_unit &scale)
+            {
+                return scale.suffix == number.suffix;
+            });
+            if (unit == scales.end())
+            {
+                BOOST_THROW_EXCEPTION(
+                    invalid_integer_error{}
+                );
+            }
+            num = unit->num;
+            den = unit->den;
+        }
+
+        if constexpr (std::is_floating_point_v<Rep>)
+        {
+            Rep count;
+            const auto numberEnd = number.suffix.data();
+            auto [ptr, ec] = std::from_chars(str.data(), numberEnd, count);
+            if (ec != std::errc{} || ptr != numberEnd)
+            {
+                BOOST_THROW_EXCEPTION(
+                    invalid_floating_point_error{}
+                );
+            }
+            count = count * static_cast<Rep>(num) / static_cast<Rep>(den);
+            out = duration_type{ negative ? -count : count };
+        }
+        else
+        {
+            const auto magnitude = detail::scale_decimal(number,
+                static_cast<std::uint64_t>(num), static_cast<std::uint64_t>(den));
+            using unsigned_rep = std::make_unsigned_t<Rep>;
+            const auto limit = static_cast<std::uint64_t>(std::numeric_limits<Rep>::max())
+                + (negative ? 1 : 0);
+            if (magnitude > limit)
+            {
+                if (negative)
+                {
+                    BOOST_THROW_EXCEPTION(
+                        integer_underflow_serialization_error{}
+                    );
+                }
+                BOOST_THROW_EXCEPTION(
+                    integer_overflow_serialization_error{}
+                );
+            }
+            const auto count = static_cast<unsigned_rep>(magnitude);
+            out = duration_type{ negative
+                ? static_cast<Rep>(static_cast<unsigned_rep>(0 - count))
+                : static_cast<Rep>(count) };
+        }
+    }
+
+    std::to_chars_result serialize(char *first, char *last, duration_type in) const
+    {
+        constexpr auto suffix = detail::duration_suffix<Period>();
+        auto result = std::to_chars(first, last, in.count());
+        if (result.ec != std::errc{})
+        {
+            return result;
+        }
+        if (static_cast<std::size_t>(last - result.ptr) < suffix.size())
+        {
+            return { last, std::errc::value_too_large };
+        }
+        result.ptr = std::copy(suffix.begin(), suffix.end(), result.ptr);
+        return result;
+    }
+};
+
+
+}
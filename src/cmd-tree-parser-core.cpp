@@ -0,0 +1,28 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#if !defined(UCMDP_SEPARATE_COMPILATION)
+#error "the core library must be compiled with UCMDP_SEPARATE_COMPILATION"
+#endif
+
+#include <ucmd-parser/detail/impl/token_stream.ipp>
+#include <ucmd-parser/detail/impl/command_path.ipp>
+#include <ucmd-parser/impl/command_tree.ipp>
+#include <ucmd-parser/number_serializer.hpp>
+
+namespace ucmdp::detail
+{
+
+
+template struct integer_serializer_base<long long, strtoll>;
+template struct integer_serializer_base<long, strtol>;
+template struct integer_serializer_base<unsigned long long, strtoull>;
+template struct integer_serializer_base<unsigned long, strtoul>;
+template struct floating_point_serializer_base<long double, &strtold>;
+template struct floating_point_serializer_base<double, &strtod>;
+template struct floating_point_serializer_base<float, &strtof>;
+
+
+}
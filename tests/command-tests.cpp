@@ -39,5 +39,64 @@ BOOST_AUTO_TEST_CASE(cmd_with_int_arg)
     BOOST_CHECK_NO_THROW(cmd.exec(serVal));
 }
 
+BOOST_AUTO_TEST_CASE(cmd_with_string_view_arg_refers_to_input)
+{
+    std::string_view input = "plain";
+    bool called = false;
+
+    command<void(std::string_view)> cmd([&](std::string_view arg)
+    {
+        called = true;
+        BOOST_TEST(arg == "plain");
+        BOOST_TEST(arg.data() == input.data());
+    });
+    cmd.exec(input);
+    BOOST_TEST(called);
+}
+
+BOOST_AUTO_TEST_CASE(cmd_with_escaped_string_view_arg)
+{
+    std::string_view input = "first \"quoted arg\" a\\\\b";
+    int calls = 0;
+
+    command<void(std::string_view, std::string_view, std::string_view)> cmd(
+        [&](std::string_view a, std::string_view b, std::string_view c)
+    {
+        ++calls;
+        BOOST_TEST(a == "first");
+        BOOST_TEST(a.data() == input.data());
+        BOOST_TEST(b == "quoted arg");
+        BOOST_TEST(c == "a\\b");
+        // unescaped tokens live in distinct per call buffers
+        BOOST_TEST((b.data() < input.data() || b.data() >= input.data() + input.size()));
+        BOOST_TEST((c.data() < input.data() || c.data() >= input.data() + input.size()));
+    });
+    cmd.exec(input);
+    BOOST_TEST(calls == 1);
+}
+
+BOOST_AUTO_TEST_CASE(cmd_with_optional_string_view_arg)
+{
+    std::optional<std::string_view> received;
+    bool called = false;
+
+    command<void(int, std::optional<std::string_view>)> cmd(
+        [&](int, std::optional<std::string_view> arg)
+    {
+        called = true;
+        received = arg;
+    });
+
+    cmd.exec("1");
+    BOOST_TEST(called);
+    BOOST_TEST(!received.has_value());
+
+    std::string_view input = "1 name";
+    cmd.exec(input);
+    BOOST_TEST(received.has_value());
+    BOOST_TEST(*received == "name");
+    BOOST_TEST(received->data() == input.data() + 2);
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
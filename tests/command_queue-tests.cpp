@@ -0,0 +1,173 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/command_queue.hpp>
+#include "boost-unit-test.hpp"
+
+#include <thread>
+
+using namespace ucmdp;
+
+namespace
+{
+    std::vector<std::string> drain(command_queue &queue, std::size_t maxBatch = ~std::size_t{})
+    {
+        std::vector<std::string> cmds;
+        queue.consume([&cmds](std::string_view cmd) { cmds.emplace_back(cmd); }, maxBatch);
+        return cmds;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(command_queue_tests)
+
+
+BOOST_AUTO_TEST_CASE(fifo_with_wrap_around)
+{
+    command_queue queue{ 256 };
+    BOOST_TEST(queue.capacity() == 256u);
+
+    std::vector<std::string> expected;
+    std::vector<std::string> received;
+    for (int i = 0; i < 500; ++i)
+    {
+        std::string cmd(static_cast<std::size_t>(i % 37), static_cast<char>('a' + i % 26));
+        while (!queue.try_push(cmd))
+        {
+            auto batch = drain(queue, 3);
+            BOOST_TEST_REQUIRE(!batch.empty());
+            received.insert(received.end(), batch.begin(), batch.end());
+        }
+        expected.push_back(cmd);
+    }
+    auto rest = drain(queue);
+    received.insert(received.end(), rest.begin(), rest.end());
+    BOOST_TEST(received == expected);
+    BOOST_TEST(drain(queue).empty());
+}
+
+BOOST_AUTO_TEST_CASE(overflow_policies)
+{
+    // 4 records of 16 bytes
+    command_queue dropping{ 64, overflow_policy::drop };
+    for (int i = 0; i < 4; ++i)
+    {
+        BOOST_TEST(dropping.push("0123456789"));
+    }
+    BOOST_TEST(!dropping.push("0123456789"));
+    BOOST_TEST(dropping.dropped() == 1u);
+    BOOST_TEST(!dropping.try_push("0123456789"));
+    BOOST_TEST(dropping.dropped() == 1u);
+
+    // never fits
+    command_queue blocking{ 64 };
+    BOOST_TEST(!blocking.push(std::string(40, 'x')));
+    BOOST_TEST(blocking.dropped() == 1u);
+
+    std::thread producer([&blocking]()
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            blocking.push(std::to_string(i));
+        }
+    });
+    std::vector<std::string> received;
+    while (received.size() < 100)
+    {
+        auto batch = drain(blocking);
+        received.insert(received.end(), batch.begin(), batch.end());
+        std::this_thread::yield();
+    }
+    producer.join();
+    BOOST_TEST(received.back() == "99");
+    BOOST_TEST(blocking.dropped() == 1u);
+}
+
+BOOST_AUTO_TEST_CASE(multiple_producers)
+{
+    constexpr int producers = 4;
+    constexpr int perProducer = 5000;
+    command_queue queue{ 1024 };
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&queue, p]()
+        {
+            for (int i = 0; i < perProducer; ++i)
+            {
+                queue.push("push " + std::to_string(p) + " " + std::to_string(i));
+            }
+        });
+    }
+
+    std::vector<int> next(producers, 0);
+    int total = 0;
+    command_tree tree {
+        { "push", make_command([&](int p, int i)
+        {
+            BOOST_CHECK_EQUAL(next[p], i);
+            next[p] = i + 1;
+            ++total;
+        }) }
+    };
+    while (total < producers * perProducer)
+    {
+        if (dispatch_queued(queue, tree, 64) == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    BOOST_TEST(next == std::vector<int>(producers, perProducer));
+    BOOST_TEST(queue.dropped() == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(failing_command_is_consumed)
+{
+    command_queue queue{ 128 };
+    std::vector<int> values;
+    command_tree tree {
+        { "push", make_command([&values](int v) { values.push_back(v); }) }
+    };
+    queue.push("push 1");
+    queue.push("push x");
+    queue.push("push 3");
+
+    BOOST_CHECK_THROW(dispatch_queued(queue, tree), invalid_integer_error);
+    BOOST_TEST(values == std::vector<int>{ 1 });
+    BOOST_TEST(dispatch_queued(queue, tree) == 1u);
+    BOOST_TEST(values == (std::vector<int>{ 1, 3 }));
+}
+
+BOOST_AUTO_TEST_CASE(coalesces_within_a_batch)
+{
+    command_queue queue{ 256 };
+    std::vector<std::string> calls;
+    command_tree tree {
+        { "set", make_command([&calls](std::string key, int v) { calls.push_back(key + "=" + std::to_string(v)); }) },
+        { "log", make_command([&calls](int v) { calls.push_back("log " + std::to_string(v)); }) }
+    };
+    tree.coalesce("set", coalesce_by_argument(0));
+    for (auto cmd : { "set a 1", "log 1", "set a 2", "set b 1", "log x", "set b 2", "set a 3" })
+    {
+        queue.push(cmd);
+    }
+
+    // the failing command is consumed, the ones after it stay queued. The
+    // superseded commands before it are skipped nonetheless.
+    BOOST_CHECK_THROW(dispatch_queued(queue, tree), invalid_integer_error);
+    BOOST_TEST(calls == (std::vector<std::string>{ "log 1" }));
+    BOOST_TEST(dispatch_queued(queue, tree) == 2u);
+    BOOST_TEST(calls == (std::vector<std::string>{ "log 1", "b=2", "a=3" }));
+    BOOST_TEST(tree.coalesce_stats("set")->executed == 2u);
+    BOOST_TEST(tree.coalesce_stats("set")->coalesced == 3u);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,8 +4,13 @@
 // See LICENSE file in the project root for full license information.
 //
 #include <ucmd-parser/command_tree.hpp>
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/container_serializer.hpp>
 #include "boost-unit-test.hpp"
 
+#include <atomic>
+#include <thread>
+
 using namespace ucmdp;
 
 BOOST_AUTO_TEST_SUITE(command_tree_tests)
@@ -80,5 +85,703 @@ BOOST_AUTO_TEST_CASE(cmd_argument)
     cmds("xda yd cmplx 0 55 cmd arguments");
 }
 
+BOOST_AUTO_TEST_CASE(malformed_leaf_arguments)
+{
+    command_tree cmds {
+        { "leaf", make_command([](int) { BOOST_TEST(false); }) }
+    };
+
+    // resolve() doesn't read the arguments of leaves, i.e. the malformed
+    // token is first read while the exception is annotated
+    try
+    {
+        cmds("leaf \"1\\q\"");
+        BOOST_TEST(false);
+    }
+    catch (invalid_escape_sequence_error &exc)
+    {
+        auto commandPart = boost::get_error_info<command_part_info>(exc);
+        auto argPart = boost::get_error_info<arg_part_info>(exc);
+        BOOST_TEST_REQUIRE(commandPart);
+        BOOST_TEST_REQUIRE(argPart);
+        BOOST_TEST(*commandPart == "leaf ");
+        BOOST_TEST(*argPart == "\"1\\q\"");
+        BOOST_TEST(!boost::get_error_info<last_token_info>(exc));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(compressed_chain_split_on_insert)
+{
+    std::string called;
+    command_tree cmds;
+    auto recorder = [&called](std::string name)
+    {
+        return [&called, name](std::string_view args) { called = name + ":" + std::string{args}; };
+    };
+
+    cmds.insert("cluster node disk smart attrs raw dump", recorder("dump"));
+    cmds("cluster node disk smart attrs raw dump 1 2");
+    BOOST_TEST(called == "dump:1 2");
+
+    cmds.insert("cluster node disk smart", recorder("smart"));
+    cmds.insert("cluster node disk smart attrs raw list", recorder("list"));
+    cmds.insert("cluster node", recorder("node"));
+
+    cmds("cluster node disk smart attrs raw dump");
+    BOOST_TEST(called == "dump:");
+    cmds("cluster node disk smart attrs raw list x");
+    BOOST_TEST(called == "list:x");
+    cmds("cluster node disk smart attributes");
+    BOOST_TEST(called == "smart:attributes");
+    cmds("cluster node sda");
+    BOOST_TEST(called == "node:sda");
+
+    BOOST_CHECK_THROW(cmds("cluster"), command_not_found_error);
+    BOOST_CHECK_THROW(cmds("cluster node disk"), command_not_found_error);
+    BOOST_CHECK_THROW(cmds("cluster node disk smart attrs raw"), command_not_found_error);
+    BOOST_CHECK_THROW(cmds("cluster node disk smart attrs"), command_not_found_error);
+}
+
+BOOST_AUTO_TEST_CASE(compressed_chain_mismatch)
+{
+    command_tree cmds {
+        { "a b c d", [](std::string_view){ BOOST_TEST(false); } }
+    };
+
+    try
+    {
+        cmds("a b x d 5");
+        BOOST_TEST(false);
+    }
+    catch (command_not_found_error &exc)
+    {
+        auto lastToken = boost::get_error_info<last_token_info>(exc);
+        auto argPart = boost::get_error_info<arg_part_info>(exc);
+        BOOST_TEST_REQUIRE(lastToken);
+        BOOST_TEST_REQUIRE(argPart);
+        BOOST_TEST(*lastToken == "x");
+        BOOST_TEST(*argPart == "x d 5");
+    }
+    BOOST_CHECK_THROW(cmds("a  b c d"), command_not_found_error);
+}
+
+BOOST_AUTO_TEST_CASE(compressed_chain_with_escaped_names)
+{
+    std::string_view received = "-";
+    command_tree cmds {
+        { R"(a "b c" d\\e f)", [&received](std::string_view args){ received = args; } }
+    };
+
+    cmds(R"(a b\ c d\\e f arg)");
+    BOOST_TEST(received == "arg");
+    received = "-";
+    cmds(R"(a "b c" "d\\e" f)");
+    BOOST_TEST(received == "");
+}
+
+BOOST_AUTO_TEST_CASE(utf8_validating_tree)
+{
+    tokenizer_options options;
+    options.validate_utf8 = true;
+    options.unicode_whitespace = true;
+
+    std::string received;
+    command_tree cmds({
+        { "set name", make_command([&received](std::string name) { received = name; }) }
+    }, options);
+
+    cmds(u8"set\u00a0name gr\u00fc\u00dfe");
+    BOOST_TEST(received == u8"gr\u00fc\u00dfe");
+
+    try
+    {
+        cmds("set name ab\xff");
+        BOOST_TEST(false);
+    }
+    catch (invalid_utf8_error &exc)
+    {
+        auto offset = boost::get_error_info<input_offset_info>(exc);
+        BOOST_TEST_REQUIRE(offset);
+        BOOST_TEST(*offset == 11u);
+    }
+    BOOST_CHECK_THROW(cmds("set\xc3 name x"), invalid_utf8_error);
+
+    // neither untokenized nor raw arguments bypass the validation
+    bool called = false;
+    cmds.insert("say", make_command([&called](int, rest_of_line) { called = true; }));
+    cmds.insert("raw", [&called](std::string_view) { called = true; });
+    cmds(u8"say 1 \"gr\u00fc\u00dfe\" x");
+    cmds(u8"raw gr\u00fc\u00dfe");
+    BOOST_TEST(called);
+    called = false;
+    BOOST_CHECK_THROW(cmds("say 1 \"ab\xff\" x"), invalid_utf8_error);
+    try
+    {
+        cmds("raw a b\xc3");
+        BOOST_TEST(false);
+    }
+    catch (invalid_utf8_error &exc)
+    {
+        auto offset = boost::get_error_info<input_offset_info>(exc);
+        BOOST_TEST_REQUIRE(offset);
+        BOOST_TEST(*offset == 7u);
+    }
+    BOOST_TEST(!called);
+
+    command_tree lenient {
+        { "set name", make_command([&received](std::string name) { received = name; }) }
+    };
+    lenient("set name ab\xff");
+    BOOST_TEST(received == "ab\xff");
+}
+
+
+BOOST_AUTO_TEST_CASE(command_ids_and_rebind)
+{
+    int received = 0;
+    command_tree cmds {
+        { "a b", make_command([&received](int v) { received = v; }) },
+        { "a \"c d\"", make_command([&received](int v) { received = -v; }) }
+    };
+    BOOST_TEST(cmds.size() == 2u);
+    BOOST_TEST(cmds.path(0) == "a b");
+    BOOST_TEST(cmds.path(1) == "a c\\ d");
+
+    auto prepared = cmds.prepare("a c\\ d 3");
+    BOOST_TEST(prepared.id() == 1u);
+    BOOST_TEST(prepared.arguments() == "3");
+
+    auto rebound = cmds.rebind(prepared.id(), prepared.command(), prepared.path().size());
+    BOOST_TEST_REQUIRE(rebound.has_value());
+    cmds.execute(*rebound);
+    BOOST_TEST(received == -3);
+
+    // the recorded path has to be the canonical path of the id
+    BOOST_TEST(!cmds.rebind(0, "a c\\ d 3", 6).has_value());
+    BOOST_TEST(!cmds.rebind(1, "a \"c d\" 3", 8).has_value());
+    BOOST_TEST(!cmds.rebind(7, "a b 3", 4).has_value());
+
+    // replacing an action keeps the id
+    cmds.insert("a b", make_command([&received](int v) { received = 2 * v; }));
+    BOOST_TEST(cmds.size() == 2u);
+    cmds.execute(*cmds.rebind(0, "a b 4", 4));
+    BOOST_TEST(received == 8);
+}
+
+BOOST_AUTO_TEST_CASE(parsing_ahead)
+{
+    int calls = 0;
+    std::string received;
+    command_tree cmds {
+        { "set", make_command([&](int v, std::string_view name)
+        {
+            ++calls;
+            received = std::to_string(v) + std::string{ name };
+            return v * 2;
+        }) },
+        { "raw", [&](std::string_view args) { ++calls; received = args; } }
+    };
+
+    const std::string cmd = "set 3 \"a b\"";
+    auto parsed = cmds.parse(cmd);
+    BOOST_TEST(parsed.parsed());
+    BOOST_TEST(calls == 0);
+    char buffer[8];
+    auto result = cmds.execute(parsed, std::begin(buffer), std::end(buffer));
+    BOOST_TEST(std::string_view(buffer, result.ptr - buffer) == "6");
+    BOOST_TEST(received == "3a b");
+    cmds.execute(parsed);
+    BOOST_TEST(calls == 2);
+
+    // argument errors are thrown by parse()
+    try
+    {
+        cmds.parse("set x y");
+        BOOST_FAIL("parse didn't throw");
+    }
+    catch (invalid_integer_error &exc)
+    {
+        auto part = boost::get_error_info<command_part_info>(exc);
+        BOOST_TEST_REQUIRE(part != nullptr);
+        BOOST_TEST(*part == "set ");
+    }
+    BOOST_TEST(calls == 2);
+
+    // other delegates and unknown commands are left to execute()
+    auto raw = cmds.parse("raw 1 2");
+    BOOST_TEST(!raw.parsed());
+    cmds.execute(raw);
+    BOOST_TEST(received == "1 2");
+    BOOST_TEST(!cmds.parse("").parsed());
+}
+
+
+BOOST_AUTO_TEST_CASE(mounted_subtrees)
+{
+    std::string received;
+    auto net = std::make_shared<command_tree>(command_tree::initializer_list{
+        { "link up", make_command([&received](std::string name) { received = "up " + name; }) },
+        { "link down", make_command([&received]() { received = "down"; }) }
+    });
+    command_tree root {
+        { "disk list", make_command([&received]() { received = "disks"; }) }
+    };
+    root.mount("cluster net", net);
+
+    root("cluster net link up eth0");
+    BOOST_TEST(received == "up eth0");
+    root("cluster \"net\" link down");
+    BOOST_TEST(received == "down");
+    root("disk list");
+    BOOST_TEST(received == "disks");
+
+    auto prepared = root.prepare("cluster net link up eth1");
+    BOOST_TEST(prepared.path() == "cluster net link up ");
+    BOOST_TEST(prepared.arguments() == "eth1");
+    BOOST_TEST(&prepared.owner() == net.get());
+    BOOST_TEST(prepared.id() == net->prepare("link up").id());
+
+    try
+    {
+        root("cluster net link sideways");
+        BOOST_TEST(false);
+    }
+    catch (command_not_found_error &exc)
+    {
+        auto cmdPart = boost::get_error_info<command_part_info>(exc);
+        BOOST_TEST_REQUIRE(cmdPart);
+        BOOST_TEST(*cmdPart == "cluster net link ");
+    }
+
+    BOOST_CHECK_THROW(root.insert("cluster net link flap", make_command([]() {})), mount_error);
+    BOOST_CHECK_THROW(root.insert("cluster net", make_command([]() {})), mount_error);
+    BOOST_CHECK_THROW(root.mount("disk", net), mount_error);
+    BOOST_CHECK_THROW(root.mount("", net), mount_error);
+
+    // splitting the compressed mount point edge keeps the mount
+    root.insert("cluster status", make_command([&received]() { received = "status"; }));
+    root("cluster net link down");
+    BOOST_TEST(received == "down");
+    root("cluster status");
+    BOOST_TEST(received == "status");
+
+    BOOST_TEST(!root.unmount("cluster"));
+    BOOST_TEST(root.unmount("cluster net"));
+    BOOST_TEST(!root.unmount("cluster net"));
+    BOOST_CHECK_THROW(root("cluster net link down"), command_not_found_error);
+    root.insert("cluster net", make_command([&received]() { received = "net"; }));
+    root("cluster net");
+    BOOST_TEST(received == "net");
+}
+
+BOOST_AUTO_TEST_CASE(cyclic_mounts)
+{
+    auto a = std::make_shared<command_tree>();
+    auto b = std::make_shared<command_tree>();
+    a->mount("b", b);
+    BOOST_CHECK_THROW(b->mount("a", a), mount_error);
+    BOOST_CHECK_THROW(a->mount("self", a), mount_error);
+}
+
+namespace
+{
+    std::chrono::nanoseconds fake_now{ 0 };
+
+    std::chrono::nanoseconds fake_clock()
+    {
+        return fake_now;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rate_limits)
+{
+    int parsed = 0;
+    int dumps = 0;
+    int sets = 0;
+    command_tree cmds {
+        { "dump full", make_command([&dumps]() { ++dumps; }) },
+        { "dump short x", make_command([&dumps]() { ++dumps; }) },
+        { "set", make_command([&sets](int) { ++sets; }) }
+    };
+    cmds.observe([&parsed](const command_tree::prepared_command &) { ++parsed; });
+
+    fake_now = std::chrono::seconds(100);
+    cmds.limit("dump", { std::chrono::seconds(1), 2, &fake_clock });
+    // inherited by commands inserted later
+    cmds.insert("dump other", make_command([&dumps]() { ++dumps; }));
+
+    BOOST_TEST((cmds.try_dispatch("dump full") == dispatch_status::executed));
+    BOOST_TEST((cmds.try_dispatch("dump other") == dispatch_status::executed));
+    BOOST_TEST((cmds.try_dispatch("dump short x") == dispatch_status::rate_limited));
+    BOOST_CHECK_THROW(cmds("dump full"), rate_limited_error);
+    // shed before the arguments are parsed or the observer is called
+    BOOST_TEST((cmds.try_dispatch("dump full too many arguments") == dispatch_status::rate_limited));
+    BOOST_TEST(dumps == 2);
+    BOOST_TEST(parsed == 2);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        cmds("set 1");
+    }
+    BOOST_TEST(sets == 10);
+
+    fake_now += std::chrono::milliseconds(1500);
+    BOOST_TEST((cmds.try_dispatch("dump full") == dispatch_status::executed));
+    BOOST_TEST((cmds.try_dispatch("dump full") == dispatch_status::rate_limited));
+
+    auto stats = cmds.limit_stats("dump");
+    BOOST_TEST_REQUIRE(stats.has_value());
+    BOOST_TEST(stats->admitted == 3u);
+    BOOST_TEST(stats->rejected == 4u);
+    BOOST_TEST(!cmds.limit_stats("set"));
+
+    // the longest limited prefix wins, which splits the compressed edge
+    cmds.limit("dump short", { std::chrono::seconds(1), 1, &fake_clock });
+    BOOST_TEST((cmds.try_dispatch("dump short x") == dispatch_status::executed));
+    BOOST_TEST((cmds.try_dispatch("dump short x") == dispatch_status::rate_limited));
+    BOOST_TEST((cmds.try_dispatch("dump full") == dispatch_status::rate_limited));
+
+    BOOST_TEST(cmds.unlimit("dump"));
+    BOOST_TEST(!cmds.unlimit("dump"));
+    BOOST_TEST((cmds.try_dispatch("dump full") == dispatch_status::executed));
+    BOOST_TEST((cmds.try_dispatch("dump short x") == dispatch_status::rate_limited));
+
+    // shedding everything
+    cmds.limit("", { std::chrono::seconds(1), 0, &fake_clock });
+    BOOST_TEST((cmds.try_dispatch("set 2") == dispatch_status::rate_limited));
+    BOOST_CHECK_THROW(cmds.try_dispatch("unknown"), command_not_found_error);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_rate_limit)
+{
+    std::atomic<int> runs{ 0 };
+    command_tree cmds {
+        { "run", make_command([&runs]() { ++runs; }) }
+    };
+    fake_now = std::chrono::seconds(100);
+    cmds.limit("run", { std::chrono::seconds(1), 100, &fake_clock });
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&cmds]()
+        {
+            for (int i = 0; i < 1000; ++i)
+            {
+                cmds.try_dispatch("run");
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    BOOST_TEST(runs == 100);
+    BOOST_TEST(cmds.limit_stats("run")->rejected == 3900u);
+}
+
+BOOST_AUTO_TEST_CASE(typed_results)
+{
+    int calls = 0;
+    command_tree tree;
+    tree.insert("add", make_command([](int a, int b) { return a + b; }));
+    tree.insert("echo", make_command([](std::string_view v) { return std::string{ v }; }));
+    tree.insert("find", make_command([](int v) { return v > 0 ? std::optional<int>{ v } : std::nullopt; }));
+    tree.insert("count", make_command([&calls]() { ++calls; }));
+    tree.insert("nested", make_command([&tree]() { tree("add 1 2"); return 7; }));
+
+    char buffer[16];
+    const auto dispatch = [&](std::string_view cmd)
+    {
+        auto [ptr, ec] = tree.dispatch(cmd, buffer, buffer + sizeof(buffer));
+        BOOST_TEST((ec == std::errc{}));
+        return std::string(buffer, ptr);
+    };
+    BOOST_TEST(dispatch("add 2 -5") == "-3");
+    BOOST_TEST(dispatch("echo \"a b\"") == "a\\ b");
+    BOOST_TEST(dispatch("find 4") == "4");
+    BOOST_TEST(dispatch("find -4") == "");
+    BOOST_TEST(dispatch("count") == "");
+    BOOST_TEST(calls == 1);
+    // results of nested dispatches aren't written
+    BOOST_TEST(dispatch("nested") == "7");
+
+    // operator() discards results
+    tree("add 1 1");
+
+    auto tooLarge = tree.dispatch("echo 0123456789abcdefgh", buffer, buffer + sizeof(buffer));
+    BOOST_TEST((tooLarge.ec == std::errc::value_too_large));
+
+    auto sub = std::make_shared<command_tree>();
+    sub->insert("neg", make_command([](int v) { return -v; }));
+    tree.mount("sub", sub);
+    BOOST_TEST(dispatch("sub neg 3") == "-3");
+}
+
+BOOST_AUTO_TEST_CASE(resolve_only_routing)
+{
+    bool called = false;
+    command_tree tree;
+    tree.insert("user rename", make_command([&called](unsigned, std::string) { called = true; }));
+    tree.insert("user set quota", make_command([&called](std::string, unsigned) { called = true; }));
+    auto sub = std::make_shared<command_tree>();
+    sub->insert("get", make_command([&called](int) { called = true; }));
+    tree.mount("shard", sub);
+
+    auto route = tree.resolve("user rename 17 \"new name\"");
+    BOOST_TEST(route.id == 0u);
+    BOOST_TEST(route.owner == &tree);
+    BOOST_TEST(route.args_offset == 12u);
+
+    std::optional<unsigned> id;
+    route = tree.resolve("user rename 17 \"new name\"", 0, id);
+    BOOST_TEST(route.id == 0u);
+    BOOST_TEST(id.has_value());
+    BOOST_TEST(*id == 17u);
+
+    std::optional<std::string> name;
+    tree.resolve("user \"set\" quota \"a b\" 5", 0, name);
+    BOOST_TEST(name.has_value());
+    BOOST_TEST(*name == "a b");
+    tree.resolve("user set quota x 5", 1, id);
+    BOOST_TEST(*id == 5u);
+    tree.resolve("user set quota x", 1, id);
+    BOOST_TEST(!id.has_value());
+
+    route = tree.resolve("shard get 3", 0, id);
+    BOOST_TEST(route.id == 0u);
+    BOOST_TEST(route.owner == sub.get());
+    BOOST_TEST(*id == 3u);
+
+    // unknown paths don't throw, not even within a compressed edge
+    BOOST_TEST(tree.resolve("group list").id == command_tree::invalid_command_id);
+    BOOST_TEST(tree.resolve("user set size 1").id == command_tree::invalid_command_id);
+    BOOST_TEST(tree.resolve("user").id == command_tree::invalid_command_id);
+    BOOST_TEST(tree.resolve("unknown 1", 0, id).id == command_tree::invalid_command_id);
+    BOOST_TEST(!id.has_value());
+
+    BOOST_CHECK_THROW(tree.resolve("user rename x", 0, id), invalid_integer_error);
+    BOOST_CHECK_THROW(tree.resolve("user \\q"), invalid_escape_sequence_error);
+    BOOST_TEST(!called);
+}
+
+BOOST_AUTO_TEST_CASE(coalescing_batches)
+{
+    std::vector<std::string> calls;
+    command_tree tree;
+    const auto record = [&calls](std::string name)
+    {
+        return make_command([&calls, name](std::string key, int v)
+        {
+            calls.push_back(name + " " + key + " " + std::to_string(v));
+        });
+    };
+    tree.insert("set", record("set"));
+    tree.insert("init", record("init"));
+    tree.insert("add", record("add"));
+    tree.coalesce("set", coalesce_by_argument(0));
+    tree.coalesce("init", coalesce_by_argument(0), coalesce_policy::keep_first);
+    BOOST_CHECK_THROW(tree.coalesce("unknown", coalesce_by_argument(0)), command_not_found_error);
+
+    const std::vector<std::string_view> cmds{
+        "set a 1", "init a 1", "add a 1", "set \"a\" 2", "set b 1",
+        "init a 2", "set", "add a 2", "set a 3",
+    };
+    std::size_t consumed = 0;
+    BOOST_CHECK_THROW(tree.dispatch_batch(cmds.data(), cmds.size(), &consumed),
+                      not_enough_arguments_error);
+    BOOST_TEST(consumed == 7u);
+    // the quoted key is spelled differently, "set" without a key is never
+    // coalesced and fails
+    const std::vector<std::string> expected{
+        "init a 1", "add a 1", "set a 2", "set b 1",
+    };
+    BOOST_TEST(calls == expected);
+
+    calls.clear();
+    BOOST_TEST(tree.dispatch_batch(cmds.data() + 7, 2) == 2u);
+    BOOST_TEST(calls == (std::vector<std::string>{ "add a 2", "set a 3" }));
+
+    auto stats = tree.coalesce_stats("set");
+    BOOST_TEST(stats.has_value());
+    BOOST_TEST(stats->executed == 3u);
+    BOOST_TEST(stats->coalesced == 1u);
+    BOOST_TEST(tree.coalesce_stats("init")->coalesced == 1u);
+    BOOST_TEST(!tree.coalesce_stats("add").has_value());
+
+    // skips behind a failure aren't counted, the commands are dispatched
+    // again
+    const std::vector<std::string_view> failing{ "set", "set c 1", "set c 2" };
+    BOOST_CHECK_THROW(tree.dispatch_batch(failing.data(), failing.size(), &consumed),
+                      not_enough_arguments_error);
+    BOOST_TEST(consumed == 1u);
+    BOOST_TEST(tree.dispatch_batch(failing.data() + 1, 2) == 1u);
+    BOOST_TEST(tree.coalesce_stats("set")->coalesced == 2u);
+
+    BOOST_TEST(tree.uncoalesce("set"));
+    BOOST_TEST(!tree.uncoalesce("set"));
+    calls.clear();
+    const std::vector<std::string_view> repeated{ "set a 1", "set a 2" };
+    BOOST_TEST(tree.dispatch_batch(repeated.data(), repeated.size()) == 2u);
+    BOOST_TEST(calls.size() == 2u);
+}
+
+BOOST_AUTO_TEST_CASE(statement_lines)
+{
+    std::vector<std::string> calls;
+    command_tree tree;
+    tree.insert("echo", make_command([&calls](std::string_view v) { calls.emplace_back(v); }));
+    tree.insert("fail", make_command([&calls]()
+    {
+        calls.emplace_back("fail");
+        BOOST_THROW_EXCEPTION(command_not_found_error{});
+    }));
+
+    BOOST_TEST(tree.dispatch_line("echo a; echo \"b;c\" && echo d\\&\\&e;") == 3u);
+    BOOST_TEST(calls == (std::vector<std::string>{ "a", "b;c", "d&&e" }));
+    calls.clear();
+    BOOST_TEST(tree.dispatch_line("echo a\\ ; echo b") == 2u);
+    BOOST_TEST(calls == (std::vector<std::string>{ "a ", "b" }));
+
+    // a failure skips the rest of its "&&" chain, ';' continues
+    calls.clear();
+    try
+    {
+        tree.dispatch_line("echo a && fail && echo b && echo c; echo d && fail");
+        BOOST_FAIL("dispatch_line didn't rethrow");
+    }
+    catch (const command_not_found_error &exc)
+    {
+        auto statement = boost::get_error_info<statement_info>(exc);
+        BOOST_TEST_REQUIRE(statement != nullptr);
+        BOOST_TEST(*statement == 2u);
+    }
+    BOOST_TEST(calls == (std::vector<std::string>{ "a", "fail", "d", "fail" }));
+
+    calls.clear();
+    BOOST_CHECK_THROW(tree.dispatch_line(" ; echo a b ;echo c"), too_many_arguments_error);
+    BOOST_TEST(calls == (std::vector<std::string>{ "c" }));
+    BOOST_TEST(tree.dispatch_line(";;  ") == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(rejecting_unknown_commands)
+{
+    int calls = 0;
+    command_tree tree;
+    BOOST_TEST(tree.resolve("add 1").id == command_tree::invalid_command_id);
+    tree.insert("add", make_command([&calls](int) { ++calls; }));
+    tree.insert("config set value", make_command([&calls](int) { ++calls; }));
+    tree.insert("config get", make_command([&calls]() { ++calls; }));
+    auto sub = std::make_shared<command_tree>();
+    sub->insert("get", make_command([&calls](int) { ++calls; }));
+    tree.mount("shard", sub);
+
+    BOOST_CHECK_THROW(tree.try_dispatch("garbage"), command_not_found_error);
+    tree.reject_unknown();
+    BOOST_TEST((tree.try_dispatch("garbage") == dispatch_status::unknown_command));
+    BOOST_TEST((tree.try_dispatch("") == dispatch_status::unknown_command));
+    BOOST_TEST((tree.try_dispatch(" add 1") == dispatch_status::unknown_command));
+    BOOST_TEST((tree.try_dispatch("config") == dispatch_status::unknown_command));
+    BOOST_TEST((tree.try_dispatch("config bogus 1") == dispatch_status::unknown_command));
+    BOOST_TEST((tree.try_dispatch("config set bogus") == dispatch_status::unknown_command));
+    BOOST_TEST((tree.try_dispatch("shard put 1") == dispatch_status::unknown_command));
+    BOOST_TEST(calls == 0);
+
+    BOOST_TEST((tree.try_dispatch("add 1") == dispatch_status::executed));
+    BOOST_TEST((tree.try_dispatch("\"add\" 1") == dispatch_status::executed));
+    BOOST_TEST((tree.try_dispatch("config set value 1") == dispatch_status::executed));
+    BOOST_TEST((tree.try_dispatch("config get") == dispatch_status::executed));
+    BOOST_TEST((tree.try_dispatch("shard get 1") == dispatch_status::executed));
+    BOOST_TEST(calls == 5);
+    // argument errors are still thrown
+    BOOST_CHECK_THROW(tree.try_dispatch("add x"), invalid_integer_error);
+
+    // the arguments aren't tokenized if the path is rejected
+    BOOST_TEST(tree.resolve("garbage \\q").id == command_tree::invalid_command_id);
+    BOOST_CHECK_THROW(tree.resolve("config \\q"), invalid_escape_sequence_error);
+
+    tree.insert("", make_command([&calls]() { ++calls; }));
+    BOOST_TEST((tree.try_dispatch("") == dispatch_status::executed));
+}
+
+BOOST_AUTO_TEST_CASE(root_filter_false_positives)
+{
+    detail::root_filter filter;
+    for (int i = 0; i < 1000; ++i)
+    {
+        filter.add_first("cmd" + std::to_string(i), i % 2 == 0);
+        filter.add_pair("cmd" + std::to_string(i), "sub");
+    }
+    int passed = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        const auto name = "cmd" + std::to_string(i);
+        BOOST_TEST(filter.may_resolve(name + " sub 1", false));
+        passed += filter.may_resolve(name + " other 1", false);
+    }
+    // the open commands pass with every second token
+    BOOST_TEST(passed >= 500);
+    BOOST_TEST(passed < 510);
+
+    passed = 0;
+    for (int i = 0; i < 100000; ++i)
+    {
+        passed += filter.may_resolve("garbage" + std::to_string(i) + " sub", false);
+    }
+    BOOST_TEST(passed < 100);
+    BOOST_TEST(filter.may_resolve("x\\y", false));
+    BOOST_TEST(!filter.may_resolve("x\ty", false));
+    BOOST_TEST(filter.may_resolve("x\ty", true));
+}
+
+
+BOOST_AUTO_TEST_CASE(recycling_dispatch_context)
+{
+    command_tree tree;
+    std::string message;
+    std::string tag;
+    tree.insert("log write", make_command([&](const std::string &msg, std::string_view t)
+    {
+        message = msg;
+        tag = t;
+    }));
+
+    const std::string text(100, 'x');
+    const auto cmd = "log write " + text + "\\ y info";
+    dispatch_context context;
+    tree(cmd, context);
+    BOOST_TEST(message == text + " y");
+    BOOST_TEST(tag == "info");
+    // two unescape buffers and the std::string argument
+    BOOST_TEST(context.stats().buffers_requested == 3u);
+    BOOST_TEST(context.stats().buffers_reused == 0u);
+    // the message has been unescaped and assigned to the argument
+    const auto retained = context.stats().bytes_retained;
+    BOOST_TEST(retained >= 2 * text.size());
+
+    tree(cmd, context);
+    BOOST_TEST(message == text + " y");
+    BOOST_TEST(context.stats().buffers_reused == 3u);
+    BOOST_TEST(context.stats().reuse_ratio() == 0.5);
+    BOOST_TEST(context.stats().bytes_retained == retained);
+
+    // the buffers are returned if the command fails
+    BOOST_CHECK_THROW(tree(cmd + " extra", context), too_many_arguments_error);
+    BOOST_TEST(context.stats().bytes_retained == retained);
+
+    context.shrink();
+    BOOST_TEST(context.stats().bytes_retained == 0u);
+
+    dispatch_context small{ 16 };
+    tree(cmd, small);
+    tree(cmd, small);
+    BOOST_TEST(small.stats().bytes_retained == 0u);
+    BOOST_TEST(message == text + " y");
+
+    // dispatches without a context don't touch it
+    tree("log write a b");
+    BOOST_TEST(message == "a");
+    BOOST_TEST(small.stats().buffers_requested == 6u);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
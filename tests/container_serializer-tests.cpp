@@ -0,0 +1,110 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/container_serializer.hpp>
+#include "boost-unit-test.hpp"
+
+using namespace ucmdp;
+using namespace ucmdp::detail;
+
+
+BOOST_AUTO_TEST_SUITE(container_serializer_tests)
+
+
+BOOST_AUTO_TEST_CASE(token_count)
+{
+    BOOST_TEST(cmd_token_stream{ "" }.count_remaining() == 0u);
+    BOOST_TEST(cmd_token_stream{ "a" }.count_remaining() == 1u);
+    BOOST_TEST(cmd_token_stream{ "a b " }.count_remaining() == 2u);
+    BOOST_TEST(cmd_token_stream{ "a  b" }.count_remaining() == 3u);
+    BOOST_TEST(cmd_token_stream{ R"("a b" c\ d)" }.count_remaining() == 2u);
+}
+
+BOOST_AUTO_TEST_CASE(vector_of_ints)
+{
+    std::vector<int> received;
+    command<void(int, std::vector<int>)> cmd([&](int id, std::vector<int> values)
+    {
+        BOOST_TEST(id == 7);
+        received = std::move(values);
+    });
+
+    cmd.exec("7 1 -2 0x10 010 +5 0");
+    BOOST_TEST((received == std::vector<int>{ 1, -2, 16, 8, 5, 0 }));
+
+    cmd.exec("7");
+    BOOST_TEST(received.empty());
+
+    BOOST_CHECK_THROW(cmd.exec("7 1 x"), invalid_integer_error);
+}
+
+BOOST_AUTO_TEST_CASE(large_vector_of_doubles)
+{
+    std::string input;
+    for (int i = 0; i < 10000; ++i)
+    {
+        input += std::to_string(i) + ".5 ";
+    }
+
+    std::size_t count = 0;
+    double sum = 0;
+    command<void(std::vector<double>)> cmd([&](const std::vector<double> &values)
+    {
+        count = values.size();
+        BOOST_TEST(values.capacity() == values.size());
+        for (auto v : values)
+        {
+            sum += v;
+        }
+    });
+    cmd.exec(input);
+    BOOST_TEST(count == 10000u);
+    BOOST_TEST(sum == 10000 * 9999 / 2 + 5000.0);
+}
+
+BOOST_AUTO_TEST_CASE(vector_of_strings)
+{
+    std::vector<std::string> received;
+    command<void(std::vector<std::string>)> cmd([&](std::vector<std::string> values)
+    {
+        received = std::move(values);
+    });
+
+    cmd.exec(R"(a "b c" d)");
+    BOOST_TEST((received == std::vector<std::string>{ "a", "b c", "d" }));
+}
+
+BOOST_AUTO_TEST_CASE(fixed_size_array)
+{
+    std::array<unsigned int, 3> received{};
+    command<void(std::array<unsigned int, 3>)> cmd([&](std::array<unsigned int, 3> values)
+    {
+        received = values;
+    });
+
+    cmd.exec("1 2 3");
+    BOOST_TEST((received == std::array<unsigned int, 3>{ 1, 2, 3 }));
+
+    BOOST_CHECK_THROW(cmd.exec("1 2"), not_enough_arguments_error);
+    BOOST_CHECK_THROW(cmd.exec("1 2 3 4"), too_many_arguments_error);
+}
+
+BOOST_AUTO_TEST_CASE(rest_of_line_arg)
+{
+    std::string_view input = "x  everything \"else";
+    std::string_view received;
+    command<void(std::string_view, rest_of_line)> cmd([&](std::string_view, rest_of_line rest)
+    {
+        received = rest.text;
+    });
+
+    cmd.exec(input);
+    BOOST_TEST(received == " everything \"else");
+    BOOST_TEST(received.data() == input.data() + 2);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/enum_serializer.hpp>
+#include "boost-unit-test.hpp"
+
+#include <thread>
+
+using namespace ucmdp;
+using namespace ucmdp::detail;
+
+namespace
+{
+    enum class sync_mode
+    {
+        none,
+        lazy,
+        full,
+    };
+}
+
+namespace ucmdp
+{
+    template< >
+    struct serialization_traits< sync_mode >
+        : enum_serializer< sync_mode >
+    {
+        static constexpr auto names = make_enum_names(
+            enum_name("none", sync_mode::none),
+            enum_name("lazy", sync_mode::lazy),
+            enum_name("full", sync_mode::full),
+            enum_name("off", sync_mode::none)
+        );
+    };
+}
+
+BOOST_AUTO_TEST_SUITE(enum_serializer_tests)
+
+static_assert(serialization_traits<sync_mode>::names.find("full") == 2);
+static_assert(serialization_traits<sync_mode>::names.find("fullx") == 4);
+static_assert(serialization_traits<sync_mode>::names.value(3) == sync_mode::none);
+
+
+BOOST_AUTO_TEST_CASE(enum_arguments)
+{
+    sync_mode received = sync_mode::full;
+    command<void(sync_mode)> cmd([&received](sync_mode mode) { received = mode; });
+
+    cmd.exec("lazy");
+    BOOST_TEST((received == sync_mode::lazy));
+    cmd.exec("off");
+    BOOST_TEST((received == sync_mode::none));
+
+    try
+    {
+        cmd.exec("eager");
+        BOOST_TEST(false);
+    }
+    catch (invalid_enum_value_error &exc)
+    {
+        auto names = boost::get_error_info<valid_values_info>(exc);
+        BOOST_TEST_REQUIRE(names);
+        BOOST_TEST(*names == "none, lazy, full, off");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(enum_serialization)
+{
+    char buffer[32];
+    auto [end, ec] = format_command(std::begin(buffer), std::end(buffer), "sync", sync_mode::none);
+    BOOST_TEST_REQUIRE((ec == std::errc{}));
+    BOOST_TEST(std::string_view(buffer, end - buffer) == "sync none");
+
+    auto invalid = serialization_traits<sync_mode>{}.serialize(
+        std::begin(buffer), std::end(buffer), static_cast<sync_mode>(7));
+    BOOST_TEST((invalid.ec == std::errc::invalid_argument));
+}
+
+BOOST_AUTO_TEST_CASE(symbol_arguments)
+{
+    std::vector<symbol> received;
+    command<void(symbol)> cmd([&received](symbol sym) { received.push_back(sym); });
+
+    cmd.exec("eth0");
+    cmd.exec("\"eth 1\"");
+    cmd.exec("eth0");
+    BOOST_TEST_REQUIRE(received.size() == 3u);
+    BOOST_TEST((received[0] == received[2]));
+    BOOST_TEST((received[0] != received[1]));
+    BOOST_TEST(received[1].name() == "eth 1");
+    BOOST_TEST(symbol_table::global().find("eth0").value() == received[0].id);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_interning)
+{
+    symbol_table table;
+    std::vector<std::vector<symbol_table::id_type>> ids(4);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < ids.size(); ++t)
+    {
+        threads.emplace_back([&table, &result = ids[t]]()
+        {
+            for (int i = 0; i < 1000; ++i)
+            {
+                result.push_back(table.intern("name" + std::to_string(i % 100)));
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    BOOST_TEST(table.size() == 100u);
+    for (auto &result : ids)
+    {
+        BOOST_TEST(result == ids[0]);
+    }
+    BOOST_TEST(table.name(ids[0][42]) == "name42");
+    BOOST_TEST(!table.find("name100"));
+}
+
+BOOST_AUTO_TEST_CASE(bounded_interning)
+{
+    symbol_table table{ 3, 8 };
+    table.intern("a");
+    table.intern("bcd");
+    BOOST_CHECK_THROW(table.intern("efghi"), symbol_table_full_error);
+    table.intern("efgh");
+    BOOST_CHECK_THROW(table.intern("x"), symbol_table_full_error);
+    // known names are still resolved
+    BOOST_TEST(table.intern("bcd") == 1u);
+    BOOST_TEST(table.size() == 3u);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,226 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+
+// built with -fno-exceptions -fno-rtti and without Boost. The allocation
+// functions abort once the tests run, i.e. any heap usage fails the test.
+#include <ucmd-parser/static_command_tree.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <malloc.h>
+
+extern "C"
+{
+    void *__libc_malloc(std::size_t size);
+    void *__libc_calloc(std::size_t count, std::size_t size);
+    void *__libc_realloc(void *ptr, std::size_t size);
+    void *__libc_memalign(std::size_t alignment, std::size_t size);
+    void __libc_free(void *ptr);
+}
+
+namespace
+{
+    bool heap_forbidden = false;
+
+    void check_heap(const char *fn)
+    {
+        if (heap_forbidden)
+        {
+            std::fputs(fn, stderr);
+            std::fputs(" has been called\n", stderr);
+            std::abort();
+        }
+    }
+}
+
+extern "C"
+{
+    void *malloc(std::size_t size)
+    {
+        check_heap("malloc");
+        return __libc_malloc(size);
+    }
+    void *calloc(std::size_t count, std::size_t size)
+    {
+        check_heap("calloc");
+        return __libc_calloc(count, size);
+    }
+    void *realloc(void *ptr, std::size_t size)
+    {
+        check_heap("realloc");
+        return __libc_realloc(ptr, size);
+    }
+    void *memalign(std::size_t alignment, std::size_t size)
+    {
+        check_heap("memalign");
+        return __libc_memalign(alignment, size);
+    }
+    void *aligned_alloc(std::size_t alignment, std::size_t size)
+    {
+        check_heap("aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+    int posix_memalign(void **ptr, std::size_t alignment, std::size_t size)
+    {
+        check_heap("posix_memalign");
+        *ptr = __libc_memalign(alignment, size);
+        return *ptr ? 0 : ENOMEM;
+    }
+    void free(void *ptr)
+    {
+        // releasing memory obtained before the tests started is fine
+        __libc_free(ptr);
+    }
+}
+
+using namespace ucmdp;
+
+namespace
+{
+    int failures = 0;
+
+#define UCMDP_CHECK(expr) \
+    do \
+    { \
+        if (!(expr)) \
+        { \
+            std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #expr); \
+            ++failures; \
+        } \
+    } while (false)
+
+    struct controller
+    {
+        int speed = 0;
+        bool enabled = false;
+        double gain = 0.0;
+        char name[16] = {};
+        int resets = 0;
+    };
+
+    void set_speed(void *ctx, int speed)
+    {
+        static_cast<controller *>(ctx)->speed = speed;
+    }
+    void enable(void *ctx, bool on)
+    {
+        static_cast<controller *>(ctx)->enabled = on;
+    }
+    static_errc set_gain(void *ctx, double gain)
+    {
+        if (gain < 0.0 || gain > 1.0)
+        {
+            return static_errc::argument_out_of_range;
+        }
+        static_cast<controller *>(ctx)->gain = gain;
+        return static_errc::ok;
+    }
+    void rename(void *ctx, std::string_view name)
+    {
+        auto &c = *static_cast<controller *>(ctx);
+        const auto n = name.size() < sizeof(c.name) - 1 ? name.size() : sizeof(c.name) - 1;
+        std::memcpy(c.name, name.data(), n);
+        c.name[n] = '\0';
+    }
+    void reset(void *ctx)
+    {
+        ++static_cast<controller *>(ctx)->resets;
+    }
+
+    void dispatches_commands()
+    {
+        controller c;
+        static_command_tree<8, 16> tree;
+        UCMDP_CHECK(tree.insert("motor speed", make_static_command(&set_speed, &c)) == static_errc::ok);
+        UCMDP_CHECK(tree.insert("motor enable", make_static_command(&enable, &c)) == static_errc::ok);
+        UCMDP_CHECK(tree.insert("motor gain", make_static_command(&set_gain, &c)) == static_errc::ok);
+        UCMDP_CHECK(tree.insert("name", make_static_command(&rename, &c)) == static_errc::ok);
+        UCMDP_CHECK(tree.insert("reset", make_static_command(&reset, &c)) == static_errc::ok);
+        UCMDP_CHECK(tree.size() == 7u);
+
+        UCMDP_CHECK(tree("motor speed -42"));
+        UCMDP_CHECK(c.speed == -42);
+        UCMDP_CHECK(tree("  motor   enable true "));
+        UCMDP_CHECK(c.enabled);
+        UCMDP_CHECK(tree("motor gain 0.25"));
+        UCMDP_CHECK(c.gain == 0.25);
+        UCMDP_CHECK(tree("name \"left wheel\""));
+        UCMDP_CHECK(std::strcmp(c.name, "left wheel") == 0);
+        UCMDP_CHECK(tree("name a\\\"b\\\\c"));
+        UCMDP_CHECK(std::strcmp(c.name, "a\"b\\c") == 0);
+        UCMDP_CHECK(tree("reset"));
+        UCMDP_CHECK(c.resets == 1);
+    }
+
+    void reports_error_codes()
+    {
+        controller c;
+        static_command_tree<8, 8> tree;
+        tree.insert("motor speed", make_static_command(&set_speed, &c));
+        tree.insert("motor gain", make_static_command(&set_gain, &c));
+        tree.insert("name", make_static_command(&rename, &c));
+
+        auto r = tree("motor");
+        UCMDP_CHECK(r.error == static_errc::command_not_found);
+        r = tree("motor spin 1");
+        UCMDP_CHECK(r.error == static_errc::command_not_found);
+        UCMDP_CHECK(r.offset == 6u);
+        r = tree("motor speed");
+        UCMDP_CHECK(r.error == static_errc::not_enough_arguments);
+        r = tree("motor speed 1 2");
+        UCMDP_CHECK(r.error == static_errc::too_many_arguments);
+        UCMDP_CHECK(r.offset == 14u);
+        r = tree("motor speed 1x");
+        UCMDP_CHECK(r.error == static_errc::invalid_argument);
+        UCMDP_CHECK(r.offset == 12u);
+        r = tree("motor speed 99999999999");
+        UCMDP_CHECK(r.error == static_errc::argument_out_of_range);
+        r = tree("motor gain 2");
+        UCMDP_CHECK(r.error == static_errc::argument_out_of_range);
+        r = tree("name a\\x");
+        UCMDP_CHECK(r.error == static_errc::invalid_escape_sequence);
+        r = tree("name a\\");
+        UCMDP_CHECK(r.error == static_errc::invalid_escape_sequence);
+        r = tree("name \"longer than eight\"");
+        UCMDP_CHECK(r.error == static_errc::scratch_exhausted);
+        UCMDP_CHECK(c.name[0] == '\0');
+        UCMDP_CHECK(c.speed == 0);
+    }
+
+    void bounded_insertion()
+    {
+        static_command_tree<3> tree;
+        UCMDP_CHECK(tree.insert("a b", make_static_command(&reset)) == static_errc::ok);
+        UCMDP_CHECK(tree.insert("a b", make_static_command(&reset)) == static_errc::command_exists);
+        UCMDP_CHECK(tree.insert("c", make_static_command(&reset)) == static_errc::tree_full);
+        UCMDP_CHECK(tree.insert("a\\ b", make_static_command(&reset)) == static_errc::invalid_escape_sequence);
+        UCMDP_CHECK(tree.size() == tree.max_size());
+    }
+}
+
+int main()
+{
+    // stdio buffers are allocated lazily
+    static char errBuffer[BUFSIZ];
+    std::setvbuf(stderr, errBuffer, _IOFBF, sizeof(errBuffer));
+
+    heap_forbidden = true;
+    dispatches_commands();
+    reports_error_codes();
+    bounded_insertion();
+    std::fflush(stderr);
+    heap_forbidden = false;
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
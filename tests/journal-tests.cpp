@@ -0,0 +1,185 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/journal.hpp>
+#include "boost-unit-test.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace ucmdp;
+
+namespace
+{
+    struct journal_fixture
+    {
+        const std::string path = "journal-tests.journal";
+        std::vector<int> values;
+        std::vector<std::string> names;
+        command_tree tree {
+            { "push", make_command([this](int v) { values.push_back(v); }) },
+            { "name set", make_command([this](std::string v) { names.push_back(v); }) }
+        };
+
+        ~journal_fixture()
+        {
+            std::remove(path.c_str());
+        }
+
+        std::vector<journal_record> records(const journal_reader &reader)
+        {
+            std::vector<journal_record> result;
+            reader.for_each([&result](const journal_record &record)
+            {
+                result.push_back(record);
+            });
+            return result;
+        }
+    };
+}
+
+BOOST_FIXTURE_TEST_SUITE(journal_tests, journal_fixture)
+
+
+BOOST_AUTO_TEST_CASE(records_dispatched_commands)
+{
+    {
+        auto journal = std::make_shared<journal_writer>(path);
+        record_journal(tree, journal);
+        tree("push 1");
+        tree("name set \"a b\"");
+        BOOST_CHECK_THROW(tree("push x"), invalid_integer_error);
+        BOOST_CHECK_THROW(tree("unknown"), command_not_found_error);
+        tree.observe(nullptr);
+    }
+
+    journal_reader reader{ path };
+    auto recorded = records(reader);
+    BOOST_TEST_REQUIRE(recorded.size() == 4u);
+    BOOST_TEST(recorded[0].command == "push 1");
+    BOOST_TEST(recorded[0].args_offset == 5u);
+    BOOST_TEST(recorded[0].id == tree.prepare("push").id());
+    BOOST_TEST(recorded[1].command == "name set \"a b\"");
+    BOOST_TEST(recorded[1].command.substr(recorded[1].args_offset) == "\"a b\"");
+    BOOST_TEST(recorded[2].command == "push x");
+    // unknown commands are part of the traffic, too
+    BOOST_TEST(recorded[3].command == "unknown");
+    BOOST_TEST(recorded[3].id == command_tree::invalid_command_id);
+    BOOST_TEST(recorded[0].timestamp.count() <= recorded[1].timestamp.count());
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_writers)
+{
+    journal_options options;
+    options.thread_buffer_size = 256;
+    {
+        journal_writer journal{ path, options };
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&journal, &tree = tree, t]()
+            {
+                for (int i = 0; i < 1000; ++i)
+                {
+                    journal.append(tree.prepare("push " + std::to_string(t * 1000 + i)));
+                }
+            });
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        BOOST_TEST(journal.records_dropped() == 0u);
+    }
+
+    journal_reader reader{ path };
+    auto stats = replay_journal(tree, reader);
+    BOOST_TEST(stats.commands == 4000u);
+    BOOST_TEST(stats.rebound == 4000u);
+    BOOST_TEST(stats.failed == 0u);
+
+    // records of a single thread keep their order
+    std::vector<int> last(4, -1);
+    for (auto v : values)
+    {
+        BOOST_TEST(v % 1000 > last[v / 1000]);
+        last[v / 1000] = v % 1000;
+    }
+    BOOST_TEST(values.size() == 4000u);
+}
+
+BOOST_AUTO_TEST_CASE(replay_resolves_stale_ids)
+{
+    {
+        journal_writer journal{ path };
+        journal.append(tree.prepare("push 7"));
+        journal.append(tree.prepare("name set x"));
+        journal.append(tree.prepare("push y"));
+    }
+
+    std::vector<int> other;
+    command_tree changed {
+        { "name set", make_command([this](std::string v) { names.push_back(v + "!"); }) },
+        { "push", make_command([&other](int v) { other.push_back(v); }) }
+    };
+    journal_reader reader{ path };
+    auto stats = replay_journal(changed, reader);
+    BOOST_TEST(stats.commands == 3u);
+    BOOST_TEST(stats.rebound == 0u);
+    BOOST_TEST(stats.resolved == 3u);
+    BOOST_TEST(stats.failed == 1u);
+    BOOST_TEST(other == std::vector<int>{ 7 });
+    BOOST_TEST(names == std::vector<std::string>{ "x!" });
+}
+
+BOOST_AUTO_TEST_CASE(recorded_pacing)
+{
+    {
+        journal_writer journal{ path };
+        journal.append(tree.prepare("push 1"));
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        journal.append(tree.prepare("push 2"));
+    }
+
+    journal_reader reader{ path };
+    auto paced = replay_journal(tree, reader, replay_pacing::recorded);
+    BOOST_TEST(paced.commands == 2u);
+    BOOST_TEST(paced.elapsed.count() >= std::chrono::nanoseconds(std::chrono::milliseconds(25)).count());
+    BOOST_TEST(values == (std::vector<int>{ 1, 2 }));
+}
+
+BOOST_AUTO_TEST_CASE(truncated_and_invalid_files)
+{
+    {
+        journal_writer journal{ path };
+        journal.append(tree.prepare("push 1"));
+        journal.append(tree.prepare("push 2"));
+    }
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file << "partial";
+    }
+    BOOST_TEST(records(journal_reader{ path }).size() == 2u);
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << "push 1\n";
+    }
+    BOOST_CHECK_THROW(journal_reader{ path }, journal_error);
+}
+
+BOOST_AUTO_TEST_CASE(drops_records_if_requested)
+{
+    journal_options options;
+    options.thread_buffer_size = 64;
+    options.block_when_full = false;
+    journal_writer journal{ path, options };
+    journal.append(0, std::string(100, 'x'), 0);
+    BOOST_TEST(journal.records_dropped() == 1u);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
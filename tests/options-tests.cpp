@@ -0,0 +1,154 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/options.hpp>
+#include "boost-unit-test.hpp"
+
+using namespace ucmdp;
+using namespace ucmdp::detail;
+
+namespace
+{
+    struct dump_options
+    {
+        bool verbose = false;
+        bool force = false;
+        int level = 1;
+        std::optional<std::string> output;
+    };
+}
+
+namespace ucmdp
+{
+    template< >
+    struct serialization_traits< dump_options >
+        : options_serializer< dump_options >
+    {
+        static constexpr auto schema = make_option_schema(
+            option("verbose", 'v', &dump_options::verbose),
+            option("force", 'f', &dump_options::force),
+            option("level", 'l', &dump_options::level),
+            option("output", &dump_options::output)
+        );
+    };
+}
+
+BOOST_AUTO_TEST_SUITE(options_tests)
+
+static_assert(is_token_consumer_v<dump_options>);
+static_assert(serialization_traits<dump_options>::schema.find("level") == 2);
+static_assert(serialization_traits<dump_options>::schema.find("levels") == 4);
+static_assert(serialization_traits<dump_options>::schema.find('f') == 1);
+
+BOOST_AUTO_TEST_CASE(perfect_hash_lookup)
+{
+    constexpr perfect_hash_table<5> table({ "a", "b", "ab", "ba", "" });
+    static_assert(table.find("ab") == 2);
+    static_assert(table.find("") == 4);
+    static_assert(table.find("abc") == table.npos);
+    BOOST_TEST(table.find("ba") == 3u);
+}
+
+BOOST_AUTO_TEST_CASE(long_and_short_options)
+{
+    dump_options received;
+    std::string positional;
+    command<void(dump_options, std::string)> cmd([&](dump_options opts, std::string pos)
+    {
+        received = opts;
+        positional = pos;
+    });
+
+    cmd.exec("--level=3 -vf --output \"a b\" target");
+    BOOST_TEST(received.verbose);
+    BOOST_TEST(received.force);
+    BOOST_TEST(received.level == 3);
+    BOOST_TEST(received.output.value() == "a b");
+    BOOST_TEST(positional == "target");
+
+    cmd.exec("-l7 --verbose=false -- --target");
+    BOOST_TEST(!received.verbose);
+    BOOST_TEST(!received.force);
+    BOOST_TEST(received.level == 7);
+    BOOST_TEST(!received.output);
+    BOOST_TEST(positional == "--target");
+
+    cmd.exec("-5");
+    BOOST_TEST(received.level == 1);
+    BOOST_TEST(positional == "-5");
+}
+
+BOOST_AUTO_TEST_CASE(option_errors)
+{
+    command<void(dump_options)> cmd([](dump_options) {});
+
+    BOOST_CHECK_THROW(cmd.exec("--unknown"), unknown_option_error);
+    BOOST_CHECK_THROW(cmd.exec("-x"), unknown_option_error);
+    BOOST_CHECK_THROW(cmd.exec("-v --verbose"), duplicate_option_error);
+    BOOST_CHECK_THROW(cmd.exec("--level"), missing_option_value_error);
+    BOOST_CHECK_THROW(cmd.exec("--force=maybe"), invalid_option_value_error);
+    BOOST_CHECK_THROW(cmd.exec("--level=x"), invalid_integer_error);
+    BOOST_CHECK_THROW(cmd.exec("-v positional"), too_many_arguments_error);
+
+    try
+    {
+        cmd.exec("--output=a --output=b");
+        BOOST_TEST(false);
+    }
+    catch (duplicate_option_error &exc)
+    {
+        auto name = boost::get_error_info<option_name_info>(exc);
+        BOOST_TEST_REQUIRE(name);
+        BOOST_TEST(*name == "output");
+    }
+
+    try
+    {
+        cmd.exec("--force=maybe");
+        BOOST_TEST(false);
+    }
+    catch (invalid_option_value_error &exc)
+    {
+        auto name = boost::get_error_info<option_name_info>(exc);
+        auto value = boost::get_error_info<option_value_info>(exc);
+        BOOST_TEST_REQUIRE(name);
+        BOOST_TEST_REQUIRE(value);
+        BOOST_TEST(*name == "force");
+        BOOST_TEST(*value == "maybe");
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(options_round_trip)
+{
+    dump_options sent;
+    sent.verbose = true;
+    sent.level = -3;
+    sent.output = "a b=c";
+
+    char buffer[256];
+    auto [end, ec] = format_command(std::begin(buffer), std::end(buffer), "dump", sent, "pos");
+    BOOST_TEST_REQUIRE((ec == std::errc{}));
+    BOOST_TEST(std::string_view(buffer, end - buffer)
+        == R"(dump --verbose --force=false --level=-3 --output=a\ b=c pos)");
+
+    dump_options received;
+    std::string positional;
+    command<void(dump_options, std::string)> cmd([&](dump_options opts, std::string pos)
+    {
+        received = opts;
+        positional = pos;
+    });
+    cmd.exec(std::string_view(buffer, end - buffer).substr(5));
+    BOOST_TEST(received.verbose);
+    BOOST_TEST(!received.force);
+    BOOST_TEST(received.level == -3);
+    BOOST_TEST(received.output.value() == "a b=c");
+    BOOST_TEST(positional == "pos");
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
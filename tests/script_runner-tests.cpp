@@ -0,0 +1,143 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/script_runner.hpp>
+#include "boost-unit-test.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace ucmdp;
+
+namespace
+{
+    struct script_fixture
+    {
+        std::vector<int> values;
+        command_tree tree {
+            { "push", make_command([this](int v) { values.push_back(v); }) },
+            { "push twice", make_command([this](int v) { values.push_back(v); values.push_back(v); }) },
+            { "fail", make_command([]() { throw std::runtime_error("fail"); }) }
+        };
+
+        static script_runner_options parallel()
+        {
+            script_runner_options options;
+            options.threads = 3;
+            options.chunk_size = 64;
+            options.chunks_in_flight_per_thread = 2;
+            return options;
+        }
+    };
+}
+
+BOOST_FIXTURE_TEST_SUITE(script_runner_tests, script_fixture)
+
+
+BOOST_AUTO_TEST_CASE(parallel_run_preserves_order)
+{
+    std::string script;
+    std::vector<int> expected;
+    for (int i = 0; i < 5000; ++i)
+    {
+        if (i % 7 == 0)
+        {
+            script += "push twice " + std::to_string(i) + "\r\n\n";
+            expected.push_back(i);
+        }
+        else
+        {
+            script += "push " + std::to_string(i) + "\n";
+        }
+        expected.push_back(i);
+    }
+
+    script_runner{ tree, parallel() }.run(script);
+    BOOST_TEST(values == expected);
+
+    values.clear();
+    script_runner{ tree }.run_sequential(script);
+    BOOST_TEST(values == expected);
+}
+
+BOOST_AUTO_TEST_CASE(errors_report_line_numbers)
+{
+    std::string script;
+    for (int i = 0; i < 200; ++i)
+    {
+        script += "push 1\n";
+    }
+    script += "\npush x\npush 2\n";
+
+    for (auto options : { parallel(), script_runner_options{ 0 } })
+    {
+        values.clear();
+        try
+        {
+            script_runner{ tree, options }.run(script);
+            BOOST_TEST(false);
+        }
+        catch (invalid_integer_error &exc)
+        {
+            auto line = boost::get_error_info<script_line_info>(exc);
+            BOOST_TEST_REQUIRE(line);
+            BOOST_TEST(*line == 202u);
+        }
+        BOOST_TEST(values.size() == 200u);
+    }
+
+    try
+    {
+        script_runner{ tree, parallel() }.run("push 1\nunknown\n");
+        BOOST_TEST(false);
+    }
+    catch (command_not_found_error &exc)
+    {
+        auto line = boost::get_error_info<script_line_info>(exc);
+        BOOST_TEST_REQUIRE(line);
+        BOOST_TEST(*line == 2u);
+    }
+
+    try
+    {
+        script_runner{ tree, parallel() }.run("push 1\nfail");
+        BOOST_TEST(false);
+    }
+    catch (script_error &exc)
+    {
+        auto line = boost::get_error_info<script_line_info>(exc);
+        BOOST_TEST_REQUIRE(line);
+        BOOST_TEST(*line == 2u);
+        BOOST_TEST(boost::get_error_info<nested_exception_info>(exc));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(run_mapped_file)
+{
+    const std::string path = "script_runner-tests.script";
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        for (int i = 0; i < 1000; ++i)
+        {
+            file << "push " << i << "\n";
+        }
+    }
+
+    script_runner{ tree, parallel() }.run_file(path);
+    BOOST_TEST(values.size() == 1000u);
+    BOOST_TEST(values.back() == 999);
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    }
+    script_runner{ tree, parallel() }.run_file(path);
+    BOOST_TEST(values.size() == 1000u);
+
+    std::remove(path.c_str());
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,180 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/all.hpp>
+#include "boost-unit-test.hpp"
+
+#include <cmath>
+#include <random>
+#include <cstring>
+
+using namespace ucmdp;
+
+namespace
+{
+    template< typename... Args >
+    std::string format(std::string_view path, const Args &... args)
+    {
+        char buffer[4096];
+        auto [end, ec] = format_command(std::begin(buffer), std::end(buffer), path, args...);
+        BOOST_TEST_REQUIRE((ec == std::errc{}));
+        return std::string(buffer, end);
+    }
+
+    // formats, dispatches and compares the received arguments
+    template< typename... Args >
+    void check_round_trip(const Args &... args)
+    {
+        bool called = false;
+        command_tree tree {
+            { "cmd", make_command([&](Args... received)
+            {
+                called = true;
+                BOOST_CHECK(std::tie(received...) == std::tie(args...));
+            }) }
+        };
+        auto cmd = format("cmd", args...);
+        tree(cmd);
+        BOOST_TEST_REQUIRE(called);
+    }
+
+    std::mt19937_64 &rng()
+    {
+        static std::mt19937_64 gen{ 0x5eed };
+        return gen;
+    }
+
+    template< typename T >
+    T random_integer()
+    {
+        // mix uniformly distributed values with small ones and the limits
+        switch (rng()() % 4)
+        {
+        case 0:
+            return std::numeric_limits<T>::min();
+        case 1:
+            return std::numeric_limits<T>::max();
+        case 2:
+            return static_cast<T>(rng()() % 200);
+        default:
+            return static_cast<T>(rng()());
+        }
+    }
+
+    template< typename T >
+    T random_floating_point()
+    {
+        using bits_t = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+        for (;;)
+        {
+            auto bits = static_cast<bits_t>(rng()());
+            T value;
+            std::memcpy(&value, &bits, sizeof(value));
+            if (!std::isnan(value))
+            {
+                return value;
+            }
+        }
+    }
+
+    std::string random_string()
+    {
+        static constexpr std::string_view alphabet = "ab \"\\\n\tx-=0";
+        std::string str(rng()() % 12, ' ');
+        for (auto &c : str)
+        {
+            auto i = rng()() % (alphabet.size() + 1);
+            c = i < alphabet.size() ? alphabet[i] : static_cast<char>(0x80 + rng()() % 0x80);
+        }
+        return str;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(serializer_tests)
+
+
+BOOST_AUTO_TEST_CASE(integers_round_trip)
+{
+    for (int i = 0; i < 500; ++i)
+    {
+        check_round_trip(random_integer<int>(), random_integer<unsigned int>(),
+                         random_integer<long>(), random_integer<unsigned long>());
+        check_round_trip(random_integer<long long>(), random_integer<unsigned long long>(),
+                         std::byte{ static_cast<unsigned char>(rng()()) });
+    }
+    BOOST_TEST(format("set", -12, 7u, std::byte{ 255 }) == "set -12 7 255");
+}
+
+BOOST_AUTO_TEST_CASE(floating_points_round_trip)
+{
+    for (int i = 0; i < 2000; ++i)
+    {
+        check_round_trip(random_floating_point<double>(), random_floating_point<float>());
+    }
+    check_round_trip(0.1, -0.0, 1e-320, std::numeric_limits<double>::infinity());
+    BOOST_TEST(format("set", 0.1, 2.5f, -1e300) == "set 0.1 2.5 -1e+300");
+
+    double received = 0.0;
+    command_tree tree {
+        { "cmd", make_command([&received](double v) { received = v; }) }
+    };
+    tree(format("cmd", std::numeric_limits<double>::quiet_NaN()));
+    BOOST_TEST(std::isnan(received));
+}
+
+BOOST_AUTO_TEST_CASE(strings_round_trip)
+{
+    for (int i = 0; i < 2000; ++i)
+    {
+        check_round_trip(random_string(), random_string(), random_string());
+    }
+    check_round_trip(std::string{}, std::string{ "\"" }, std::string{ " " });
+    BOOST_TEST(format("say", "a b", std::string_view{ "\"q\"" }, std::string{})
+        == R"(say a\ b \"q\" "")");
+}
+
+BOOST_AUTO_TEST_CASE(containers_and_optionals)
+{
+    check_round_trip(std::string{ "x y" }, std::vector<int>{ 1, -2, 3 });
+    check_round_trip(std::array<double, 2>{ 0.5, -4.0 }, std::vector<std::string>{ "", "a b" });
+    check_round_trip(std::vector<int>{});
+
+    std::optional<int> received;
+    command_tree tree {
+        { "cmd", make_command([&received](std::optional<int> v) { received = v; }) }
+    };
+    tree(format("cmd", std::optional<int>{}));
+    BOOST_TEST(!received);
+    tree(format("cmd", std::optional<int>{ 4 }));
+    BOOST_TEST(received.value() == 4);
+    BOOST_TEST(format("cmd", 1, std::optional<int>{ 2 }, std::optional<int>{}) == "cmd 1 2");
+
+    // the engaged optional would be parsed into the empty one
+    char buffer[32];
+    auto [end, ec] = format_command(std::begin(buffer), std::end(buffer), "cmd",
+                                    1, std::optional<int>{}, std::optional<int>{ 2 });
+    BOOST_TEST((ec == std::errc::invalid_argument));
+    BOOST_TEST(end == std::begin(buffer));
+    static_assert(!detail::has_trailing_optionals_only<std::optional<int>, int>());
+    static_assert(detail::has_trailing_optionals_only<int, std::optional<int>, std::optional<int>>());
+
+    BOOST_TEST(format("cmd", 1, rest_of_line{ "a \"b c\"" }) == "cmd 1 a \"b c\"");
+}
+
+BOOST_AUTO_TEST_CASE(buffer_too_small)
+{
+    const auto expected = format("cmd", -123, std::string{ "a b" }, std::vector<int>{ 1, 2 });
+    for (std::size_t size = 0; size < expected.size(); ++size)
+    {
+        std::vector<char> buffer(size);
+        auto [end, ec] = format_command(buffer.data(), buffer.data() + size,
+                                        "cmd", -123, std::string{ "a b" }, std::vector<int>{ 1, 2 });
+        BOOST_TEST((ec == std::errc::value_too_large));
+        BOOST_TEST(end == buffer.data() + size);
+    }
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
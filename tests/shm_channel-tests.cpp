@@ -0,0 +1,194 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/shm_channel.hpp>
+#include "boost-unit-test.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace ucmdp;
+using namespace std::chrono_literals;
+
+namespace
+{
+    struct shm_channel_fixture
+    {
+        const std::string name = "ucmdp-shm_channel-tests-" + std::to_string(::getpid());
+        command_tree tree;
+
+        shm_channel_fixture()
+        {
+            tree.insert("add", make_command([](int a, int b) { return a + b; }));
+            tree.insert("echo", make_command([](std::string_view v) { return std::string{ v }; }));
+            tree.insert("noop", make_command([]() {}));
+            tree.insert("repeat", make_command([](std::size_t n) { return std::string(n, 'x'); }));
+        }
+    };
+
+    struct response
+    {
+        shm_response_status status;
+        std::string payload;
+    };
+
+    // sends all commands at once and serves them until the client has
+    // received all responses
+    std::vector<response> round_trip(shm_command_server &server, const command_tree &tree,
+                                     shm_command_client &client, const std::vector<std::string> &cmds)
+    {
+        std::vector<response> responses;
+        for (auto &cmd : cmds)
+        {
+            BOOST_REQUIRE(client.send(cmd, 1s));
+        }
+        while (responses.size() < cmds.size())
+        {
+            server.serve(tree, 0ns);
+            client.receive([&](shm_response_status status, std::string_view payload)
+            {
+                responses.push_back({ status, std::string{ payload } });
+            }, 0ns);
+        }
+        return responses;
+    }
+}
+
+BOOST_FIXTURE_TEST_SUITE(shm_channel_tests, shm_channel_fixture)
+
+
+BOOST_AUTO_TEST_CASE(responses_in_order)
+{
+    shm_command_server server{ name, 256 };
+    shm_command_client client{ name };
+
+    tree.limit("noop", rate_limit{ 1h, 1 });
+    const std::vector<std::string> cmds{
+        "add 1 2", "echo \"a b\"", "noop", "noop", "mul 1 2", "add x 1",
+        "repeat 200",
+    };
+    auto responses = round_trip(server, tree, client, cmds);
+    BOOST_REQUIRE(responses.size() == cmds.size());
+
+    BOOST_TEST((responses[0].status == shm_response_status::ok));
+    BOOST_TEST(responses[0].payload == "3");
+    BOOST_TEST(responses[1].payload == "a\\ b");
+    BOOST_TEST((responses[2].status == shm_response_status::ok));
+    BOOST_TEST(responses[2].payload.empty());
+    BOOST_TEST((responses[3].status == shm_response_status::rate_limited));
+    BOOST_TEST((responses[4].status == shm_response_status::failed));
+    BOOST_TEST(!responses[4].payload.empty());
+    BOOST_TEST((responses[5].status == shm_response_status::failed));
+    // the response ring holds at most 120 bytes per record
+    BOOST_TEST((responses[6].status == shm_response_status::response_too_large));
+
+    BOOST_TEST(!client.send(std::string(200, 'x'), 0ns));
+}
+
+BOOST_AUTO_TEST_CASE(missing_or_incompatible_channels)
+{
+    BOOST_CHECK_THROW(shm_command_client{ name }, shm_channel_error);
+    {
+        shm_command_server server{ name, 1024 };
+        shm_command_client client{ name };
+    }
+    // the server removes the channel
+    BOOST_CHECK_THROW(shm_command_client{ name }, shm_channel_error);
+}
+
+BOOST_AUTO_TEST_CASE(sleeping_server_is_woken)
+{
+    shm_command_server server{ name, 1024 };
+    shm_command_client client{ name };
+
+    std::size_t served = 0;
+    std::thread serverThread([&]()
+    {
+        while (served < 3)
+        {
+            served += server.serve(tree, 5s);
+        }
+    });
+    for (int i = 0; i < 3; ++i)
+    {
+        // gives the server time to fall asleep on the futex
+        std::this_thread::sleep_for(20ms);
+        BOOST_TEST(client.send("add 1 " + std::to_string(i)));
+        std::string payload;
+        BOOST_TEST(client.receive([&](shm_response_status, std::string_view p) { payload = p; }, 5s) == 1u);
+        BOOST_TEST(payload == std::to_string(i + 1));
+    }
+    serverThread.join();
+    BOOST_TEST(served == 3u);
+}
+
+#if defined(__linux__)
+
+BOOST_AUTO_TEST_CASE(two_processes)
+{
+    constexpr int count = 20000;
+    shm_command_server server{ name, 4096 };
+
+    const auto child = ::fork();
+    BOOST_REQUIRE(child >= 0);
+    if (child == 0)
+    {
+        // the client process must not touch Boost.Test
+        int exitCode = 0;
+        try
+        {
+            shm_command_client client{ name };
+            int sent = 0;
+            int received = 0;
+            const auto check = [&](shm_response_status status, std::string_view payload)
+            {
+                if (status != shm_response_status::ok
+                    || payload != std::to_string(received + 1000))
+                {
+                    exitCode = 1;
+                }
+                ++received;
+            };
+            while (received < count)
+            {
+                while (sent < count
+                    && client.send("add 1000 " + std::to_string(sent), 0ns))
+                {
+                    ++sent;
+                }
+                client.receive(check, 1ms);
+            }
+        }
+        catch (...)
+        {
+            exitCode = 2;
+        }
+        ::_exit(exitCode);
+    }
+
+    std::size_t served = 0;
+    const auto deadline = std::chrono::steady_clock::now() + 30s;
+    while (served < count && std::chrono::steady_clock::now() < deadline)
+    {
+        served += server.serve(tree, 100ms, 64);
+    }
+    int status = 0;
+    BOOST_REQUIRE(::waitpid(child, &status, 0) == child);
+    BOOST_TEST(served == static_cast<std::size_t>(count));
+    BOOST_TEST(WIFEXITED(status));
+    BOOST_TEST(WEXITSTATUS(status) == 0);
+}
+
+#endif
+
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,126 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/command_tree.hpp>
+#include <ucmd-parser/structured_view.hpp>
+#include "boost-unit-test.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace ucmdp;
+using namespace ucmdp::detail;
+
+
+BOOST_AUTO_TEST_SUITE(structured_view_tests)
+
+
+BOOST_AUTO_TEST_CASE(structure_ends)
+{
+    const auto end_of = [](std::string_view text) -> std::ptrdiff_t
+    {
+        auto end = find_structure_end(text.data(), text.data() + text.size());
+        return end ? end - text.data() : -1;
+    };
+    BOOST_TEST(end_of("[]") == 2);
+    BOOST_TEST(end_of("{\"a\":[1,2,{}]} tail") == 14);
+    BOOST_TEST(end_of("[\"]\\\"]\"] x") == 8);
+    BOOST_TEST(end_of("[1,2") == -1);
+    BOOST_TEST(end_of("[1,2}") == -1);
+    BOOST_TEST(end_of(std::string(65, '[') + std::string(65, ']')) == -1);
+    BOOST_TEST(end_of(std::string(64, '[') + std::string(64, ']')) == 128);
+
+    // an escaped quote on a block boundary
+    std::string text = "[\"" + std::string(13, 'x') + "\\\"]\"]";
+    BOOST_TEST(text[15] == '\\');
+    BOOST_TEST(end_of(text) == static_cast<std::ptrdiff_t>(text.size()));
+}
+
+BOOST_AUTO_TEST_CASE(lazy_navigation)
+{
+    const structured_view doc{
+        "{ \"name\": \"m\\u00fcller \\\"x\\\"\", \"ids\": [1, 2, 3],"
+        " \"nested\": {\"on\": true, \"gain\": 0.5, \"none\": null}, \"a\\\"b\": 7 }"
+    };
+    BOOST_TEST((doc.type() == structured_view::kind::object));
+    BOOST_TEST(doc.size() == 4u);
+    BOOST_TEST(doc["name"].as<std::string>() == "m\xc3\xbcller \"x\"");
+    BOOST_TEST(doc["name"].as<std::string_view>() == "m\\u00fcller \\\"x\\\"");
+    BOOST_TEST(doc["ids"].size() == 3u);
+    BOOST_TEST(doc["ids"][2].as<int>() == 3);
+    BOOST_TEST(doc["nested"]["on"].as<bool>());
+    BOOST_TEST(doc["nested"]["gain"].as<double>() == 0.5);
+    BOOST_TEST(!doc["nested"]["none"].as<std::optional<int>>().has_value());
+    BOOST_TEST(doc["a\\\"b"].as<int>() == 7);
+    BOOST_TEST(doc[1].text() == "[1, 2, 3]");
+    BOOST_TEST(!doc.find("missing").has_value());
+    BOOST_CHECK_THROW(doc["missing"], structured_member_not_found_error);
+    BOOST_CHECK_THROW(doc["ids"][3], structured_member_not_found_error);
+
+    int sum = 0;
+    doc["ids"].for_each([&sum](structured_view v) { sum += v.as<int>(); });
+    BOOST_TEST(sum == 6);
+    std::vector<std::string> keys;
+    doc.for_each([&keys](std::string_view key, structured_view) { keys.emplace_back(key); });
+    BOOST_TEST(keys == (std::vector<std::string>{ "name", "ids", "nested", "a\\\"b" }));
+}
+
+BOOST_AUTO_TEST_CASE(malformed_structures)
+{
+    // only the accessed part is validated
+    const structured_view doc{ "{\"a\": 1, \"b\" 2}" };
+    BOOST_TEST(doc["a"].as<int>() == 1);
+    BOOST_CHECK_THROW(doc["b"], structured_literal_error);
+    BOOST_CHECK_THROW(structured_view{ "[1,,2]" }.size(), structured_literal_error);
+    BOOST_CHECK_THROW(structured_view{ "[1 2]" }.size(), structured_literal_error);
+    BOOST_CHECK_THROW(structured_view{ "[\"\\ud800\"]" }[0].as<std::string>(), structured_literal_error);
+    BOOST_CHECK_THROW(structured_view{ "[yes]" }[0].as<bool>(), structured_literal_error);
+    BOOST_TEST(structured_view{ "[\"\\ud83d\\ude00\"]" }[0].as<std::string>() == "\xf0\x9f\x98\x80");
+}
+
+BOOST_AUTO_TEST_CASE(literal_arguments)
+{
+    tokenizer_options options;
+    options.structured_literals = true;
+    command_tree tree{ options };
+
+    std::vector<int> values;
+    std::string name;
+    tree.insert("config apply", make_command([&](std::string_view target, structured_view config, int n)
+    {
+        name = target;
+        config["a"].for_each([&values](structured_view v) { values.push_back(v.as<int>()); });
+        values.push_back(n);
+    }));
+    tree("config apply \"x y\" {\"a\": [1, 2, 3], \"b\": \"} ]\"} 4");
+    BOOST_TEST(name == "x y");
+    BOOST_TEST(values == (std::vector<int>{ 1, 2, 3, 4 }));
+
+    BOOST_CHECK_THROW(tree("config apply x {\"a\": [1} 4"), structured_literal_error);
+    BOOST_CHECK_THROW(tree("config apply x {\"a\": []}4"), structured_literal_error);
+    try
+    {
+        tree("config apply {\"a\":[1,2} 4");
+        BOOST_TEST(false);
+    }
+    catch (structured_literal_error &exc)
+    {
+        auto commandPart = boost::get_error_info<command_part_info>(exc);
+        auto argPart = boost::get_error_info<arg_part_info>(exc);
+        BOOST_TEST_REQUIRE(commandPart);
+        BOOST_TEST_REQUIRE(argPart);
+        BOOST_TEST(*commandPart == "config apply ");
+        BOOST_TEST(*argPart == "{\"a\":[1,2} 4");
+    }
+
+    char buffer[32];
+    auto result = format_command(buffer, buffer + sizeof(buffer), "config apply",
+                                 std::string_view{ "x" }, structured_view{ "{\"a\": []}" }, 1);
+    BOOST_TEST(std::string_view(buffer, result.ptr - buffer) == "config apply x {\"a\": []} 1");
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,176 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/detail/token_stream.hpp>
+#include "boost-unit-test.hpp"
+
+using namespace ucmdp;
+using namespace ucmdp::detail;
+
+
+BOOST_AUTO_TEST_SUITE(token_stream_tests)
+
+
+BOOST_AUTO_TEST_CASE(plain_tokens)
+{
+    cmd_token_stream tokens{ "ab cd  e" };
+
+    BOOST_TEST(tokens.next() == "ab");
+    BOOST_TEST(tokens.consumed() == "ab ");
+    BOOST_TEST(tokens.next() == "cd");
+    BOOST_TEST(tokens.next() == "");
+    BOOST_TEST(tokens.remaining() == "e");
+    BOOST_TEST(tokens.next() == "e");
+    BOOST_TEST(!tokens);
+    BOOST_CHECK_THROW(tokens.next(), end_of_token_stream_error);
+}
+
+BOOST_AUTO_TEST_CASE(quoted_and_escaped_tokens)
+{
+    std::string scratch;
+    cmd_token_stream tokens{ R"(a" b "c d\"e \\\  f\n)" };
+
+    BOOST_TEST(tokens.next(scratch) == "a b c");
+    BOOST_TEST(tokens.next(scratch) == "d\"e");
+    BOOST_TEST(tokens.next(scratch) == "\\ ");
+    BOOST_TEST(tokens.next(scratch) == "f\n");
+    BOOST_TEST(!tokens);
+}
+
+BOOST_AUTO_TEST_CASE(plain_tokens_are_views)
+{
+    std::string_view input = "abc \"d\"";
+    std::string scratch;
+    cmd_token_stream tokens{ input };
+
+    auto first = tokens.next(scratch);
+    BOOST_TEST(first.data() == input.data());
+    auto second = tokens.next(scratch);
+    BOOST_TEST(second == "d");
+    BOOST_TEST(second.data() == scratch.data());
+}
+
+BOOST_AUTO_TEST_CASE(invalid_escape_sequences)
+{
+    BOOST_CHECK_THROW(cmd_token_stream{ "a\\" }.next(), invalid_escape_sequence_error);
+    BOOST_CHECK_THROW(cmd_token_stream{ "a\\x" }.next(), invalid_escape_sequence_error);
+    BOOST_TEST(cmd_token_stream{ "a\\;\\&" }.next() == "a;&");
+}
+
+BOOST_AUTO_TEST_CASE(utf8_passes_unvalidated_by_default)
+{
+    cmd_token_stream tokens{ "\xff\xfe x" };
+    BOOST_TEST(tokens.next() == "\xff\xfe");
+}
+
+BOOST_AUTO_TEST_CASE(utf8_validation)
+{
+    tokenizer_options options;
+    options.validate_utf8 = true;
+
+    std::string scratch;
+    std::string_view valid = u8"gr\u00fc\u00dfe \"\u65e5\u672c\" \U0001F600";
+    cmd_token_stream tokens{ valid, options };
+    BOOST_TEST(tokens.next(scratch) == u8"gr\u00fc\u00dfe");
+    BOOST_TEST(tokens.next(scratch) == u8"\u65e5\u672c");
+    BOOST_TEST(tokens.next(scratch) == u8"\U0001F600");
+
+    const std::string_view malformed[] = {
+        "\x80", "\xc3", "\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xf8"
+    };
+    for (auto input : malformed)
+    {
+        std::string line = "abcdefghijklmnopq \"x";
+        line += input;
+        BOOST_CHECK_THROW(cmd_token_stream(line, options).count_remaining(), invalid_utf8_error);
+
+        try
+        {
+            cmd_token_stream lineTokens{ line, options };
+            lineTokens.next(scratch);
+            lineTokens.next(scratch);
+            BOOST_TEST(false);
+        }
+        catch (invalid_utf8_error &exc)
+        {
+            auto offset = boost::get_error_info<input_offset_info>(exc);
+            BOOST_TEST_REQUIRE(offset);
+            BOOST_TEST(*offset == 20u);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(unicode_whitespace_separators)
+{
+    tokenizer_options options;
+    options.unicode_whitespace = true;
+
+    std::string scratch;
+    cmd_token_stream tokens{ u8"a\u00a0b\tc\u3000\"d\u2003e\"", options };
+    BOOST_TEST(tokens.next(scratch) == "a");
+    BOOST_TEST(tokens.next(scratch) == "b");
+    BOOST_TEST(tokens.next(scratch) == "c");
+    BOOST_TEST(tokens.next(scratch) == u8"d\u2003e");
+    BOOST_TEST(!tokens);
+}
+
+BOOST_AUTO_TEST_CASE(long_ascii_lines_use_block_scan)
+{
+    tokenizer_options options;
+    options.validate_utf8 = true;
+
+    std::string line(100, 'a');
+    line += " ";
+    line += std::string(37, 'b');
+    cmd_token_stream tokens{ line, options };
+    BOOST_TEST(tokens.next().size() == 100u);
+    BOOST_TEST(tokens.next().size() == 37u);
+
+    line[120] = '\xc3';
+    cmd_token_stream broken{ line, options };
+    broken.next();
+    BOOST_CHECK_THROW(broken.next(), invalid_utf8_error);
+
+    // skipped remainders are validated as well
+    cmd_token_stream skipped{ line, options };
+    skipped.next();
+    BOOST_CHECK_THROW(skipped.skip_remaining(), invalid_utf8_error);
+    cmd_token_stream lenient{ line };
+    lenient.next();
+    BOOST_TEST(lenient.skip_remaining().size() == 37u);
+}
+
+BOOST_AUTO_TEST_CASE(statement_splitting)
+{
+    const std::string_view line = "a 1; b \"x;y && z\"\\; c\\;d&&e  ;; f&g &&";
+    cmd_statement_stream statements{ line };
+    statement_link link;
+
+    BOOST_TEST(statements.next(link) == "a 1");
+    BOOST_TEST((link == statement_link::sequence));
+    // escaped separators are unescaped by the tokenizer
+    BOOST_TEST(statements.next(link) == "b \"x;y && z\"\\; c\\;d");
+    BOOST_TEST((link == statement_link::conjunction));
+    BOOST_TEST(statements.next(link) == "e");
+    BOOST_TEST((link == statement_link::sequence));
+    BOOST_TEST(statements.next(link) == "");
+    BOOST_TEST(statements.next(link) == "f&g");
+    BOOST_TEST((link == statement_link::conjunction));
+    BOOST_TEST(!statements);
+
+    // only unescaped trailing separators are trimmed
+    cmd_statement_stream escaped{ "echo a\\  ; echo b\\ " };
+    BOOST_TEST(escaped.next(link) == "echo a\\ ");
+    BOOST_TEST(escaped.next(link) == "echo b\\ ");
+
+    // the splitter skips 16 byte blocks without specials
+    const std::string longLine = std::string(40, 'x') + " \"" + std::string(20, ';') + "\";y";
+    cmd_statement_stream longStatements{ longLine };
+    BOOST_TEST(longStatements.next(link).size() == 63u);
+    BOOST_TEST(longStatements.next(link) == "y");
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
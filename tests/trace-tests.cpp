@@ -0,0 +1,175 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/command_tree.hpp>
+#include <ucmd-parser/trace.hpp>
+#include "boost-unit-test.hpp"
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ucmdp;
+
+namespace
+{
+    struct trace_fixture
+    {
+        command_tree tree;
+        int sum = 0;
+
+        trace_fixture()
+        {
+            stop_tracing();
+            clear_trace();
+            tree.insert("add", make_command([this](int v) { sum += v; }));
+            tree.insert("sub", make_command([this](int v) { sum -= v; }));
+        }
+        ~trace_fixture()
+        {
+            stop_tracing();
+            clear_trace();
+        }
+
+        static std::vector<detail::trace_event> events()
+        {
+            std::vector<detail::trace_event> result;
+            for (auto &buffer : detail::trace_registry::instance().buffers())
+            {
+                buffer->for_each([&](const detail::trace_event &event) { result.push_back(event); });
+            }
+            return result;
+        }
+        static std::vector<std::string> event_names()
+        {
+            std::vector<std::string> names;
+            for (auto &event : events())
+            {
+                names.emplace_back(event.name);
+            }
+            return names;
+        }
+    };
+}
+
+BOOST_FIXTURE_TEST_SUITE(trace_tests, trace_fixture)
+
+
+BOOST_AUTO_TEST_CASE(nothing_is_recorded_while_stopped)
+{
+    tree("add 1");
+    BOOST_TEST(sum == 1);
+    BOOST_TEST(events().empty());
+}
+
+BOOST_AUTO_TEST_CASE(records_the_dispatch_phases)
+{
+    start_tracing();
+    tree("sub 2");
+    stop_tracing();
+    tree("add 1");
+    BOOST_TEST(sum == -1);
+
+    // events are appended when their scope closes
+    const std::vector<std::string> expected{ "resolve", "parse_args", "handler", "execute" };
+    BOOST_TEST(event_names() == expected);
+
+    const auto recorded = events();
+    BOOST_TEST(recorded[0].id == command_tree::invalid_command_id);
+    BOOST_TEST(recorded[3].id == 1u);
+    for (auto &event : recorded)
+    {
+        BOOST_TEST(event.end >= event.begin);
+    }
+    // parse_args and handler are nested in execute
+    BOOST_TEST(recorded[1].begin >= recorded[3].begin);
+    BOOST_TEST(recorded[2].end <= recorded[3].end);
+}
+
+BOOST_AUTO_TEST_CASE(failed_commands_are_recorded)
+{
+    start_tracing();
+    BOOST_CHECK_THROW(tree("add x"), invalid_integer_error);
+    BOOST_CHECK_THROW(tree("mul 1"), command_not_found_error);
+    stop_tracing();
+
+    // unknown commands are reported when they are executed
+    const std::vector<std::string> expected{
+        "resolve", "parse_args", "execute", "resolve", "execute"
+    };
+    BOOST_TEST(event_names() == expected);
+}
+
+BOOST_AUTO_TEST_CASE(exports_chrome_trace_json)
+{
+    start_tracing();
+    tree("add 1");
+    stop_tracing();
+
+    const auto json = chrome_trace_json();
+    BOOST_TEST(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0u);
+    BOOST_TEST(json.substr(json.size() - 4) == "\n]}\n");
+    BOOST_TEST(json.find("{\"name\":\"resolve\",\"ph\":\"X\",\"pid\":1,\"tid\":") != std::string::npos);
+    BOOST_TEST(json.find("\"args\":{\"id\":0}}") != std::string::npos);
+    // only the execute event carries the command id
+    BOOST_TEST(json.find("\"args\"") == json.rfind("\"args\""));
+    BOOST_TEST(json.find(",\"dur\":") != std::string::npos);
+
+    clear_trace();
+    BOOST_TEST(chrome_trace_json() == "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n]}\n");
+}
+
+BOOST_AUTO_TEST_CASE(full_buffers_drop_events)
+{
+    // the buffer capacity applies to threads which haven't traced yet
+    std::thread([this]()
+    {
+        start_tracing(2);
+        tree("add 1");
+        tree("add 1");
+        stop_tracing();
+    }).join();
+
+    BOOST_TEST(sum == 2);
+    BOOST_TEST(events().size() == 2u);
+    BOOST_TEST(trace_events_dropped() == 6u);
+    clear_trace();
+    BOOST_TEST(trace_events_dropped() == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(threads_get_their_own_buffers)
+{
+    start_tracing();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([this]()
+        {
+            for (int j = 0; j < 100; ++j)
+            {
+                tree.prepare("add 1");
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    stop_tracing();
+
+    std::set<std::uint32_t> threadIds;
+    std::size_t count = 0;
+    for (auto &buffer : detail::trace_registry::instance().buffers())
+    {
+        buffer->for_each([&](const detail::trace_event &) { threadIds.insert(buffer->thread_id()); ++count; });
+    }
+    BOOST_TEST(count == 400u);
+    BOOST_TEST(threadIds.size() == 4u);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,227 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/command.hpp>
+#include <ucmd-parser/tree_image.hpp>
+#include "boost-unit-test.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+
+using namespace ucmdp;
+
+namespace
+{
+    struct tree_image_fixture
+    {
+        const std::string path = "tree_image-tests.image";
+        std::vector<std::string> calls;
+
+        frozen_command_tree::registration_table registrations()
+        {
+            return {
+                { "list", make_command([this]() { calls.push_back("list"); }) },
+                { "set value", make_command([this](int v) { calls.push_back("set value " + std::to_string(v)); }) },
+                { "set \"long name\" x", make_command([this](std::string v) { calls.push_back("set long name x " + v); }) },
+                { "set name", make_command([this](std::string v) { calls.push_back("set name " + v); }) },
+                { "a b c d", make_command([this]() { calls.push_back("a b c d"); }) },
+            };
+        }
+
+        void write_image(tokenizer_options options = tokenizer_options{})
+        {
+            command_tree tree{ options };
+            for (auto &[name, action] : registrations())
+            {
+                tree.insert(name, action);
+            }
+            frozen_command_tree::write_image(tree, path);
+        }
+
+        ~tree_image_fixture()
+        {
+            std::remove(path.c_str());
+        }
+    };
+}
+
+BOOST_FIXTURE_TEST_SUITE(tree_image_tests, tree_image_fixture)
+
+
+BOOST_AUTO_TEST_CASE(frozen_tree_dispatches_like_the_original)
+{
+    const std::vector<std::string> cmds{
+        "list",
+        "set value 3",
+        "set \"value\" 4",
+        "set long\\ name x \"a b\"",
+        "set name y",
+        "a b c d",
+        "a \"b\" c d",
+    };
+
+    {
+        command_tree tree;
+        for (auto &[name, action] : registrations())
+        {
+            tree.insert(name, action);
+        }
+        frozen_command_tree::write_image(tree, path);
+        for (auto &cmd : cmds)
+        {
+            tree(cmd);
+        }
+    }
+    auto expected = std::move(calls);
+    calls.clear();
+
+    frozen_command_tree frozen{ path, registrations() };
+    BOOST_TEST(frozen.size() == 5u);
+    BOOST_TEST(frozen.path(2) == "set long\\ name x");
+    for (auto &cmd : cmds)
+    {
+        frozen(cmd);
+    }
+    BOOST_TEST(calls == expected);
+
+    auto [id, argsOffset] = frozen.resolve("set name y");
+    BOOST_TEST(id == 3u);
+    BOOST_TEST(argsOffset == 9u);
+    BOOST_TEST(frozen.resolve("unknown").first == frozen_command_tree::invalid_command_id);
+
+    BOOST_CHECK_THROW(frozen("set"), command_not_found_error);
+    BOOST_CHECK_THROW(frozen("unknown"), command_not_found_error);
+    BOOST_CHECK_THROW(frozen("a b x d"), command_not_found_error);
+    BOOST_CHECK_THROW(frozen("set value x"), invalid_integer_error);
+    try
+    {
+        frozen("set value \"1\\q\"");
+        BOOST_TEST(false);
+    }
+    catch (invalid_escape_sequence_error &exc)
+    {
+        // annotated like the original tree does
+        auto commandPart = boost::get_error_info<command_part_info>(exc);
+        auto argPart = boost::get_error_info<arg_part_info>(exc);
+        BOOST_TEST_REQUIRE(commandPart);
+        BOOST_TEST_REQUIRE(argPart);
+        BOOST_TEST(*commandPart == "set value ");
+        BOOST_TEST(*argPart == "\"1\\q\"");
+    }
+
+    frozen.bind(0, make_command([this]() { calls.push_back("rebound"); }));
+    frozen("list");
+    BOOST_TEST(calls.back() == "rebound");
+}
+
+BOOST_AUTO_TEST_CASE(keeps_the_tokenizer_options)
+{
+    tokenizer_options options;
+    options.unicode_whitespace = true;
+    write_image(options);
+    frozen_command_tree frozen{ path, registrations() };
+    BOOST_TEST(frozen.options().unicode_whitespace);
+    frozen("set\xc2\xa0value 5");
+    BOOST_TEST(calls.back() == "set value 5");
+
+    // raw delegates only see validated arguments
+    frozen.bind(0, [this](std::string_view args) { calls.emplace_back(args); });
+    BOOST_CHECK_THROW(frozen("list a\xff"), invalid_utf8_error);
+    BOOST_TEST(calls.back() == "set value 5");
+}
+
+BOOST_AUTO_TEST_CASE(detects_schema_mismatches)
+{
+    write_image();
+    BOOST_TEST(frozen_command_tree::schema_hash(registrations())
+        == frozen_command_tree(path, registrations()).schema_hash());
+
+    auto reordered = registrations();
+    std::swap(reordered[0], reordered[1]);
+    BOOST_CHECK_THROW((frozen_command_tree{ path, reordered }), tree_image_error);
+
+    frozen_command_tree::registration_table changed{
+        { "list", make_command([]() {}) },
+        { "set value", make_command([](int) {}) },
+    };
+    BOOST_CHECK_THROW((frozen_command_tree{ path, changed }), tree_image_error);
+    BOOST_CHECK_THROW((frozen_command_tree{ path, {} }), tree_image_error);
+
+    // different paths, same number of commands
+    frozen_command_tree::registration_table renamed{
+        { "list", make_command([]() {}) },
+        { "set value", make_command([](int) {}) },
+        { "set other x", make_command([](std::string) {}) },
+        { "set name", make_command([](std::string) {}) },
+        { "a b c d", make_command([]() {}) },
+    };
+    BOOST_CHECK_THROW((frozen_command_tree{ path, renamed }), tree_image_error);
+}
+
+BOOST_AUTO_TEST_CASE(rejects_malformed_images)
+{
+    write_image();
+    std::string image;
+    {
+        std::ifstream file(path, std::ios::binary);
+        image.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    const auto write = [this](const std::string &content)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << content;
+    };
+
+    write(image.substr(0, image.size() - 1));
+    BOOST_CHECK_THROW((frozen_command_tree{ path, registrations() }), tree_image_error);
+
+    auto version = image;
+    version[8] = 2;
+    write(version);
+    BOOST_CHECK_THROW((frozen_command_tree{ path, registrations() }), tree_image_error);
+
+    // the first child of the root pointing back to the root
+    auto cyclic = image;
+    cyclic[sizeof(detail::tree_image_header) + 16] = 0;
+    write(cyclic);
+    BOOST_CHECK_THROW((frozen_command_tree{ path, registrations() }), tree_image_error);
+
+    write("list\n");
+    BOOST_CHECK_THROW((frozen_command_tree{ path, registrations() }), tree_image_error);
+}
+
+BOOST_AUTO_TEST_CASE(rewrites_mapped_images)
+{
+    write_image();
+    frozen_command_tree mapped{ path, registrations() };
+
+    // a rewrite doesn't pull the image from under the mapping
+    command_tree smaller;
+    smaller.insert("list", make_command([]() {}));
+    frozen_command_tree::write_image(smaller, path);
+    BOOST_TEST(!std::filesystem::exists(path + ".tmp"));
+
+    mapped("set name z");
+    BOOST_TEST(calls.back() == "set name z");
+    BOOST_TEST(mapped.path(4) == "a b c d");
+
+    frozen_command_tree reloaded{ path, { { "list", make_command([]() {}) } } };
+    BOOST_TEST(reloaded.size() == 1u);
+
+    BOOST_CHECK_THROW(frozen_command_tree::write_image(smaller, "missing-dir/tree.image"),
+                      tree_image_error);
+}
+
+BOOST_AUTO_TEST_CASE(mounts_cant_be_frozen)
+{
+    command_tree tree;
+    tree.insert("list", make_command([]() {}));
+    tree.mount("sub", std::make_shared<command_tree>());
+    BOOST_CHECK_THROW(frozen_command_tree::write_image(tree, path), mount_error);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
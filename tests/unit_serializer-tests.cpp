@@ -0,0 +1,129 @@
+// Copyright 2017 Henrik Steffen Gaßmann
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+//
+#include <ucmd-parser/unit_serializer.hpp>
+#include "boost-unit-test.hpp"
+
+using namespace ucmdp;
+using namespace std::chrono_literals;
+
+namespace
+{
+    using hex_int = with_base<16, int>;
+    using octal_u8 = with_base<8, std::uint8_t>;
+    using binary_i8 = with_base<2, std::int8_t>;
+    using seconds_i8 = std::chrono::duration<std::int8_t>;
+    using minutes32 = std::chrono::duration<std::int32_t, std::ratio<60>>;
+    using thirds = std::chrono::duration<int, std::ratio<1, 3>>;
+
+    template< typename T >
+    T parse(std::string_view str)
+    {
+        T value{};
+        serialization_traits<T>{}.deserialize(str, value);
+        return value;
+    }
+
+    template< typename T >
+    std::string write(const T &value)
+    {
+        char buffer[64];
+        auto [end, ec] = serialization_traits<T>{}.serialize(std::begin(buffer), std::end(buffer), value);
+        BOOST_TEST_REQUIRE((ec == std::errc{}));
+        return std::string(buffer, end);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(unit_serializer_tests)
+
+
+BOOST_AUTO_TEST_CASE(with_base_parsing)
+{
+    BOOST_TEST(parse<with_base<2>>("0b1011").value == 11u);
+    BOOST_TEST(parse<with_base<2>>("1011").value == 11u);
+    BOOST_TEST(parse<with_base<16>>("0xfF").value == 255u);
+    BOOST_TEST(parse<hex_int>("-7f").value == -127);
+    BOOST_TEST(parse<octal_u8>("377").value == 255u);
+    BOOST_TEST(parse<binary_i8>("-10000000").value == -128);
+
+    BOOST_CHECK_THROW(parse<with_base<2>>("102"), invalid_integer_error);
+    BOOST_CHECK_THROW(parse<with_base<2>>("0b"), invalid_integer_error);
+    BOOST_CHECK_THROW(parse<with_base<2>>(""), empty_argument_error);
+    BOOST_CHECK_THROW(parse<with_base<16>>("-1"), invalid_integer_error);
+    BOOST_CHECK_THROW(parse<octal_u8>("400"), integer_overflow_serialization_error);
+    BOOST_CHECK_THROW(parse<binary_i8>("-10000001"), integer_underflow_serialization_error);
+    BOOST_CHECK_THROW(parse<with_base<16>>("1ffffffffffffffff"), integer_overflow_serialization_error);
+
+    BOOST_TEST(write(with_base<2>{ 11 }) == "1011");
+    BOOST_TEST(write(hex_int{ -255 }) == "-ff");
+}
+
+BOOST_AUTO_TEST_CASE(byte_notations)
+{
+    BOOST_TEST(std::to_integer<int>(parse<std::byte>("0b101")) == 5);
+    BOOST_TEST(std::to_integer<int>(parse<std::byte>("0x1F")) == 31);
+    BOOST_TEST(std::to_integer<int>(parse<std::byte>("017")) == 15);
+    BOOST_TEST(std::to_integer<int>(parse<std::byte>("255")) == 255);
+    BOOST_TEST(std::to_integer<int>(parse<std::byte>("0")) == 0);
+    BOOST_CHECK_THROW(parse<std::byte>("256"), integer_overflow_serialization_error);
+    BOOST_CHECK_THROW(parse<std::byte>("09"), invalid_integer_error);
+}
+
+BOOST_AUTO_TEST_CASE(si_sizes)
+{
+    BOOST_TEST(parse<si_size<>>("64K").value == 65536u);
+    BOOST_TEST(parse<si_size<>>("64k").value == 65536u);
+    BOOST_TEST(parse<si_size<>>("1.5G").value == 1610612736u);
+    BOOST_TEST(parse<si_size<>>("2MiB").value == 2097152u);
+    BOOST_TEST(parse<si_size<>>("3KB").value == 3072u);
+    BOOST_TEST(parse<si_size<>>("512B").value == 512u);
+    BOOST_TEST(parse<si_size<>>("512").value == 512u);
+    BOOST_TEST(parse<si_size<>>("0.1K").value == 102u);
+    BOOST_TEST(parse<si_size<>>(".5M").value == 524288u);
+    BOOST_TEST(parse<si_size<>>("15E").value == 15ull << 60);
+
+    BOOST_CHECK_THROW(parse<si_size<>>("16E"), integer_overflow_serialization_error);
+    BOOST_CHECK_THROW(parse<si_size<std::uint32_t>>("4G"), integer_overflow_serialization_error);
+    BOOST_CHECK_THROW(parse<si_size<>>("1.5"), invalid_integer_error);
+    BOOST_CHECK_THROW(parse<si_size<>>("1X"), invalid_integer_error);
+    BOOST_CHECK_THROW(parse<si_size<>>("1KiBB"), invalid_integer_error);
+    BOOST_CHECK_THROW(parse<si_size<>>("K"), invalid_integer_error);
+
+    BOOST_TEST(write(si_size<>{ 65536 }) == "64K");
+    BOOST_TEST(write(si_size<>{ 1610612736 }) == "1536M");
+    BOOST_TEST(write(si_size<>{ 1000 }) == "1000");
+    BOOST_TEST(write(si_size<>{ 0 }) == "0");
+}
+
+BOOST_AUTO_TEST_CASE(durations)
+{
+    BOOST_TEST(parse<std::chrono::milliseconds>("250ms").count() == 250);
+    BOOST_TEST(parse<std::chrono::milliseconds>("1.5s").count() == 1500);
+    BOOST_TEST(parse<std::chrono::milliseconds>("2min").count() == 120000);
+    BOOST_TEST(parse<std::chrono::milliseconds>("250").count() == 250);
+    BOOST_TEST(parse<std::chrono::milliseconds>("-3s").count() == -3000);
+    BOOST_TEST(parse<std::chrono::milliseconds>("1500us").count() == 1);
+    BOOST_TEST(parse<std::chrono::microseconds>("7\xC2\xB5s").count() == 7);
+    BOOST_TEST(parse<std::chrono::seconds>("1d").count() == 86400);
+    BOOST_TEST(parse<std::chrono::nanoseconds>("0.000000001s").count() == 1);
+    BOOST_TEST(parse<std::chrono::duration<double>>("250ms").count() == 0.25);
+    BOOST_TEST(parse<std::chrono::duration<double>>("-1.5h").count() == -5400.0);
+
+    BOOST_TEST(parse<minutes32>("90s").count() == 1);
+    BOOST_CHECK_THROW(parse<seconds_i8>("128s"), integer_overflow_serialization_error);
+    BOOST_TEST(parse<seconds_i8>("-128s").count() == -128);
+    BOOST_CHECK_THROW(parse<seconds_i8>("-129s"), integer_underflow_serialization_error);
+    BOOST_CHECK_THROW(parse<std::chrono::nanoseconds>("300y"), invalid_integer_error);
+    BOOST_CHECK_THROW(parse<std::chrono::nanoseconds>("999999999999999h"), integer_overflow_serialization_error);
+
+    BOOST_TEST(write(250ms) == "250ms");
+    BOOST_TEST(write(std::chrono::hours{ -2 }) == "-2h");
+    BOOST_TEST(write(minutes32{ 3 }) == "3min");
+    BOOST_TEST(write(std::chrono::duration<double>{ 0.5 }) == "0.5s");
+    BOOST_TEST(write(thirds{ 4 }) == "4");
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()